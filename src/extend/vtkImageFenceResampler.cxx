@@ -0,0 +1,339 @@
+#include "vtkImageFenceResampler.h"
+
+#include "vtkImageData.h"
+#include "vtkImageResampleRow.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkObjectFactory.h"
+#include "vtkStreamingDemandDrivenPipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+vtkStandardNewMacro(vtkImageFenceResampler);
+
+namespace
+{
+template <class T>
+void vtkResampleFence(vtkImageData *inData, const T *scalars, vtkImageData *outData, const int outExt[6],
+                      const std::vector<double> &path, const std::vector<double> &distances)
+{
+    int inExt[6];
+    inData->GetExtent(inExt);
+
+    const int size[3] = {inExt[1] - inExt[0] + 1, inExt[3] - inExt[2] + 1, inExt[5] - inExt[4] + 1};
+
+    vtkIdType inc[3];
+    inData->GetIncrements(inc);
+
+    const double *inOrigin = inData->GetOrigin();
+    const double *inSpacing = inData->GetSpacing();
+
+    const double *outOrigin = outData->GetOrigin();
+    const double *outSpacing = outData->GetSpacing();
+
+    const int numSegments = static_cast<int>(distances.size()) - 1;
+
+    // the first column of each segment, the last segment ends with the output
+
+    std::vector<int> firstColumns(numSegments + 1);
+    for (int k = 0; k < numSegments; k++) {
+        firstColumns[k] = static_cast<int>(std::ceil(distances[k] / outSpacing[0] - 1e-6));
+    }
+    firstColumns[numSegments] = outExt[1] + 1;
+
+    const int numColumns = outExt[1] - outExt[0] + 1;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    for (int row = outExt[2]; row <= outExt[3]; row++) {
+        const double z = outOrigin[1] + row * outSpacing[1];
+        const double cz = (z - inOrigin[2]) / inSpacing[2] - inExt[4];
+
+        float *out = static_cast<float *>(outData->GetScalarPointer(outExt[0], row, outExt[4]));
+        std::fill(out, out + numColumns, nan);
+
+        for (int k = 0; k < numSegments; k++) {
+            const int first = std::max(firstColumns[k], outExt[0]);
+            const int last = std::min(firstColumns[k + 1] - 1, outExt[1]);
+
+            if (first > last) {
+                continue;
+            }
+
+            const double length = distances[k + 1] - distances[k];
+
+            const double dx = (path[2 * k + 2] - path[2 * k]) / length;
+            const double dy = (path[2 * k + 3] - path[2 * k + 1]) / length;
+
+            // position of the first column on the segment
+            const double t = first * outSpacing[0] - distances[k];
+            const double x = path[2 * k] + t * dx;
+            const double y = path[2 * k + 1] + t * dy;
+
+            const double c0[3] = {(x - inOrigin[0]) / inSpacing[0] - inExt[0],
+                                  (y - inOrigin[1]) / inSpacing[1] - inExt[2], cz};
+            const double dc[3] = {outSpacing[0] * dx / inSpacing[0], outSpacing[0] * dy / inSpacing[1], 0.0};
+
+            vtkResampleRow(scalars, inc, size, c0, dc, last - first + 1, out + (first - outExt[0]));
+        }
+    }
+}
+}
+
+//------------------------------------------------------------------------------
+vtkImageFenceResampler::vtkImageFenceResampler()
+{
+    this->DepthRange[0] = 0.0;
+    this->DepthRange[1] = -1.0;
+
+    this->OutputSpacing[0] = this->OutputSpacing[1] = 0.0;
+
+    this->Component = 0;
+}
+
+//------------------------------------------------------------------------------
+vtkImageFenceResampler::~vtkImageFenceResampler() = default;
+
+//------------------------------------------------------------------------------
+void vtkImageFenceResampler::SetPath(int numPoints, const double *xy)
+{
+    this->Path.clear();
+    this->VertexDistances.clear();
+
+    for (int i = 0; (xy != nullptr) && (i < numPoints); i++) {
+        const double x = xy[2 * i];
+        const double y = xy[2 * i + 1];
+
+        if (this->Path.empty()) {
+            this->VertexDistances.push_back(0.0);
+        } else {
+            const double length = std::hypot(x - this->Path[this->Path.size() - 2], y - this->Path.back());
+            if (length <= 0.0) {
+                continue;
+            }
+
+            this->VertexDistances.push_back(this->VertexDistances.back() + length);
+        }
+
+        this->Path.push_back(x);
+        this->Path.push_back(y);
+    }
+
+    this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkImageFenceResampler::RemovePath()
+{
+    this->SetPath(0, nullptr);
+}
+
+//------------------------------------------------------------------------------
+int vtkImageFenceResampler::GetNumberOfPathPoints() const
+{
+    return static_cast<int>(this->Path.size() / 2);
+}
+
+//------------------------------------------------------------------------------
+const double *vtkImageFenceResampler::GetPath() const
+{
+    return this->Path.empty() ? nullptr : this->Path.data();
+}
+
+//------------------------------------------------------------------------------
+double vtkImageFenceResampler::GetVertexDistance(int index) const
+{
+    if ((index < 0) || (index >= static_cast<int>(this->VertexDistances.size()))) {
+        return 0.0;
+    }
+
+    return this->VertexDistances[index];
+}
+
+//------------------------------------------------------------------------------
+bool vtkImageFenceResampler::ComputeGeometry(vtkInformation *inInfo, double depthRange[2], double spacing[2],
+                                             int size[2])
+{
+    if (this->VertexDistances.size() < 2) {
+        vtkErrorMacro("The path needs at least 2 different points");
+        return false;
+    }
+
+    int inExt[6];
+    double inOrigin[3];
+    double inSpacing[3];
+
+    inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
+    inInfo->Get(vtkDataObject::ORIGIN(), inOrigin);
+    inInfo->Get(vtkDataObject::SPACING(), inSpacing);
+
+    const double minSpacing =
+        std::min(std::fabs(inSpacing[0]), std::min(std::fabs(inSpacing[1]), std::fabs(inSpacing[2])));
+
+    for (int i = 0; i < 2; i++) {
+        spacing[i] = (this->OutputSpacing[i] > 0.0) ? this->OutputSpacing[i] : minSpacing;
+    }
+
+    if (!(spacing[0] > 0.0 && spacing[1] > 0.0)) {
+        vtkErrorMacro("Invalid output spacing");
+        return false;
+    }
+
+    depthRange[0] = this->DepthRange[0];
+    depthRange[1] = this->DepthRange[1];
+
+    if (depthRange[0] > depthRange[1]) {
+        const double z1 = inOrigin[2] + inExt[4] * inSpacing[2];
+        const double z2 = inOrigin[2] + inExt[5] * inSpacing[2];
+
+        depthRange[0] = std::min(z1, z2);
+        depthRange[1] = std::max(z1, z2);
+    }
+
+    const double length = this->VertexDistances.back();
+
+    size[0] = static_cast<int>(std::floor(length / spacing[0] + 1e-6)) + 1;
+    size[1] = static_cast<int>(std::floor((depthRange[1] - depthRange[0]) / spacing[1] + 1e-6)) + 1;
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int vtkImageFenceResampler::RequestInformation(vtkInformation *, vtkInformationVector **inputVector,
+                                               vtkInformationVector *outputVector)
+{
+    vtkInformation *inInfo = inputVector[0]->GetInformationObject(0);
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+
+    double depthRange[2];
+    double spacing[2];
+    int size[2];
+
+    if (!this->ComputeGeometry(inInfo, depthRange, spacing, size)) {
+        return 0;
+    }
+
+    const int outExt[6] = {0, size[0] - 1, 0, size[1] - 1, 0, 0};
+    const double outOrigin[3] = {0.0, depthRange[0], 0.0};
+    const double outSpacing[3] = {spacing[0], spacing[1], 1.0};
+
+    outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), outExt, 6);
+    outInfo->Set(vtkDataObject::ORIGIN(), outOrigin, 3);
+    outInfo->Set(vtkDataObject::SPACING(), outSpacing, 3);
+
+    vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_FLOAT, 1);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkImageFenceResampler::RequestUpdateExtent(vtkInformation *, vtkInformationVector **inputVector,
+                                                vtkInformationVector *outputVector)
+{
+    vtkInformation *inInfo = inputVector[0]->GetInformationObject(0);
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+
+    int inExt[6];
+    double inOrigin[3];
+    double inSpacing[3];
+
+    inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
+    inInfo->Get(vtkDataObject::ORIGIN(), inOrigin);
+    inInfo->Get(vtkDataObject::SPACING(), inSpacing);
+
+    int outExt[6];
+    double outOrigin[3];
+    double outSpacing[3];
+
+    outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt);
+    outInfo->Get(vtkDataObject::ORIGIN(), outOrigin);
+    outInfo->Get(vtkDataObject::SPACING(), outSpacing);
+
+    // the voxels around the path and the requested rows
+
+    double bounds[6] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX,
+                        VTK_DOUBLE_MIN};
+
+    for (size_t i = 0; i + 1 < this->Path.size(); i += 2) {
+        for (int axis = 0; axis < 2; axis++) {
+            const double index = (this->Path[i + axis] - inOrigin[axis]) / inSpacing[axis];
+
+            bounds[2 * axis] = std::min(bounds[2 * axis], index);
+            bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], index);
+        }
+    }
+
+    for (int i = 2; i < 4; i++) {
+        const double z = outOrigin[1] + outExt[i] * outSpacing[1];
+        const double index = (z - inOrigin[2]) / inSpacing[2];
+
+        bounds[4] = std::min(bounds[4], index);
+        bounds[5] = std::max(bounds[5], index);
+    }
+
+    int updateExt[6];
+    for (int axis = 0; axis < 3; axis++) {
+        const double lower = std::max(std::floor(bounds[2 * axis]), double(inExt[2 * axis]));
+        const double upper = std::min(std::ceil(bounds[2 * axis + 1]), double(inExt[2 * axis + 1]));
+
+        if (lower > upper) {
+            // the fence doesn't intersect the volume
+            updateExt[2 * axis] = inExt[2 * axis];
+            updateExt[2 * axis + 1] = inExt[2 * axis];
+        } else {
+            updateExt[2 * axis] = static_cast<int>(lower);
+            updateExt[2 * axis + 1] = static_cast<int>(upper);
+        }
+    }
+
+    inInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), updateExt, 6);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void vtkImageFenceResampler::ThreadedRequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *,
+                                                 vtkImageData ***inData, vtkImageData **outData, int outExt[6],
+                                                 int threadId)
+{
+    vtkImageData *input = inData[0][0];
+    vtkImageData *output = outData[0];
+
+    if (this->VertexDistances.size() < 2) {
+        return;
+    }
+
+    const int numComponents = input->GetNumberOfScalarComponents();
+    if ((this->Component < 0) || (this->Component >= numComponents)) {
+        if (threadId == 0) {
+            vtkErrorMacro("Invalid component " << this->Component);
+        }
+        return;
+    }
+
+    int inExt[6];
+    input->GetExtent(inExt);
+
+    void *inPtr = input->GetScalarPointerForExtent(inExt);
+
+    switch (input->GetScalarType()) {
+        vtkTemplateMacro(vtkResampleFence(input, static_cast<const VTK_TT *>(inPtr) + this->Component, output, outExt,
+                                          this->Path, this->VertexDistances));
+    default :
+        if (threadId == 0) {
+            vtkErrorMacro("Unsupported scalar type");
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkImageFenceResampler::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+
+    os << indent << "Path: " << this->GetNumberOfPathPoints() << " points\n";
+    os << indent << "DepthRange: (" << this->DepthRange[0] << ", " << this->DepthRange[1] << ")\n";
+    os << indent << "OutputSpacing: (" << this->OutputSpacing[0] << ", " << this->OutputSpacing[1] << ")\n";
+    os << indent << "Component: " << this->Component << "\n";
+}
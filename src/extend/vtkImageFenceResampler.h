@@ -0,0 +1,109 @@
+/**
+ * @class vtkImageFenceResampler
+ * @brief resample a volume on a vertical fence along a polyline
+ *
+ * vtkImageFenceResampler samples the point scalars of a vtkImageData on the
+ * vertical surface, that is spanned by a polyline in the xy plane and a
+ * range of z coordinates. The fence is unfolded into a vtkImageData with
+ * a single slice: point (i, j) is the trilinear interpolation of the volume
+ * at the position of the path with the distance i * sd from the first point
+ * of the path and the z coordinate z0 + j * sz.
+ *
+ * The origin and spacing of the output are ( 0, z0 ) and ( sd, sz ), so
+ * that the output can be used as a matrix of equidistant values
+ * ( distance along the path x depth ) without any transformation.
+ * The vertices of the path are in general not on a column, the
+ * distances of the vertices are available from GetVertexDistance().
+ *
+ * Positions outside of the volume are NaN. The scalars of the output
+ * are float, only a single component of the input is resampled.
+ *
+ * The output rows are distributed to the threads of vtkThreadedImageAlgorithm,
+ * each segment of a row is resampled like a row of vtkImagePlaneResampler.
+ *
+ * @sa vtkImagePlaneResampler
+ */
+
+#ifndef vtkImageFenceResampler_h
+#define vtkImageFenceResampler_h
+
+#include "vtkThreadedImageAlgorithm.h"
+
+#include <vector>
+
+class vtkImageFenceResampler : public vtkThreadedImageAlgorithm
+{
+public:
+    static vtkImageFenceResampler *New();
+    vtkTypeMacro(vtkImageFenceResampler, vtkThreadedImageAlgorithm);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    ///@{
+    /**
+     * Path of the fence in world coordinates ( x, y pairs ).
+     * A path needs at least 2 points, consecutive duplicates are ignored.
+     */
+    void SetPath(int numPoints, const double *xy);
+    void RemovePath();
+    int GetNumberOfPathPoints() const;
+    const double *GetPath() const;
+    ///@}
+
+    /**
+     * Distance of a vertex of the path from the first point,
+     * the distance of the last vertex is the length of the path.
+     */
+    double GetVertexDistance(int index) const;
+
+    ///@{
+    /**
+     * Range of z coordinates ( z0, z1 ). When z0 > z1, what is the default,
+     * the range is the z range of the bounds of the volume.
+     */
+    vtkSetVector2Macro(DepthRange, double);
+    vtkGetVector2Macro(DepthRange, double);
+    ///@}
+
+    ///@{
+    /**
+     * Distance between the output points along the path and in z.
+     * A spacing <= 0, what is the default, is replaced by the smallest
+     * spacing of the volume.
+     */
+    vtkSetVector2Macro(OutputSpacing, double);
+    vtkGetVector2Macro(OutputSpacing, double);
+    ///@}
+
+    ///@{
+    /**
+     * Component of the input scalars, that is resampled. Default is 0.
+     */
+    vtkSetMacro(Component, int);
+    vtkGetMacro(Component, int);
+    ///@}
+
+protected:
+    vtkImageFenceResampler();
+    ~vtkImageFenceResampler() override;
+
+    int RequestInformation(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+    int RequestUpdateExtent(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+
+    void ThreadedRequestData(vtkInformation *request, vtkInformationVector **inputVector,
+                             vtkInformationVector *outputVector, vtkImageData ***inData, vtkImageData **outData,
+                             int outExt[6], int threadId) override;
+
+    std::vector<double> Path;
+    std::vector<double> VertexDistances;
+    double DepthRange[2];
+    double OutputSpacing[2];
+    int Component;
+
+private:
+    vtkImageFenceResampler(const vtkImageFenceResampler &) = delete;
+    void operator=(const vtkImageFenceResampler &) = delete;
+
+    bool ComputeGeometry(vtkInformation *inInfo, double depthRange[2], double spacing[2], int size[2]);
+};
+
+#endif
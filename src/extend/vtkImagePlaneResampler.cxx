@@ -0,0 +1,639 @@
+#include "vtkImagePlaneResampler.h"
+
+#include "vtkImageData.h"
+#include "vtkImageResampleRow.h"
+#include "vtkInformation.h"
+#include "vtkInformationVector.h"
+#include "vtkMath.h"
+#include "vtkObjectFactory.h"
+#include "vtkStreamingDemandDrivenPipeline.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+vtkStandardNewMacro(vtkImagePlaneResampler);
+
+namespace
+{
+// number of columns, whose slab samples are accumulated in one pass
+const int vtkSlabChunkSize = 256;
+
+// samples along the normal of the plane, that are combined into one value
+struct vtkSlab
+{
+    int numSamples;
+    int mode;
+    double first[3]; // offset of the first sample from the plane in continuous indexes
+    double step[3];  // offset between 2 samples
+};
+
+void vtkSlabInit(int mode, int count, float *acc, float *numValid)
+{
+    float value = 0.0f;
+    if (mode == vtkImagePlaneResampler::SlabMax) {
+        value = -std::numeric_limits<float>::infinity();
+    } else if (mode == vtkImagePlaneResampler::SlabMin) {
+        value = std::numeric_limits<float>::infinity();
+    }
+
+    std::fill(acc, acc + count, value);
+    std::fill(numValid, numValid + count, 0.0f);
+}
+
+/*
+ * Combine the samples of one slab position into the accumulators.
+ * NaN samples are skipped: max/min ps return the second operand, when
+ * one of the operands is NaN.
+ */
+void vtkSlabAccumulate(int mode, int count, const float *values, float *acc, float *numValid)
+{
+    int i = 0;
+
+#if defined(__SSE2__)
+    const __m128 one = _mm_set1_ps(1.0f);
+
+    switch (mode) {
+    case vtkImagePlaneResampler::SlabMax:
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(acc + i, _mm_max_ps(_mm_loadu_ps(values + i), _mm_loadu_ps(acc + i)));
+        }
+        break;
+    case vtkImagePlaneResampler::SlabMin:
+        for (; i + 4 <= count; i += 4) {
+            _mm_storeu_ps(acc + i, _mm_min_ps(_mm_loadu_ps(values + i), _mm_loadu_ps(acc + i)));
+        }
+        break;
+    default :
+        for (; i + 4 <= count; i += 4) {
+            const __m128 v = _mm_loadu_ps(values + i);
+            const __m128 valid = _mm_cmpord_ps(v, v);
+
+            _mm_storeu_ps(acc + i, _mm_add_ps(_mm_loadu_ps(acc + i), _mm_and_ps(valid, v)));
+            _mm_storeu_ps(numValid + i, _mm_add_ps(_mm_loadu_ps(numValid + i), _mm_and_ps(valid, one)));
+        }
+    }
+#endif
+
+    switch (mode) {
+    case vtkImagePlaneResampler::SlabMax:
+        for (; i < count; i++) {
+            acc[i] = (values[i] > acc[i]) ? values[i] : acc[i];
+        }
+        break;
+    case vtkImagePlaneResampler::SlabMin:
+        for (; i < count; i++) {
+            acc[i] = (values[i] < acc[i]) ? values[i] : acc[i];
+        }
+        break;
+    default :
+        for (; i < count; i++) {
+            const bool valid = (values[i] == values[i]);
+
+            acc[i] += valid ? values[i] : 0.0f;
+            numValid[i] += valid ? 1.0f : 0.0f;
+        }
+    }
+}
+
+void vtkSlabFinish(int mode, int count, const float *acc, const float *numValid, float *out)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    if (mode == vtkImagePlaneResampler::SlabMean) {
+        for (int i = 0; i < count; i++) {
+            out[i] = (numValid[i] > 0.0f) ? acc[i] / numValid[i] : nan;
+        }
+    } else {
+        // an infinite accumulator has not seen any valid sample
+        for (int i = 0; i < count; i++) {
+            out[i] = std::isinf(acc[i]) ? nan : acc[i];
+        }
+    }
+}
+
+/*
+ * Resample numSamples columns starting at c0, projecting the slab,
+ * when it has more than one sample.
+ */
+template <class T>
+void vtkResampleSpan(const T *scalars, const vtkIdType inc[3], const int size[3], const double c0[3],
+                     const double dc[3], int numSamples, const vtkSlab &slab, float *out)
+{
+    if (slab.numSamples <= 1) {
+        vtkResampleRow(scalars, inc, size, c0, dc, numSamples, out);
+        return;
+    }
+
+    float values[vtkSlabChunkSize];
+    float acc[vtkSlabChunkSize];
+    float numValid[vtkSlabChunkSize];
+
+    for (int first = 0; first < numSamples; first += vtkSlabChunkSize) {
+        const int count = std::min(vtkSlabChunkSize, numSamples - first);
+
+        vtkSlabInit(slab.mode, count, acc, numValid);
+
+        for (int k = 0; k < slab.numSamples; k++) {
+            double c[3];
+            for (int axis = 0; axis < 3; axis++) {
+                c[axis] = c0[axis] + first * dc[axis] + slab.first[axis] + k * slab.step[axis];
+            }
+
+            vtkResampleRow(scalars, inc, size, c, dc, count, values);
+            vtkSlabAccumulate(slab.mode, count, values, acc, numValid);
+        }
+
+        vtkSlabFinish(slab.mode, count, acc, numValid, out + first);
+    }
+}
+
+/*
+ * Column ranges of a row, that are inside of the polygon ( even-odd rule ).
+ * The ranges are pairs of the first and last column and are clipped to outExt.
+ */
+void vtkPolygonSpans(const std::vector<double> &polygon, double v, double u0, double du, const int outExt[6],
+                     std::vector<double> &crossings, std::vector<int> &spans)
+{
+    crossings.clear();
+    spans.clear();
+
+    const size_t numPoints = polygon.size() / 2;
+    for (size_t i = 0, j = numPoints - 1; i < numPoints; j = i++) {
+        const double ui = polygon[2 * i];
+        const double vi = polygon[2 * i + 1];
+        const double uj = polygon[2 * j];
+        const double vj = polygon[2 * j + 1];
+
+        if ((vi <= v) != (vj <= v)) {
+            crossings.push_back(ui + (v - vi) * (uj - ui) / (vj - vi));
+        }
+    }
+
+    std::sort(crossings.begin(), crossings.end());
+
+    for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+        const double first = std::max(std::ceil((crossings[i] - u0) / du - 1e-6), double(outExt[0]));
+        const double last = std::min(std::floor((crossings[i + 1] - u0) / du + 1e-6), double(outExt[1]));
+
+        if (first <= last) {
+            spans.push_back(static_cast<int>(first));
+            spans.push_back(static_cast<int>(last));
+        }
+    }
+}
+
+template <class T>
+void vtkResamplePlane(vtkImageData *inData, const T *scalars, vtkImageData *outData, const int outExt[6],
+                      const double planeOrigin[3], const double axis1[3], const double axis2[3],
+                      const std::vector<double> &polygon, const vtkSlab &slab)
+{
+    int inExt[6];
+    inData->GetExtent(inExt);
+
+    const int size[3] = {inExt[1] - inExt[0] + 1, inExt[3] - inExt[2] + 1, inExt[5] - inExt[4] + 1};
+
+    vtkIdType inc[3];
+    inData->GetIncrements(inc);
+
+    const double *inOrigin = inData->GetOrigin();
+    const double *inSpacing = inData->GetSpacing();
+
+    const double *outOrigin = outData->GetOrigin();
+    const double *outSpacing = outData->GetSpacing();
+
+    // the step between 2 columns in continuous indexes of the volume
+    double dc[3];
+    for (int axis = 0; axis < 3; axis++) {
+        dc[axis] = outSpacing[0] * axis1[axis] / inSpacing[axis];
+    }
+
+    const double u = outOrigin[0] + outExt[0] * outSpacing[0];
+    const int numSamples = outExt[1] - outExt[0] + 1;
+
+    const bool clipped = polygon.size() >= 6;
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    std::vector<double> crossings;
+    std::vector<int> spans;
+
+    for (int row = outExt[2]; row <= outExt[3]; row++) {
+        const double v = outOrigin[1] + row * outSpacing[1];
+
+        double c0[3];
+        for (int axis = 0; axis < 3; axis++) {
+            const double p = planeOrigin[axis] + u * axis1[axis] + v * axis2[axis];
+            c0[axis] = (p - inOrigin[axis]) / inSpacing[axis] - inExt[2 * axis];
+        }
+
+        float *out = static_cast<float *>(outData->GetScalarPointer(outExt[0], row, outExt[4]));
+
+        if (!clipped) {
+            vtkResampleSpan(scalars, inc, size, c0, dc, numSamples, slab, out);
+            continue;
+        }
+
+        // only the columns inside of the polygon are interpolated
+
+        std::fill(out, out + numSamples, nan);
+
+        vtkPolygonSpans(polygon, v, outOrigin[0], outSpacing[0], outExt, crossings, spans);
+
+        for (size_t i = 0; i < spans.size(); i += 2) {
+            const int offset = spans[i] - outExt[0];
+
+            double c[3];
+            for (int axis = 0; axis < 3; axis++) {
+                c[axis] = c0[axis] + offset * dc[axis];
+            }
+
+            vtkResampleSpan(scalars, inc, size, c, dc, spans[i + 1] - spans[i] + 1, slab, out + offset);
+        }
+    }
+}
+
+bool vtkNormalizedAxes(const double axis1[3], const double axis2[3], double a1[3], double a2[3])
+{
+    for (int i = 0; i < 3; i++) {
+        a1[i] = axis1[i];
+        a2[i] = axis2[i];
+    }
+
+    if ((vtkMath::Normalize(a1) == 0.0) || (vtkMath::Normalize(a2) == 0.0)) {
+        return false;
+    }
+
+    double normal[3];
+    vtkMath::Cross(a1, a2, normal);
+
+    return vtkMath::Norm(normal) > 1e-6;
+}
+}
+
+//------------------------------------------------------------------------------
+vtkImagePlaneResampler::vtkImagePlaneResampler()
+{
+    this->PlaneOrigin[0] = this->PlaneOrigin[1] = this->PlaneOrigin[2] = 0.0;
+
+    this->Axis1[0] = 1.0;
+    this->Axis1[1] = this->Axis1[2] = 0.0;
+
+    this->Axis2[1] = 1.0;
+    this->Axis2[0] = this->Axis2[2] = 0.0;
+
+    this->PlaneExtent[0] = this->PlaneExtent[2] = 0.0;
+    this->PlaneExtent[1] = this->PlaneExtent[3] = -1.0;
+
+    this->OutputSpacing[0] = this->OutputSpacing[1] = 0.0;
+
+    this->Component = 0;
+
+    this->SlabThickness = 0.0;
+    this->SlabSpacing = 0.0;
+    this->SlabMode = SlabMax;
+}
+
+//------------------------------------------------------------------------------
+vtkImagePlaneResampler::~vtkImagePlaneResampler() = default;
+
+//------------------------------------------------------------------------------
+void vtkImagePlaneResampler::SetPlane(const double origin[3], const double normal[3])
+{
+    double n[3] = {normal[0], normal[1], normal[2]};
+    if (vtkMath::Normalize(n) == 0.0) {
+        vtkErrorMacro("Invalid normal");
+        return;
+    }
+
+    double axis1[3] = {-n[1], n[0], 0.0};
+    if (vtkMath::Normalize(axis1) < 1e-6) {
+        // horizontal plane
+        axis1[0] = 1.0;
+        axis1[1] = axis1[2] = 0.0;
+    }
+
+    double axis2[3];
+    vtkMath::Cross(n, axis1, axis2);
+    vtkMath::Normalize(axis2);
+
+    this->SetPlaneOrigin(origin[0], origin[1], origin[2]);
+    this->SetAxis1(axis1);
+    this->SetAxis2(axis2);
+}
+
+//------------------------------------------------------------------------------
+void vtkImagePlaneResampler::SetClipPolygon(int numPoints, const double *uv)
+{
+    if (numPoints < 3 || uv == nullptr) {
+        this->RemoveClipPolygon();
+        return;
+    }
+
+    this->ClipPolygon.assign(uv, uv + 2 * numPoints);
+    this->Modified();
+}
+
+//------------------------------------------------------------------------------
+void vtkImagePlaneResampler::RemoveClipPolygon()
+{
+    if (!this->ClipPolygon.empty()) {
+        this->ClipPolygon.clear();
+        this->Modified();
+    }
+}
+
+//------------------------------------------------------------------------------
+int vtkImagePlaneResampler::GetNumberOfClipPolygonPoints() const
+{
+    return static_cast<int>(this->ClipPolygon.size() / 2);
+}
+
+//------------------------------------------------------------------------------
+const double *vtkImagePlaneResampler::GetClipPolygon() const
+{
+    return this->ClipPolygon.empty() ? nullptr : this->ClipPolygon.data();
+}
+
+//------------------------------------------------------------------------------
+bool vtkImagePlaneResampler::ComputeGeometry(vtkInformation *inInfo, double extent[4], double spacing[2],
+                                             int size[2])
+{
+    double a1[3], a2[3];
+    if (!vtkNormalizedAxes(this->Axis1, this->Axis2, a1, a2)) {
+        vtkErrorMacro("The axes of the plane are null or parallel");
+        return false;
+    }
+
+    int inExt[6];
+    double inOrigin[3];
+    double inSpacing[3];
+
+    inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
+    inInfo->Get(vtkDataObject::ORIGIN(), inOrigin);
+    inInfo->Get(vtkDataObject::SPACING(), inSpacing);
+
+    const double minSpacing =
+        std::min(std::fabs(inSpacing[0]), std::min(std::fabs(inSpacing[1]), std::fabs(inSpacing[2])));
+
+    for (int i = 0; i < 2; i++) {
+        spacing[i] = (this->OutputSpacing[i] > 0.0) ? this->OutputSpacing[i] : minSpacing;
+    }
+
+    if (!(spacing[0] > 0.0 && spacing[1] > 0.0)) {
+        vtkErrorMacro("Invalid output spacing");
+        return false;
+    }
+
+    std::copy(this->PlaneExtent, this->PlaneExtent + 4, extent);
+
+    if ((extent[0] > extent[1]) || (extent[2] > extent[3])) {
+        // the projection of the corners of the volume
+
+        double bounds[4] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN};
+
+        for (int corner = 0; corner < 8; corner++) {
+            double p[3];
+            for (int axis = 0; axis < 3; axis++) {
+                const int index = inExt[2 * axis + ((corner >> axis) & 1)];
+                p[axis] = inOrigin[axis] + index * inSpacing[axis] - this->PlaneOrigin[axis];
+            }
+
+            const double u = vtkMath::Dot(p, a1);
+            const double v = vtkMath::Dot(p, a2);
+
+            bounds[0] = std::min(bounds[0], u);
+            bounds[1] = std::max(bounds[1], u);
+            bounds[2] = std::min(bounds[2], v);
+            bounds[3] = std::max(bounds[3], v);
+        }
+
+        if (this->ClipPolygon.size() >= 6) {
+            // nothing outside of the polygon is sampled
+
+            double polygonBounds[4] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN};
+
+            for (size_t i = 0; i + 1 < this->ClipPolygon.size(); i += 2) {
+                polygonBounds[0] = std::min(polygonBounds[0], this->ClipPolygon[i]);
+                polygonBounds[1] = std::max(polygonBounds[1], this->ClipPolygon[i]);
+                polygonBounds[2] = std::min(polygonBounds[2], this->ClipPolygon[i + 1]);
+                polygonBounds[3] = std::max(polygonBounds[3], this->ClipPolygon[i + 1]);
+            }
+
+            for (int i = 0; i < 2; i++) {
+                bounds[2 * i] = std::max(bounds[2 * i], polygonBounds[2 * i]);
+                bounds[2 * i + 1] = std::min(bounds[2 * i + 1], polygonBounds[2 * i + 1]);
+
+                if (bounds[2 * i] > bounds[2 * i + 1]) {
+                    // no intersection: a single NaN
+                    bounds[2 * i + 1] = bounds[2 * i];
+                }
+            }
+        }
+
+        for (int i = 0; i < 2; i++) {
+            if (extent[2 * i] > extent[2 * i + 1]) {
+                extent[2 * i] = bounds[2 * i];
+                extent[2 * i + 1] = bounds[2 * i + 1];
+            }
+        }
+    }
+
+    for (int i = 0; i < 2; i++) {
+        size[i] = static_cast<int>(std::floor((extent[2 * i + 1] - extent[2 * i]) / spacing[i] + 1e-6)) + 1;
+    }
+
+    return true;
+}
+
+//------------------------------------------------------------------------------
+int vtkImagePlaneResampler::ComputeSlab(const double inSpacing[3], double &step) const
+{
+    step = this->SlabSpacing;
+    if (step <= 0.0) {
+        step = std::min(std::fabs(inSpacing[0]), std::min(std::fabs(inSpacing[1]), std::fabs(inSpacing[2])));
+    }
+
+    if (!(this->SlabThickness > 0.0 && step > 0.0)) {
+        return 1;
+    }
+
+    return static_cast<int>(std::floor(this->SlabThickness / step + 1e-6)) + 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkImagePlaneResampler::RequestInformation(vtkInformation *, vtkInformationVector **inputVector,
+                                               vtkInformationVector *outputVector)
+{
+    vtkInformation *inInfo = inputVector[0]->GetInformationObject(0);
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+
+    double extent[4];
+    double spacing[2];
+    int size[2];
+
+    if (!this->ComputeGeometry(inInfo, extent, spacing, size)) {
+        return 0;
+    }
+
+    const int outExt[6] = {0, size[0] - 1, 0, size[1] - 1, 0, 0};
+    const double outOrigin[3] = {extent[0], extent[2], 0.0};
+    const double outSpacing[3] = {spacing[0], spacing[1], 1.0};
+
+    outInfo->Set(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), outExt, 6);
+    outInfo->Set(vtkDataObject::ORIGIN(), outOrigin, 3);
+    outInfo->Set(vtkDataObject::SPACING(), outSpacing, 3);
+
+    vtkDataObject::SetPointDataActiveScalarInfo(outInfo, VTK_FLOAT, 1);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+int vtkImagePlaneResampler::RequestUpdateExtent(vtkInformation *, vtkInformationVector **inputVector,
+                                                vtkInformationVector *outputVector)
+{
+    vtkInformation *inInfo = inputVector[0]->GetInformationObject(0);
+    vtkInformation *outInfo = outputVector->GetInformationObject(0);
+
+    int inExt[6];
+    double inOrigin[3];
+    double inSpacing[3];
+
+    inInfo->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), inExt);
+    inInfo->Get(vtkDataObject::ORIGIN(), inOrigin);
+    inInfo->Get(vtkDataObject::SPACING(), inSpacing);
+
+    int outExt[6];
+    double outOrigin[3];
+    double outSpacing[3];
+
+    outInfo->Get(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), outExt);
+    outInfo->Get(vtkDataObject::ORIGIN(), outOrigin);
+    outInfo->Get(vtkDataObject::SPACING(), outSpacing);
+
+    double a1[3], a2[3];
+    vtkNormalizedAxes(this->Axis1, this->Axis2, a1, a2);
+
+    double normal[3];
+    vtkMath::Cross(a1, a2, normal);
+    vtkMath::Normalize(normal);
+
+    double slabStep;
+    const double halfSlab = 0.5 * (this->ComputeSlab(inSpacing, slabStep) - 1) * slabStep;
+
+    // the voxels around the corners of the requested part of the plane, on both sides of the slab
+
+    double bounds[6] = {VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX, VTK_DOUBLE_MIN, VTK_DOUBLE_MAX,
+                        VTK_DOUBLE_MIN};
+
+    for (int corner = 0; corner < 8; corner++) {
+        const double u = outOrigin[0] + outExt[corner & 1] * outSpacing[0];
+        const double v = outOrigin[1] + outExt[2 + ((corner >> 1) & 1)] * outSpacing[1];
+        const double w = (corner & 4) ? halfSlab : -halfSlab;
+
+        for (int axis = 0; axis < 3; axis++) {
+            const double p = this->PlaneOrigin[axis] + u * a1[axis] + v * a2[axis] + w * normal[axis];
+            const double index = (p - inOrigin[axis]) / inSpacing[axis];
+
+            bounds[2 * axis] = std::min(bounds[2 * axis], index);
+            bounds[2 * axis + 1] = std::max(bounds[2 * axis + 1], index);
+        }
+    }
+
+    int updateExt[6];
+    for (int axis = 0; axis < 3; axis++) {
+        const double lower = std::max(std::floor(bounds[2 * axis]), double(inExt[2 * axis]));
+        const double upper = std::min(std::ceil(bounds[2 * axis + 1]), double(inExt[2 * axis + 1]));
+
+        if (lower > upper) {
+            // the plane doesn't intersect the volume
+            updateExt[2 * axis] = inExt[2 * axis];
+            updateExt[2 * axis + 1] = inExt[2 * axis];
+        } else {
+            updateExt[2 * axis] = static_cast<int>(lower);
+            updateExt[2 * axis + 1] = static_cast<int>(upper);
+        }
+    }
+
+    inInfo->Set(vtkStreamingDemandDrivenPipeline::UPDATE_EXTENT(), updateExt, 6);
+
+    return 1;
+}
+
+//------------------------------------------------------------------------------
+void vtkImagePlaneResampler::ThreadedRequestData(vtkInformation *, vtkInformationVector **, vtkInformationVector *,
+                                                 vtkImageData ***inData, vtkImageData **outData, int outExt[6],
+                                                 int threadId)
+{
+    vtkImageData *input = inData[0][0];
+    vtkImageData *output = outData[0];
+
+    double a1[3], a2[3];
+    if (!vtkNormalizedAxes(this->Axis1, this->Axis2, a1, a2)) {
+        return;
+    }
+
+    const int numComponents = input->GetNumberOfScalarComponents();
+    if ((this->Component < 0) || (this->Component >= numComponents)) {
+        if (threadId == 0) {
+            vtkErrorMacro("Invalid component " << this->Component);
+        }
+        return;
+    }
+
+    int inExt[6];
+    input->GetExtent(inExt);
+
+    void *inPtr = input->GetScalarPointerForExtent(inExt);
+
+    // the samples of the slab in continuous indexes of the volume
+
+    const double *inSpacing = input->GetSpacing();
+
+    double normal[3];
+    vtkMath::Cross(a1, a2, normal);
+    vtkMath::Normalize(normal);
+
+    double slabStep;
+
+    vtkSlab slab;
+    slab.numSamples = this->ComputeSlab(inSpacing, slabStep);
+    slab.mode = this->SlabMode;
+
+    for (int axis = 0; axis < 3; axis++) {
+        slab.step[axis] = slabStep * normal[axis] / inSpacing[axis];
+        slab.first[axis] = -0.5 * (slab.numSamples - 1) * slab.step[axis];
+    }
+
+    switch (input->GetScalarType()) {
+        vtkTemplateMacro(vtkResamplePlane(input, static_cast<const VTK_TT *>(inPtr) + this->Component, output, outExt,
+                                          this->PlaneOrigin, a1, a2, this->ClipPolygon, slab));
+    default :
+        if (threadId == 0) {
+            vtkErrorMacro("Unsupported scalar type");
+        }
+    }
+}
+
+//------------------------------------------------------------------------------
+void vtkImagePlaneResampler::PrintSelf(ostream &os, vtkIndent indent)
+{
+    this->Superclass::PrintSelf(os, indent);
+
+    os << indent << "PlaneOrigin: (" << this->PlaneOrigin[0] << ", " << this->PlaneOrigin[1] << ", "
+       << this->PlaneOrigin[2] << ")\n";
+    os << indent << "Axis1: (" << this->Axis1[0] << ", " << this->Axis1[1] << ", " << this->Axis1[2] << ")\n";
+    os << indent << "Axis2: (" << this->Axis2[0] << ", " << this->Axis2[1] << ", " << this->Axis2[2] << ")\n";
+    os << indent << "PlaneExtent: (" << this->PlaneExtent[0] << ", " << this->PlaneExtent[1] << ", "
+       << this->PlaneExtent[2] << ", " << this->PlaneExtent[3] << ")\n";
+    os << indent << "OutputSpacing: (" << this->OutputSpacing[0] << ", " << this->OutputSpacing[1] << ")\n";
+    os << indent << "Component: " << this->Component << "\n";
+    os << indent << "SlabThickness: " << this->SlabThickness << "\n";
+    os << indent << "SlabSpacing: " << this->SlabSpacing << "\n";
+    os << indent << "SlabMode: " << this->SlabMode << "\n";
+    os << indent << "ClipPolygon: " << this->GetNumberOfClipPolygonPoints() << " points\n";
+}
@@ -0,0 +1,193 @@
+/**
+ * @class vtkImagePlaneResampler
+ * @brief resample a volume on an oblique plane into a regular 2D grid
+ *
+ * vtkImagePlaneResampler samples the point scalars of a vtkImageData on a
+ * plane, that is given by an origin and two in-plane axes. The output is a
+ * vtkImageData with a single slice: point (i, j) is the trilinear
+ * interpolation of the volume at
+ *
+ * @code
+ *  PlaneOrigin + (u0 + i * su) * Axis1 + (v0 + j * sv) * Axis2
+ * @endcode
+ *
+ * where [u0, u1] x [v0, v1] is the PlaneExtent and (su, sv) the
+ * OutputSpacing. The origin and spacing of the output are the plane
+ * coordinates (u0, v0) and (su, sv), so that the output can be used
+ * as a matrix of equidistant values without any transformation.
+ *
+ * Positions outside of the volume are NaN. The scalars of the output
+ * are float, only a single component of the input is resampled.
+ *
+ * With a SlabThickness > 0 each output point combines the samples along
+ * the normal of the plane, that are inside of the slab: maximum, minimum or
+ * mean intensity projection. NaN samples ( outside of the volume ) are
+ * ignored. The samples of a slab are accumulated chunk by chunk of a row,
+ * so that the accumulators stay in the cache and the combination is vectorized.
+ *
+ * The sampled area can be limited to a rectangle ( PlaneExtent ) or to a
+ * polygon in plane coordinates ( ClipPolygon ). Only the points inside are
+ * interpolated, the others are NaN, so the cost depends on the size of the
+ * area and not on the cross-section of the volume.
+ *
+ * Compared to vtkCutter no polygons are generated, the shape of the grid
+ * is known in advance and the output rows are distributed to the threads
+ * of vtkThreadedImageAlgorithm. The positions and weights of a row are
+ * calculated in batches, that can be vectorized by the compiler.
+ *
+ * @sa vtkImageReslice
+ */
+
+#ifndef vtkImagePlaneResampler_h
+#define vtkImagePlaneResampler_h
+
+#include "vtkThreadedImageAlgorithm.h"
+
+#include <vector>
+
+class vtkImagePlaneResampler : public vtkThreadedImageAlgorithm
+{
+public:
+    static vtkImagePlaneResampler *New();
+    vtkTypeMacro(vtkImagePlaneResampler, vtkThreadedImageAlgorithm);
+    void PrintSelf(ostream &os, vtkIndent indent) override;
+
+    ///@{
+    /**
+     * Origin of the plane in world coordinates.
+     */
+    vtkSetVector3Macro(PlaneOrigin, double);
+    vtkGetVector3Macro(PlaneOrigin, double);
+    ///@}
+
+    ///@{
+    /**
+     * Axes of the plane, the columns of the output follow Axis1 and the
+     * rows Axis2. The axes are normalized, they must not be parallel.
+     * Default is the x and y axis.
+     */
+    vtkSetVector3Macro(Axis1, double);
+    vtkGetVector3Macro(Axis1, double);
+    vtkSetVector3Macro(Axis2, double);
+    vtkGetVector3Macro(Axis2, double);
+    ///@}
+
+    /**
+     * Set origin and axes from a point on the plane and its normal.
+     * Axis1 is horizontal ( perpendicular to the z axis ) and Axis2 is the
+     * cross product of normal and Axis1, what is the z axis for vertical planes.
+     * For horizontal planes the axes are the x and y axis.
+     */
+    void SetPlane(const double origin[3], const double normal[3]);
+
+    ///@{
+    /**
+     * Area of the plane ( u0, u1, v0, v1 ) in world units along the axes,
+     * relative to the PlaneOrigin. When u0 > u1 ( or v0 > v1 ), what is the default,
+     * the range along that axis is the projection of the bounds of the volume
+     * onto the plane, limited to the bounding rectangle of the ClipPolygon.
+     */
+    vtkSetVector4Macro(PlaneExtent, double);
+    vtkGetVector4Macro(PlaneExtent, double);
+    ///@}
+
+    ///@{
+    /**
+     * Distance between the output points along Axis1 and Axis2. A spacing <= 0,
+     * what is the default, is replaced by the smallest spacing of the volume.
+     */
+    vtkSetVector2Macro(OutputSpacing, double);
+    vtkGetVector2Macro(OutputSpacing, double);
+    ///@}
+
+    ///@{
+    /**
+     * Polygon in plane coordinates ( u, v pairs, relative to the PlaneOrigin ),
+     * that limits the sampled points. Points outside of the polygon are NaN,
+     * self intersecting polygons follow the even-odd rule.
+     * A polygon with less than 3 points, what is the default, disables clipping.
+     */
+    void SetClipPolygon(int numPoints, const double *uv);
+    void RemoveClipPolygon();
+    int GetNumberOfClipPolygonPoints() const;
+    const double *GetClipPolygon() const;
+    ///@}
+
+    /**
+     * Projection of the samples of a slab
+     */
+    enum SlabModes
+    {
+        SlabMax = 0,
+        SlabMin,
+        SlabMean
+    };
+
+    ///@{
+    /**
+     * Thickness of the slab along the normal of the plane in world units,
+     * the slab is centered at the plane. Default is 0, a single sample.
+     */
+    vtkSetMacro(SlabThickness, double);
+    vtkGetMacro(SlabThickness, double);
+    ///@}
+
+    ///@{
+    /**
+     * Distance between the samples of a slab. A spacing <= 0, what is the
+     * default, is replaced by the smallest spacing of the volume.
+     */
+    vtkSetMacro(SlabSpacing, double);
+    vtkGetMacro(SlabSpacing, double);
+    ///@}
+
+    ///@{
+    /**
+     * Projection of the samples of a slab. Default is SlabMax.
+     */
+    vtkSetClampMacro(SlabMode, int, SlabMax, SlabMean);
+    vtkGetMacro(SlabMode, int);
+    void SetSlabModeToMax() { this->SetSlabMode(SlabMax); }
+    void SetSlabModeToMin() { this->SetSlabMode(SlabMin); }
+    void SetSlabModeToMean() { this->SetSlabMode(SlabMean); }
+    ///@}
+
+    ///@{
+    /**
+     * Component of the input scalars, that is resampled. Default is 0.
+     */
+    vtkSetMacro(Component, int);
+    vtkGetMacro(Component, int);
+    ///@}
+
+protected:
+    vtkImagePlaneResampler();
+    ~vtkImagePlaneResampler() override;
+
+    int RequestInformation(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+    int RequestUpdateExtent(vtkInformation *, vtkInformationVector **, vtkInformationVector *) override;
+
+    void ThreadedRequestData(vtkInformation *request, vtkInformationVector **inputVector,
+                             vtkInformationVector *outputVector, vtkImageData ***inData, vtkImageData **outData,
+                             int outExt[6], int threadId) override;
+
+    double PlaneOrigin[3];
+    double Axis1[3];
+    double Axis2[3];
+    double PlaneExtent[4];
+    double OutputSpacing[2];
+    int Component;
+    double SlabThickness;
+    double SlabSpacing;
+    int SlabMode;
+    std::vector<double> ClipPolygon;
+
+private:
+    vtkImagePlaneResampler(const vtkImagePlaneResampler &) = delete;
+    void operator=(const vtkImagePlaneResampler &) = delete;
+
+    bool ComputeGeometry(vtkInformation *inInfo, double extent[4], double spacing[2], int size[2]);
+    int ComputeSlab(const double inSpacing[3], double &step) const;
+};
+
+#endif
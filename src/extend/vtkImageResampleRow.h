@@ -0,0 +1,104 @@
+/**
+ * Trilinear interpolation of equidistant positions along a line in a volume,
+ * shared by the resamplers of planes and fences. Internal header, it is not
+ * part of the interface of the extend library.
+ */
+
+#ifndef vtkImageResampleRow_h
+#define vtkImageResampleRow_h
+
+#include "vtkType.h"
+
+#include <algorithm>
+#include <limits>
+
+// number of samples, whose positions are calculated in one pass
+const int vtkResampleBatchSize = 64;
+
+/*
+ * Trilinear interpolation of numSamples equidistant positions, given in
+ * continuous indexes of the volume: c0 is the first position, dc the step.
+ */
+template <class T>
+inline void vtkResampleRow(const T *scalars, const vtkIdType inc[3], const int size[3], const double c0[3],
+                           const double dc[3], int numSamples, float *out)
+{
+    const float nan = std::numeric_limits<float>::quiet_NaN();
+
+    double maxIndex[3];
+    int maxCell[3];
+    vtkIdType step[3];
+
+    for (int axis = 0; axis < 3; axis++) {
+        maxIndex[axis] = size[axis] - 1.0;
+        maxCell[axis] = std::max(size[axis] - 2, 0);
+
+        // a flat axis has no neighbor
+        step[axis] = (size[axis] > 1) ? inc[axis] : 0;
+    }
+
+    vtkIdType offsets[vtkResampleBatchSize];
+    double tx[vtkResampleBatchSize];
+    double ty[vtkResampleBatchSize];
+    double tz[vtkResampleBatchSize];
+    int inside[vtkResampleBatchSize];
+
+    for (int first = 0; first < numSamples; first += vtkResampleBatchSize) {
+        const int n = std::min(vtkResampleBatchSize, numSamples - first);
+
+        // positions and weights without branches
+
+        for (int i = 0; i < n; i++) {
+            const double x = c0[0] + (first + i) * dc[0];
+            const double y = c0[1] + (first + i) * dc[1];
+            const double z = c0[2] + (first + i) * dc[2];
+
+            inside[i] = (x >= 0.0) & (x <= maxIndex[0]) & (y >= 0.0) & (y <= maxIndex[1]) & (z >= 0.0)
+                        & (z <= maxIndex[2]);
+
+            const double fx = std::min(std::max(x, 0.0), maxIndex[0]);
+            const double fy = std::min(std::max(y, 0.0), maxIndex[1]);
+            const double fz = std::min(std::max(z, 0.0), maxIndex[2]);
+
+            const int ix = std::min(static_cast<int>(fx), maxCell[0]);
+            const int iy = std::min(static_cast<int>(fy), maxCell[1]);
+            const int iz = std::min(static_cast<int>(fz), maxCell[2]);
+
+            tx[i] = fx - ix;
+            ty[i] = fy - iy;
+            tz[i] = fz - iz;
+
+            offsets[i] = ix * inc[0] + iy * inc[1] + iz * inc[2];
+        }
+
+        for (int i = 0; i < n; i++) {
+            if (!inside[i]) {
+                out[first + i] = nan;
+                continue;
+            }
+
+            const T *p = scalars + offsets[i];
+
+            const double v000 = p[0];
+            const double v100 = p[step[0]];
+            const double v010 = p[step[1]];
+            const double v110 = p[step[0] + step[1]];
+            const double v001 = p[step[2]];
+            const double v101 = p[step[0] + step[2]];
+            const double v011 = p[step[1] + step[2]];
+            const double v111 = p[step[0] + step[1] + step[2]];
+
+            const double v00 = v000 + tx[i] * (v100 - v000);
+            const double v10 = v010 + tx[i] * (v110 - v010);
+            const double v01 = v001 + tx[i] * (v101 - v001);
+            const double v11 = v011 + tx[i] * (v111 - v011);
+
+            const double v0 = v00 + ty[i] * (v10 - v00);
+            const double v1 = v01 + ty[i] * (v11 - v01);
+
+            out[first + i] = static_cast<float>(v0 + tz[i] * (v1 - v0));
+        }
+    }
+}
+
+#endif
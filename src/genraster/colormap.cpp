@@ -3,6 +3,10 @@
 #include <QVector>
 
 #include "interval.h"
+#include "simd.h"
+
+// number of entries of the lookup table of LinearColorMap
+static const int qwtLookupTableSize = 4096;
 
 static inline QRgb qwtHsvToRgb(int h, int s, int v, int a)
 {
@@ -48,6 +52,42 @@ static inline QRgb qwtHsvToRgb(int h, int s, int v, int a)
 #endif
 }
 
+/*
+    indexes[i] = ( values[i] - min ) * scale + offset, truncated and bounded
+    to [0, maxIndex]. NaN values are mapped to 0.
+ */
+template <typename Function>
+static inline void qwtScaledIndexes(const double *values, int numValues, double min, double scale, double offset,
+                                    int maxIndex, Function function)
+{
+    const QwtVector vMin = qwtVectorSet(min);
+    const QwtVector vScale = qwtVectorSet(scale);
+    const QwtVector vOffset = qwtVectorSet(offset);
+    const QwtVector vZero = qwtVectorSet(0.0);
+    const QwtVector vMax = qwtVectorSet(maxIndex);
+
+    int i = 0;
+    for (; i + QwtVectorSize <= numValues; i += QwtVectorSize) {
+        QwtVector v = qwtVectorMul(qwtVectorSub(qwtVectorLoad(values + i), vMin), vScale);
+        v = qwtVectorMin(qwtVectorMax(qwtVectorAdd(v, vOffset), vZero), vMax);
+
+        int indexes[QwtVectorSize];
+        qwtVectorTruncate(v, indexes);
+
+        for (int k = 0; k < QwtVectorSize; k++) {
+            function(i + k, indexes[k]);
+        }
+    }
+
+    for (; i < numValues; i++) {
+        double v = (values[i] - min) * scale + offset;
+        v = (v > 0.0) ? v : 0.0;
+        v = (v < maxIndex) ? v : maxIndex;
+
+        function(i, int(v));
+    }
+}
+
 class LinearColorMap::ColorStops
 {
 public:
@@ -260,6 +300,42 @@ uint ColorMap::colorIndex(int numColors, const Interval &interval, double value)
     return static_cast<unsigned int>(v + 0.5);
 }
 
+/*!
+   \brief Map the values of a scanline into RGB values
+
+   The default implementation calls rgb() for each value.
+
+   \param interval Range for all values
+   \param values Values to map
+   \param numValues Number of values
+   \param rgbs Array of at least numValues RGB values
+ */
+void ColorMap::rgbValues(const Interval &interval, const double *values, int numValues, QRgb *rgbs) const
+{
+    for (int i = 0; i < numValues; i++) {
+        rgbs[i] = rgb(interval, values[i]);
+    }
+}
+
+/*!
+   \brief Map the values of a scanline into color indexes
+
+   The default implementation calls colorIndex() for each value.
+
+   \param numColors Number of colors
+   \param interval Range for all values
+   \param values Values to map
+   \param numValues Number of values
+   \param indexes Array of at least numValues indexes
+ */
+void ColorMap::colorIndexes(int numColors, const Interval &interval, const double *values, int numValues,
+                            uint *indexes) const
+{
+    for (int i = 0; i < numValues; i++) {
+        indexes[i] = colorIndex(numColors, interval, values[i]);
+    }
+}
+
 /*!
    Build and return a color map of 256 colors
 
@@ -307,8 +383,21 @@ QVector<QRgb> ColorMap::colorTable(int numColors) const
 class LinearColorMap::PrivateData
 {
 public:
+    void updateLookupTable()
+    {
+        lookupTable.resize(qwtLookupTableSize);
+
+        const double step = 1.0 / (qwtLookupTableSize - 1);
+        for (int i = 0; i < qwtLookupTableSize; i++) {
+            lookupTable[i] = colorStops.rgb(mode, i * step);
+        }
+    }
+
     ColorStops colorStops;
     LinearColorMap::Mode mode;
+
+    // colors for equidistant positions in [0.0, 1.0]
+    QVector<QRgb> lookupTable;
 };
 
 /*!
@@ -339,6 +428,20 @@ LinearColorMap::LinearColorMap(const QColor &color1, const QColor &color2, Color
     setColorInterval(color1, color2);
 }
 
+/*!
+   Copy a color map
+
+   The color stops and the lookup table are implicitly shared with other,
+   so that copies of a color map, f.e. for spectrograms rendered in
+   parallel, don't need to recalculate the lookup table.
+
+   \param other Color map to copy
+ */
+LinearColorMap::LinearColorMap(const LinearColorMap &other) : ColorMap(other.format())
+{
+    m_data = new PrivateData(*other.m_data);
+}
+
 // ! Destructor
 LinearColorMap::~LinearColorMap()
 {
@@ -356,7 +459,10 @@ LinearColorMap::~LinearColorMap()
  */
 void LinearColorMap::setMode(Mode mode)
 {
-    m_data->mode = mode;
+    if (mode != m_data->mode) {
+        m_data->mode = mode;
+        m_data->updateLookupTable();
+    }
 }
 
 /*!
@@ -383,6 +489,8 @@ void LinearColorMap::setColorInterval(const QColor &color1, const QColor &color2
     m_data->colorStops = ColorStops();
     m_data->colorStops.insert(0.0, color1);
     m_data->colorStops.insert(1.0, color2);
+
+    m_data->updateLookupTable();
 }
 
 /*!
@@ -399,6 +507,7 @@ void LinearColorMap::addColorStop(double value, const QColor &color)
 {
     if ((value >= 0.0) && (value <= 1.0)) {
         m_data->colorStops.insert(value, color);
+        m_data->updateLookupTable();
     }
 }
 
@@ -474,4 +583,67 @@ uint LinearColorMap::colorIndex(int numColors, const Interval &interval, double
 
     const double v = (numColors - 1) * (value - interval.minValue()) / width;
     return static_cast<unsigned int>((m_data->mode == FixedColors) ? v : v + 0.5);
-}
\ No newline at end of file
+}
+
+/*!
+   \brief Map the values of a scanline into RGB values
+
+   The colors are taken from a lookup table of 4096 colors for equidistant
+   positions, that is rebuilt whenever the color stops or the mode
+   are changed. So the result might differ slightly from rgb().
+
+   \param interval Range for all values
+   \param values Values to map
+   \param numValues Number of values
+   \param rgbs Array of at least numValues RGB values
+ */
+void LinearColorMap::rgbValues(const Interval &interval, const double *values, int numValues, QRgb *rgbs) const
+{
+    const double width = interval.width();
+    if (width <= 0.0) {
+        for (int i = 0; i < numValues; i++) {
+            rgbs[i] = 0u;
+        }
+
+        return;
+    }
+
+    const int maxIndex = qwtLookupTableSize - 1;
+    const double offset = (m_data->mode == FixedColors) ? 0.0 : 0.5;
+
+    const QRgb *lookupTable = m_data->lookupTable.constData();
+
+    qwtScaledIndexes(values, numValues, interval.minValue(), maxIndex / width, offset, maxIndex,
+                     [rgbs, lookupTable](int i, int index) { rgbs[i] = lookupTable[index]; });
+}
+
+/*!
+   \brief Map the values of a scanline into color indexes
+
+   \param numColors Size of the color table
+   \param interval Range for all values
+   \param values Values to map
+   \param numValues Number of values
+   \param indexes Array of at least numValues indexes
+
+   \note NaN values are mapped to 0
+   \sa colorIndex()
+ */
+void LinearColorMap::colorIndexes(int numColors, const Interval &interval, const double *values, int numValues,
+                                  uint *indexes) const
+{
+    const double width = interval.width();
+    if (width <= 0.0) {
+        for (int i = 0; i < numValues; i++) {
+            indexes[i] = 0;
+        }
+
+        return;
+    }
+
+    const int maxIndex = numColors - 1;
+    const double offset = (m_data->mode == FixedColors) ? 0.0 : 0.5;
+
+    qwtScaledIndexes(values, numValues, interval.minValue(), maxIndex / width, offset, maxIndex,
+                     [indexes](int i, int index) { indexes[i] = index; });
+}
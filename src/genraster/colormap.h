@@ -66,6 +66,11 @@ public:
 
     virtual uint colorIndex(int numColors, const Interval &interval, double value) const;
 
+    virtual void rgbValues(const Interval &, const double *values, int numValues, QRgb *rgbs) const;
+
+    virtual void colorIndexes(int numColors, const Interval &, const double *values, int numValues,
+                              uint *indexes) const;
+
     QColor color(const Interval &, double value) const;
     virtual QVector<QRgb> colorTable(int numColors) const;
     virtual QVector<QRgb> colorTable256() const;
@@ -103,6 +108,8 @@ public:
 
     LinearColorMap(const QColor &from, const QColor &to, ColorMap::Format = ColorMap::RGB);
 
+    LinearColorMap(const LinearColorMap &);
+
     virtual ~LinearColorMap();
 
     void setMode(Mode);
@@ -119,6 +126,11 @@ public:
 
     virtual uint colorIndex(int numColors, const Interval &, double value) const override;
 
+    virtual void rgbValues(const Interval &, const double *values, int numValues, QRgb *rgbs) const override;
+
+    virtual void colorIndexes(int numColors, const Interval &, const double *values, int numValues,
+                              uint *indexes) const override;
+
     class ColorStops;
 
 private:
@@ -0,0 +1,638 @@
+﻿#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QVector>
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <limits>
+
+#include "colormap.h"
+#include "interval.h"
+#include "matrixrasterdata.h"
+#include "plotspectrogram.h"
+#include "rasterdata.h"
+#include "scalemap.h"
+
+/*
+    Benchmarks of the hot paths of genraster on synthetic matrices:
+
+        genraster_bench [-m WxH] [-i WxH] [-g gaps] [-n repeat]
+                        [-t threads] [-l levels] [-o result.json]
+
+    Each benchmark is run once to warm up and then repeat times. The result
+    is written as JSON with the median and the 95th percentile of the
+    run times and the number of pixels ( or raster points ) per second
+    of the median, so that the results of different builds can be compared.
+
+    The resampling benchmarks run for a QwtMatrixRasterData ( "storage": "double" )
+    and a MatrixRasterData<float> of the same matrix ( "storage": "float" ).
+    The float results include "maxRelativeError": the largest difference of
+    the values to the double matrix relative to the largest absolute value.
+
+    qwtExpandImage() and qwtToRgba() are internal to PlotRasterItemBase,
+    they are measured by drawing with and without them: "expandImage" and
+    "toRgba" are the draws including them, "expandImageBaseline" and
+    "toRgbaBaseline" the same draws without them.
+ */
+
+namespace
+{
+
+class Options
+{
+public:
+    Options() : matrixSize(1024, 1024), imageSize(1024, 768), gaps(0.0), repeat(10)
+    {
+        threads << 1;
+        if (QThread::idealThreadCount() > 1) {
+            threads << QThread::idealThreadCount();
+        }
+
+        levels << 10 << 50;
+    }
+
+    QSize matrixSize;
+    QSize imageSize;
+    double gaps;
+    int repeat;
+
+    QList<int> threads;
+    QList<int> levels;
+
+    QString output;
+};
+
+// ! Run times of a benchmark
+class Result
+{
+public:
+    QString name;
+    QStringList parameters;
+
+    qint64 numPixels;
+    QVector<qint64> nsecs;
+};
+
+const char *qwtModeName(QwtMatrixRasterData::ResampleMode mode)
+{
+    switch (mode) {
+    case QwtMatrixRasterData::NearestNeighbour :
+        return "nearest";
+    case QwtMatrixRasterData::BilinearInterpolation :
+        return "bilinear";
+    case QwtMatrixRasterData::BicubicInterpolation :
+        return "bicubic";
+    }
+
+    return "";
+}
+
+QString qwtParameter(const char *name, const QString &value)
+{
+    return QString("\"%1\": \"%2\"").arg(name).arg(value);
+}
+
+QString qwtParameter(const char *name, int value)
+{
+    return QString("\"%1\": %2").arg(name).arg(value);
+}
+
+QString qwtParameter(const char *name, double value)
+{
+    return QString("\"%1\": %2").arg(name).arg(value, 0, 'g', 3);
+}
+
+bool qwtParseSize(const QString &text, QSize &size)
+{
+    const QStringList values = text.split('x');
+    if (values.size() != 2) {
+        return false;
+    }
+
+    bool ok1, ok2;
+    size = QSize(values[0].toInt(&ok1), values[1].toInt(&ok2));
+
+    return ok1 && ok2 && (size.width() > 1) && (size.height() > 1);
+}
+
+bool qwtParseList(const QString &text, QList<int> &list)
+{
+    list.clear();
+
+    const QStringList values = text.split(',');
+    for (int i = 0; i < values.size(); i++) {
+        bool ok;
+        const int value = values[i].toInt(&ok);
+        if (!ok || (value <= 0)) {
+            return false;
+        }
+
+        list += value;
+    }
+
+    return !list.isEmpty();
+}
+
+bool qwtParseOptions(const QStringList &arguments, Options &options)
+{
+    for (int i = 1; i < arguments.size(); i++) {
+        const QString &option = arguments[i];
+        if (i + 1 >= arguments.size()) {
+            return false;
+        }
+
+        const QString value = arguments[++i];
+        bool ok = true;
+
+        if ((option == "-m") || (option == "--matrix")) {
+            ok = qwtParseSize(value, options.matrixSize);
+        } else if ((option == "-i") || (option == "--image")) {
+            ok = qwtParseSize(value, options.imageSize);
+        } else if ((option == "-g") || (option == "--gaps")) {
+            options.gaps = value.toDouble(&ok);
+            ok = ok && (options.gaps >= 0.0) && (options.gaps < 1.0);
+        } else if ((option == "-n") || (option == "--repeat")) {
+            options.repeat = value.toInt(&ok);
+            ok = ok && (options.repeat > 0);
+        } else if ((option == "-t") || (option == "--threads")) {
+            ok = qwtParseList(value, options.threads);
+        } else if ((option == "-l") || (option == "--levels")) {
+            ok = qwtParseList(value, options.levels);
+        } else if ((option == "-o") || (option == "--output")) {
+            options.output = value;
+        } else {
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid option: " << qPrintable(option) << " " << qPrintable(value) << std::endl;
+            return false;
+        }
+    }
+
+    return true;
+}
+
+void qwtPrintUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " [options]\n"
+              << "\n"
+              << "  -m, --matrix <WxH>     Size of the synthetic matrix, default: 1024x1024\n"
+              << "  -i, --image <WxH>      Size of the rendered images, default: 1024x768\n"
+              << "  -g, --gaps <density>   Fraction of NaN values in [0.0, 1.0[, default: 0.0\n"
+              << "  -n, --repeat <n>       Measured runs of each benchmark, default: 10\n"
+              << "  -t, --threads <list>   Render thread counts, default: 1,<ideal thread count>\n"
+              << "  -l, --levels <list>    Contour level counts, default: 10,50\n"
+              << "  -o, --output <file>    JSON result, default: stdout\n";
+}
+
+/*
+    A smooth surface with some peaks. Gaps are scattered
+    by a fixed pseudo random sequence, so that the matrices
+    of different runs are identical.
+ */
+QVector<double> qwtSyntheticMatrix(const QSize &size, double gaps)
+{
+    QVector<double> values(size.width() * size.height());
+
+    quint32 seed = 12345;
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+
+    double *v = values.data();
+    for (int row = 0; row < size.height(); row++) {
+        const double y = double(row) / size.height();
+
+        for (int col = 0; col < size.width(); col++) {
+            const double x = double(col) / size.width();
+
+            seed = seed * 1664525u + 1013904223u;
+            if ((seed >> 8) < gaps * (1u << 24)) {
+                *v++ = nan;
+            } else {
+                *v++ = std::sin(12.0 * x) * std::cos(9.0 * y) + 0.5 * std::sin(40.0 * x * y);
+            }
+        }
+    }
+
+    return values;
+}
+
+QwtMatrixRasterData *qwtCreateData(const QVector<double> &matrix, const QSize &size, double gaps,
+                                   QwtMatrixRasterData::ResampleMode mode)
+{
+    QwtMatrixRasterData *data = new QwtMatrixRasterData();
+    data->setValueMatrix(matrix, size.width());
+    data->setInterval(Qt::XAxis, Interval(0.0, size.width()));
+    data->setInterval(Qt::YAxis, Interval(0.0, size.height()));
+    data->setInterval(Qt::ZAxis, Interval(-1.5, 1.5));
+    data->setResampleMode(mode);
+    data->setAttribute(RasterData::WithoutGaps, gaps == 0.0);
+
+    return data;
+}
+
+MatrixRasterData<float> *qwtCreateFloatData(const QVector<double> &matrix, const QSize &size, double gaps,
+                                            QwtMatrixRasterData::ResampleMode mode)
+{
+    QVector<float> values(matrix.size());
+    for (int i = 0; i < matrix.size(); i++) {
+        values[i] = static_cast<float>(matrix[i]);
+    }
+
+    MatrixRasterData<float> *data = new MatrixRasterData<float>();
+    data->setValueMatrix(values, size.width());
+    data->setInterval(Qt::XAxis, Interval(0.0, size.width()));
+    data->setInterval(Qt::YAxis, Interval(0.0, size.height()));
+    data->setInterval(Qt::ZAxis, Interval(-1.5, 1.5));
+    data->setResampleMode(mode);
+    data->setAttribute(RasterData::WithoutGaps, gaps == 0.0);
+
+    return data;
+}
+
+/*
+    Distance between the pixels of an image, whose first and last pixels
+    are on the borders of the area, like PlotRasterItemBase::imageMap()
+    maps them and RasterData::initRaster() expects them
+ */
+double qwtPixelStep(double length, int numPixels)
+{
+    return length / qMax(numPixels - 1, 1);
+}
+
+/*
+    The maps PlotRasterItemBase::imageMap() builds from the canvas maps
+    of the area, when the data has no pixel size
+ */
+void qwtImageMaps(const QRectF &area, const QSize &imageSize, ScaleMap &xMap, ScaleMap &yMap)
+{
+    xMap.setScaleInterval(area.left(), area.right());
+    xMap.setPaintInterval(0, imageSize.width() - 1);
+
+    yMap.setScaleInterval(area.bottom(), area.top());
+    yMap.setPaintInterval(0, imageSize.height() - 1);
+}
+
+/*
+    The largest difference of the values of 2 raster data objects on the
+    raster of an image, relative to the largest absolute value of reference.
+    NaN values have to be at the same positions.
+ */
+double qwtMaxRelativeError(RasterData *reference, RasterData *data, const QRectF &area, const QSize &imageSize)
+{
+    const double dx = qwtPixelStep(area.width(), imageSize.width());
+    const double dy = qwtPixelStep(area.height(), imageSize.height());
+
+    QVector<double> values1(imageSize.width());
+    QVector<double> values2(imageSize.width());
+
+    reference->initRaster(area, imageSize);
+    data->initRaster(area, imageSize);
+
+    double maxValue = 0.0;
+    double maxError = 0.0;
+
+    for (int row = 0; row < imageSize.height(); row++) {
+        const double y = area.top() + row * dy;
+
+        reference->values(area.left(), dx, y, imageSize.width(), values1.data());
+        data->values(area.left(), dx, y, imageSize.width(), values2.data());
+
+        for (int i = 0; i < imageSize.width(); i++) {
+            const double v1 = values1[i];
+            const double v2 = values2[i];
+
+            if (qIsNaN(v1) || qIsNaN(v2)) {
+                if (qIsNaN(v1) != qIsNaN(v2)) {
+                    maxError = std::numeric_limits<double>::infinity();
+                }
+                continue;
+            }
+
+            maxValue = qMax(maxValue, std::fabs(v1));
+            maxError = qMax(maxError, std::fabs(v1 - v2));
+        }
+    }
+
+    reference->discardRaster();
+    data->discardRaster();
+
+    return (maxValue > 0.0) ? maxError / maxValue : maxError;
+}
+
+LinearColorMap *qwtCreateColorMap(ColorMap::Format format)
+{
+    LinearColorMap *colorMap = new LinearColorMap(Qt::darkBlue, Qt::darkRed, format);
+    colorMap->addColorStop(0.1, Qt::blue);
+    colorMap->addColorStop(0.3, Qt::cyan);
+    colorMap->addColorStop(0.5, Qt::green);
+    colorMap->addColorStop(0.6, Qt::yellow);
+    colorMap->addColorStop(0.9, Qt::red);
+
+    return colorMap;
+}
+
+QList<double> qwtContourLevels(int numLevels)
+{
+    QList<double> levels;
+    for (int i = 0; i < numLevels; i++) {
+        levels += -1.5 + 3.0 * (i + 0.5) / numLevels;
+    }
+
+    return levels;
+}
+
+// ! Gives access to the protected renderImage()
+class BenchSpectrogram : public PlotSpectrogram
+{
+public:
+    using PlotSpectrogram::renderImage;
+};
+
+class Bench
+{
+public:
+    explicit Bench(const Options &options) : m_options(options) {}
+
+    template <typename Function>
+    void run(const QString &name, const QStringList &parameters, qint64 numPixels, Function function)
+    {
+        std::cerr << qPrintable(name) << " " << qPrintable(parameters.join(", ")) << std::endl;
+
+        Result result;
+        result.name = name;
+        result.parameters = parameters;
+        result.numPixels = numPixels;
+
+        function(); // warm up
+
+        QElapsedTimer timer;
+        for (int i = 0; i < m_options.repeat; i++) {
+            timer.start();
+            function();
+            result.nsecs += timer.nsecsElapsed();
+        }
+
+        m_results += result;
+    }
+
+    void write(QTextStream &stream) const;
+
+private:
+    const Options &m_options;
+    QList<Result> m_results;
+};
+
+void Bench::write(QTextStream &stream) const
+{
+    stream << "{\n";
+    stream << "  \"qt\": \"" << QT_VERSION_STR << "\",\n";
+    stream << "  \"idealThreadCount\": " << QThread::idealThreadCount() << ",\n";
+    stream << "  \"matrix\": [" << m_options.matrixSize.width() << ", " << m_options.matrixSize.height() << "],\n";
+    stream << "  \"image\": [" << m_options.imageSize.width() << ", " << m_options.imageSize.height() << "],\n";
+    stream << "  \"gaps\": " << m_options.gaps << ",\n";
+    stream << "  \"repeat\": " << m_options.repeat << ",\n";
+    stream << "  \"benchmarks\": [\n";
+
+    for (int i = 0; i < m_results.size(); i++) {
+        const Result &result = m_results[i];
+
+        QVector<qint64> nsecs = result.nsecs;
+        std::sort(nsecs.begin(), nsecs.end());
+
+        const double median = 0.5 * (nsecs[(nsecs.size() - 1) / 2] + nsecs[nsecs.size() / 2]);
+        const double p95 = nsecs[qMax(int(std::ceil(0.95 * nsecs.size())) - 1, 0)];
+
+        stream << "    {\"name\": \"" << result.name << "\", ";
+        for (int j = 0; j < result.parameters.size(); j++) {
+            stream << result.parameters[j] << ", ";
+        }
+
+        stream << "\"median_ms\": " << median * 1e-6 << ", ";
+        stream << "\"p95_ms\": " << p95 * 1e-6 << ", ";
+        stream << "\"pixels_per_s\": " << qint64(result.numPixels / (median * 1e-9)) << "}";
+        stream << ((i < m_results.size() - 1) ? ",\n" : "\n");
+    }
+
+    stream << "  ]\n";
+    stream << "}\n";
+}
+
+} // namespace
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    Options options;
+    if (!qwtParseOptions(a.arguments(), options)) {
+        qwtPrintUsage(argv[0]);
+        return 1;
+    }
+
+    const QSize &matrixSize = options.matrixSize;
+    const QSize &imageSize = options.imageSize;
+
+    const QVector<double> matrix = qwtSyntheticMatrix(matrixSize, options.gaps);
+
+    const qint64 numPixels = qint64(imageSize.width()) * imageSize.height();
+    const QRectF area(0.0, 0.0, matrixSize.width(), matrixSize.height());
+
+    // renderImage() gets the maps, that draw() would pass to it
+
+    ScaleMap xMap;
+    ScaleMap yMap;
+    qwtImageMaps(area, imageSize, xMap, yMap);
+
+    const QwtMatrixRasterData::ResampleMode modes[] = {QwtMatrixRasterData::NearestNeighbour,
+                                                       QwtMatrixRasterData::BilinearInterpolation,
+                                                       QwtMatrixRasterData::BicubicInterpolation};
+
+    Bench bench(options);
+
+    for (QwtMatrixRasterData::ResampleMode mode : modes) {
+        QScopedPointer<QwtMatrixRasterData> data(qwtCreateData(matrix, matrixSize, options.gaps, mode));
+        QScopedPointer<MatrixRasterData<float> > floatData(qwtCreateFloatData(matrix, matrixSize, options.gaps, mode));
+
+        const QStringList modeParameters = QStringList() << qwtParameter("resampleMode", qwtModeName(mode));
+
+        const QStringList parameters = QStringList(modeParameters) << qwtParameter("storage", "double");
+
+        const QStringList floatParameters =
+            QStringList(modeParameters)
+            << qwtParameter("storage", "float")
+            << qwtParameter("maxRelativeError", qwtMaxRelativeError(data.data(), floatData.data(), area, imageSize));
+
+        // the positions of the pixels in renderImage()
+        const double dx = qwtPixelStep(area.width(), imageSize.width());
+        const double dy = qwtPixelStep(area.height(), imageSize.height());
+
+        volatile double sink = 0.0;
+
+        bench.run("value", parameters, numPixels, [&]() {
+            data->initRaster(area, imageSize);
+
+            double sum = 0.0;
+            for (int row = 0; row < imageSize.height(); row++) {
+                const double y = area.top() + row * dy;
+                for (int col = 0; col < imageSize.width(); col++) {
+                    sum += data->value(area.left() + col * dx, y);
+                }
+            }
+
+            data->discardRaster();
+            sink = sum;
+        });
+
+        QVector<double> values(imageSize.width());
+
+        bench.run("values", parameters, numPixels, [&]() {
+            data->initRaster(area, imageSize);
+
+            for (int row = 0; row < imageSize.height(); row++) {
+                data->values(area.left(), dx, area.top() + row * dy, imageSize.width(), values.data());
+            }
+
+            data->discardRaster();
+            sink = values[0];
+        });
+
+        bench.run("values", floatParameters, numPixels, [&]() {
+            floatData->initRaster(area, imageSize);
+
+            for (int row = 0; row < imageSize.height(); row++) {
+                floatData->values(area.left(), dx, area.top() + row * dy, imageSize.width(), values.data());
+            }
+
+            floatData->discardRaster();
+            sink = values[0];
+        });
+
+        const ColorMap::Format formats[] = {ColorMap::RGB, ColorMap::Indexed};
+
+        for (ColorMap::Format format : formats) {
+            for (int numThreads : options.threads) {
+                for (int storage = 0; storage < 2; storage++) {
+                    BenchSpectrogram spectrogram;
+                    if (storage == 0) {
+                        spectrogram.setData(qwtCreateData(matrix, matrixSize, options.gaps, mode));
+                    } else {
+                        spectrogram.setData(qwtCreateFloatData(matrix, matrixSize, options.gaps, mode));
+                    }
+                    spectrogram.setColorMap(qwtCreateColorMap(format));
+                    spectrogram.setRenderThreadCount(numThreads);
+
+                    const QStringList renderParameters =
+                        QStringList(modeParameters)
+                        << qwtParameter("storage", (storage == 0) ? "double" : "float")
+                        << qwtParameter("format", (format == ColorMap::RGB) ? "RGB" : "Indexed")
+                        << qwtParameter("threads", numThreads);
+
+                    bench.run("renderTile", renderParameters, numPixels,
+                              [&]() { spectrogram.renderImage(xMap, yMap, area, imageSize); });
+                }
+            }
+        }
+    }
+
+    // contour lines on a raster of the matrix resolution
+
+    {
+        QScopedPointer<QwtMatrixRasterData> data(
+            qwtCreateData(matrix, matrixSize, options.gaps, QwtMatrixRasterData::BilinearInterpolation));
+
+        const qint64 numPoints = qint64(matrixSize.width()) * matrixSize.height();
+
+        for (int numLevels : options.levels) {
+            const QList<double> levels = qwtContourLevels(numLevels);
+            const QStringList parameters = QStringList() << qwtParameter("levels", numLevels);
+
+            bench.run("contourLines", parameters, numPoints, [&]() {
+                data->contourLines(area, matrixSize, levels, RasterData::IgnoreAllVerticesOnLevel);
+            });
+
+            bench.run("contourPolylines", parameters, numPoints, [&]() {
+                data->contourPolylines(area, matrixSize, levels, RasterData::IgnoreAllVerticesOnLevel);
+            });
+        }
+    }
+
+    // drawing, including the internal steps of PlotRasterItemBase
+
+    {
+        const QRectF canvasRect(QPointF(0.0, 0.0), imageSize);
+
+        QImage canvas(imageSize, QImage::Format_ARGB32);
+
+        // a matrix, whose cells are 4x4 pixels, is expanded to the device resolution
+        const QSize coarseSize(qMax(matrixSize.width() / 4, 2), qMax(matrixSize.height() / 4, 2));
+        const QVector<double> coarseMatrix = qwtSyntheticMatrix(coarseSize, options.gaps);
+
+        for (int numThreads : options.threads) {
+            const QStringList parameters = QStringList() << qwtParameter("threads", numThreads);
+
+            PlotSpectrogram spectrogram;
+            spectrogram.setColorMap(qwtCreateColorMap(ColorMap::RGB));
+            spectrogram.setRenderThreadCount(numThreads);
+
+            ScaleMap xCanvasMap;
+            ScaleMap yCanvasMap;
+
+            const auto draw = [&]() {
+                canvas.fill(0);
+
+                QPainter painter(&canvas);
+                spectrogram.draw(&painter, xCanvasMap, yCanvasMap, canvasRect);
+            };
+
+            spectrogram.setData(
+                qwtCreateData(coarseMatrix, coarseSize, options.gaps, QwtMatrixRasterData::NearestNeighbour));
+
+            xCanvasMap.setScaleInterval(0.0, imageSize.width() / 4.0);
+            xCanvasMap.setPaintInterval(0, imageSize.width());
+            yCanvasMap.setScaleInterval(0.0, imageSize.height() / 4.0);
+            yCanvasMap.setPaintInterval(imageSize.height(), 0);
+
+            spectrogram.setPaintAttribute(PlotRasterItemBase::PaintInDeviceResolution, true);
+            bench.run("expandImage", parameters, numPixels, draw);
+
+            spectrogram.setPaintAttribute(PlotRasterItemBase::PaintInDeviceResolution, false);
+            bench.run("expandImageBaseline", parameters, numPixels, draw);
+
+            spectrogram.setData(
+                qwtCreateData(matrix, matrixSize, options.gaps, QwtMatrixRasterData::BilinearInterpolation));
+
+            xCanvasMap.setScaleInterval(area.left(), area.right());
+            yCanvasMap.setScaleInterval(area.top(), area.bottom());
+
+            spectrogram.setAlpha(128);
+            bench.run("toRgba", parameters, numPixels, draw);
+
+            spectrogram.setAlpha(-1);
+            bench.run("toRgbaBaseline", parameters, numPixels, draw);
+        }
+    }
+
+    if (options.output.isEmpty()) {
+        QTextStream stream(stdout);
+        bench.write(stream);
+    } else {
+        QFile file(options.output);
+        if (!file.open(QIODevice::WriteOnly | QIODevice::Text)) {
+            std::cerr << "Writing " << qPrintable(options.output) << " failed" << std::endl;
+            return 1;
+        }
+
+        QTextStream stream(&file);
+        bench.write(stream);
+    }
+
+    return 0;
+}
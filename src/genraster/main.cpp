@@ -1,181 +1,574 @@
-﻿#include <QApplication>
-#include <QDebug>
+﻿#include <QAtomicInt>
+#include <QCoreApplication>
+#include <QFile>
 #include <QImage>
+#include <QPainter>
+#include <QRunnable>
+#include <QStringList>
+#include <QTextStream>
+#include <QThread>
+#include <QThreadPool>
+#include <QVector>
 
-#include <vtkCutter.h>
-#include <vtkGenericDataObjectWriter.h>
 #include <vtkImageData.h>
-#include <vtkLookupTable.h>
-#include <vtkPlane.h>
+#include <vtkImageFenceResampler.h>
+#include <vtkImagePlaneResampler.h>
 #include <vtkPointData.h>
-#include <vtkPoints.h>
-#include <vtkPolyData.h>
 #include <vtkSmartPointer.h>
 #include <vtkStructuredPoints.h>
 #include <vtkStructuredPointsReader.h>
-#include <vtkTransform.h>
-#include <vtkTransformPolyDataFilter.h>
+
+#include <cstdio>
+#include <iostream>
 
 #include "colormap.h"
 #include "interval.h"
 #include "plotspectrogram.h"
 #include "rasterdata.h"
+#include "scalemap.h"
+#include "vtkarrayrasterdata.h"
 
 namespace
 {
 
-class SliceRasterData : public QwtMatrixRasterData
+// ! A cutting plane
+class Plane
+{
+public:
+    double origin[3]; // 切割平面的原点坐标
+    double normal[3]; // 切割平面的法向量
+};
+
+// ! A vertical fence along a polyline
+class Fence
 {
 public:
-    SliceRasterData()
+    Fence()
     {
-        std::string filename = "/home/guobin/AI.vtk";
-        double origin[3] = {225000, 1215000, 47};                  // 切割平面的原点坐标
-        double normal[3] = {1.0, 1.0, 0.0};                        // 切割平面的法向量
-        std::string outputFilename = "/home/guobin/cut_plane.vtk"; // 切面图片的输出文件名
-
-        vtkSmartPointer<vtkStructuredPointsReader> reader = vtkSmartPointer<vtkStructuredPointsReader>::New();
-        reader->SetFileName(filename.c_str());
-        reader->Update();
-        vtkSmartPointer<vtkStructuredPoints> structPointData = reader->GetOutput();
-
-        // 创建切割平面
-        vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
-        plane->SetOrigin(origin[0], origin[1], origin[2]);
-        plane->SetNormal(normal[0], normal[1], normal[2]);
-
-        // 创建切割器
-        vtkSmartPointer<vtkCutter> cutter = vtkSmartPointer<vtkCutter>::New();
-        cutter->SetInputData(structPointData);
-        cutter->SetCutFunction(plane);
-        cutter->Update(); // 确保 cutPlane 包含有效数据。
-
-        vtkPolyData *polyData = cutter->GetOutput();
-        std::cout << "Cut plane Bounds: " << polyData->GetBounds()[0] << "," << polyData->GetBounds()[1] << ","
-                  << polyData->GetBounds()[2] << "," << polyData->GetBounds()[3] << "," << polyData->GetBounds()[4]
-                  << "," << polyData->GetBounds()[5] << "," << std::endl;
-        // vtkPoints *points = polyData->GetPoints();
-        // if (points) {
-        //     std::cout << "Number of points: " << points->GetNumberOfPoints() << std::endl;
-
-        // // for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i) {
-        // //     double p[3];
-        // //     points->GetPoint(i, p);
-        // //     std::cout << "Point: " << p[0] << ", " << p[1] << ", " << p[2] << std::endl;
-        // // }
-        // }
-
-        // create transform
-        vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
-        transform->PostMultiply();
-        // transform->Translate(origin[0], origin[1], origin[2]);
-        transform->RotateZ(vtkMath::DegreesFromRadians(atan2(normal[1], normal[0])));
-
-        // create transform filter
-        vtkSmartPointer<vtkTransformPolyDataFilter> transformFilter =
-            vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-        transformFilter->SetInputData(polyData);
-        transformFilter->SetTransform(transform);
-        transformFilter->Update();
-
-        vtkPolyData *trnsPolyData = transformFilter->GetOutput();
-        std::cout << "Transform plane Bounds: " << trnsPolyData->GetBounds()[0] << "," << trnsPolyData->GetBounds()[1]
-                  << "," << trnsPolyData->GetBounds()[2] << "," << trnsPolyData->GetBounds()[3] << ","
-                  << trnsPolyData->GetBounds()[4] << "," << trnsPolyData->GetBounds()[5] << "," << std::endl;
-        // 获取标量数据
-        vtkDataArray *scalars = trnsPolyData->GetPointData()->GetScalars();
-        if (scalars) // 确认标量数据存在
-        {
-            double scalarMin = 0, scalarMax = 0;
-            QVector<double> values;
-            for (vtkIdType i = 0; i < scalars->GetNumberOfTuples(); i++) {
-                double scalarValue = scalars->GetComponent(i, 0);
-                // std::cout << "Scalar value at point " << i << " is " << scalarValue << std::endl;
-                values.append(scalarValue);
-
-                if (scalarValue < scalarMin) {
-                    scalarMin = scalarValue;
-                }
-                if (scalarValue > scalarMax) {
-                    scalarMax = scalarValue;
-                }
-            }
+        depthRange[0] = 0.0;
+        depthRange[1] = -1.0; // 无效的范围表示体数据的整个 z 范围
+    }
 
-            qDebug() << scalarMin << scalarMax;
+    QVector<double> path; // 折线的顶点 x, y, x, y, ...
+    double depthRange[2]; // z 的范围
+};
 
-            int numRows = qAbs(trnsPolyData->GetBounds()[5] - trnsPolyData->GetBounds()[4]) + 1; // TODO
-            int numColumns = scalars->GetSize() / numRows;
+/*
+    在平面上直接对体数据进行三线性重采样，得到规则的二维网格：
+    X 轴是水平方向，Y 轴是平面内与之垂直的方向（竖直平面即 Z 轴），
+    坐标都是相对于平面原点的距离。
+ */
+class SliceRasterData : public VtkArrayRasterData
+{
+public:
+    SliceRasterData(vtkStructuredPoints *structPointData, const Plane &plane, int numThreads)
+    {
+        vtkSmartPointer<vtkImagePlaneResampler> resampler = vtkSmartPointer<vtkImagePlaneResampler>::New();
+        resampler->SetInputData(structPointData);
+        resampler->SetPlane(plane.origin, plane.normal);
+        resampler->SetNumberOfThreads(numThreads);
+        resampler->Update();
+
+        // 直接引用重采样结果的标量数组，不复制数据
+        setImage(resampler->GetOutput());
+    }
+};
 
-            qDebug() << numRows << numColumns;
+/*
+    沿折线的竖直剖面（栅状图）：整条折线展开成一个栅格，
+    X 轴是沿折线到第一个顶点的距离，Y 轴是 z 坐标，各行由多个线程并行重采样。
+ */
+class FenceRasterData : public VtkArrayRasterData
+{
+public:
+    FenceRasterData(vtkStructuredPoints *structPointData, const Fence &fence, int numThreads)
+    {
+        vtkSmartPointer<vtkImageFenceResampler> resampler = vtkSmartPointer<vtkImageFenceResampler>::New();
+        resampler->SetInputData(structPointData);
+        resampler->SetPath(fence.path.size() / 2, fence.path.constData());
+        resampler->SetDepthRange(fence.depthRange[0], fence.depthRange[1]);
+        resampler->SetNumberOfThreads(numThreads);
+        resampler->Update();
+
+        setImage(resampler->GetOutput());
+    }
+};
 
-            setValueMatrix(values, numColumns);
+// ! Options of the command line
+class Options
+{
+public:
+    Options() : output("slice_%1.png"), jobs(QThread::idealThreadCount()),
+        resampleMode(QwtMatrixRasterData::BilinearInterpolation)
+    {
+    }
+
+    QString input;
+    QString planes;
+    QString fence;
+    QString colorMap;
+    QString output;
+
+    QList<double> contourLevels;
+    QSize size;
+    Interval depthRange;
+
+    int jobs;
+    QwtMatrixRasterData::ResampleMode resampleMode;
+};
+
+void printUsage(const char *program)
+{
+    std::cerr << "Usage: " << program << " -i volume.vtk ( -p planes.txt | -f fence.txt ) [options]\n"
+              << "\n"
+              << "Renders a spectrogram image for each plane or fence of a structured points volume.\n"
+              << "\n"
+              << "  -i, --input <file>       Legacy .vtk structured points volume\n"
+              << "  -p, --planes <file>      Planes, one per line: ox oy oz nx ny nz. '-' reads stdin\n"
+              << "  -f, --fence <file>       Polyline of a fence, one point per line: x y. The fence\n"
+              << "                           is rendered after the planes as one unfolded image\n"
+              << "  -d, --depth <z0:z1>      Z range of the fence, default: the z range of the volume\n"
+              << "  -c, --colormap <spec>    color1,color2[,position:color...], f.e.\n"
+              << "                           darkblue,darkred,0.3:cyan,0.6:yellow\n"
+              << "  -l, --levels <levels>    Contour levels: v1,v2,... or min:step:max\n"
+              << "  -s, --size <WxH>         Image size, default: the size of the slice\n"
+              << "  -o, --output <pattern>   Output files, %1 is the index of the plane,\n"
+              << "                           default: slice_%1.png\n"
+              << "  -j, --jobs <n>           Number of slices rendered concurrently\n"
+              << "  -r, --resample <mode>    nearest, bilinear ( default ) or bicubic\n";
+}
+
+bool parseLevels(const QString &text, QList<double> &levels)
+{
+    bool ok = true;
+
+    const QStringList range = text.split(':');
+    if (range.size() == 3) {
+        bool ok1, ok2, ok3;
+        const double min = range[0].toDouble(&ok1);
+        const double step = range[1].toDouble(&ok2);
+        const double max = range[2].toDouble(&ok3);
+
+        ok = ok1 && ok2 && ok3 && (step > 0.0);
+        if (ok) {
+            for (int i = 0; min + i * step <= max + 1e-10 * step; i++) {
+                levels += min + i * step;
+            }
+        }
+    } else {
+        const QStringList values = text.split(',');
+        for (int i = 0; ok && (i < values.size()); i++) {
+            levels += values[i].toDouble(&ok);
+        }
+    }
 
-            setInterval(Qt::XAxis,
-                        Interval(trnsPolyData->GetBounds()[0], trnsPolyData->GetBounds()[1], Interval::ExcludeMaximum));
-            setInterval(Qt::YAxis,
-                        Interval(trnsPolyData->GetBounds()[4], trnsPolyData->GetBounds()[5], Interval::ExcludeMaximum));
-            setInterval(Qt::ZAxis, Interval(scalarMin, scalarMax));
+    return ok;
+}
 
+bool parseOptions(const QStringList &arguments, Options &options)
+{
+    for (int i = 1; i < arguments.size(); i++) {
+        const QString &option = arguments[i];
+        if (i + 1 >= arguments.size()) {
+            return false;
+        }
+
+        const QString value = arguments[++i];
+        bool ok = true;
+
+        if ((option == "-i") || (option == "--input")) {
+            options.input = value;
+        } else if ((option == "-p") || (option == "--planes")) {
+            options.planes = value;
+        } else if ((option == "-f") || (option == "--fence")) {
+            options.fence = value;
+        } else if ((option == "-d") || (option == "--depth")) {
+            const QStringList range = value.split(':');
+            ok = (range.size() == 2);
+            if (ok) {
+                bool ok1, ok2;
+                options.depthRange = Interval(range[0].toDouble(&ok1), range[1].toDouble(&ok2));
+                ok = ok1 && ok2 && options.depthRange.isValid();
+            }
+        } else if ((option == "-c") || (option == "--colormap")) {
+            options.colorMap = value;
+        } else if ((option == "-l") || (option == "--levels")) {
+            ok = parseLevels(value, options.contourLevels);
+        } else if ((option == "-s") || (option == "--size")) {
+            const QStringList size = value.split('x');
+            ok = (size.size() == 2);
+            if (ok) {
+                bool ok1, ok2;
+                options.size = QSize(size[0].toInt(&ok1), size[1].toInt(&ok2));
+                ok = ok1 && ok2 && !options.size.isEmpty();
+            }
+        } else if ((option == "-o") || (option == "--output")) {
+            options.output = value;
+        } else if ((option == "-j") || (option == "--jobs")) {
+            options.jobs = value.toInt(&ok);
+            ok = ok && (options.jobs > 0);
+        } else if ((option == "-r") || (option == "--resample")) {
+            if (value == "nearest") {
+                options.resampleMode = QwtMatrixRasterData::NearestNeighbour;
+            } else if (value == "bilinear") {
+                options.resampleMode = QwtMatrixRasterData::BilinearInterpolation;
+            } else if (value == "bicubic") {
+                options.resampleMode = QwtMatrixRasterData::BicubicInterpolation;
+            } else {
+                ok = false;
+            }
         } else {
-            std::cerr << "No scalar data found!" << std::endl;
+            ok = false;
+        }
+
+        if (!ok) {
+            std::cerr << "Invalid option: " << qPrintable(option) << " " << qPrintable(value) << std::endl;
+            return false;
+        }
+    }
+
+    return !(options.input.isEmpty() || (options.planes.isEmpty() && options.fence.isEmpty()));
+}
+
+bool readPlanes(const QString &fileName, QList<Plane> &planes)
+{
+    QFile file;
+
+    bool ok;
+    if (fileName == "-") {
+        ok = file.open(stdin, QIODevice::ReadOnly);
+    } else {
+        file.setFileName(fileName);
+        ok = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().simplified();
+        if (line.isEmpty() || line.startsWith("#")) {
+            continue;
+        }
+
+        const QStringList values = line.split(' ');
+        if (values.size() != 6) {
+            return false;
+        }
+
+        Plane plane;
+        for (int i = 0; ok && (i < 3); i++) {
+            plane.origin[i] = values[i].toDouble(&ok);
+        }
+        for (int i = 0; ok && (i < 3); i++) {
+            plane.normal[i] = values[3 + i].toDouble(&ok);
+        }
+
+        if (!ok) {
+            return false;
+        }
+
+        planes += plane;
+    }
+
+    return true;
+}
+
+bool readFence(const QString &fileName, const Interval &depthRange, Fence &fence)
+{
+    QFile file;
+
+    bool ok;
+    if (fileName == "-") {
+        ok = file.open(stdin, QIODevice::ReadOnly);
+    } else {
+        file.setFileName(fileName);
+        ok = file.open(QIODevice::ReadOnly | QIODevice::Text);
+    }
+
+    if (!ok) {
+        return false;
+    }
+
+    QTextStream stream(&file);
+    while (!stream.atEnd()) {
+        const QString line = stream.readLine().simplified();
+        if (line.isEmpty() || line.startsWith("#")) {
+            continue;
+        }
+
+        const QStringList values = line.split(' ');
+        if (values.size() != 2) {
+            return false;
+        }
+
+        for (int i = 0; ok && (i < 2); i++) {
+            fence.path += values[i].toDouble(&ok);
+        }
+
+        if (!ok) {
+            return false;
         }
     }
+
+    if (depthRange.isValid()) {
+        fence.depthRange[0] = depthRange.minValue();
+        fence.depthRange[1] = depthRange.maxValue();
+    }
+
+    return fence.path.size() >= 4;
+}
+
+LinearColorMap *createColorMap(const QString &spec)
+{
+    if (spec.isEmpty()) {
+        LinearColorMap *colorMap = new LinearColorMap(Qt::darkBlue, Qt::darkRed);
+        colorMap->addColorStop(0.1, Qt::blue);
+        colorMap->addColorStop(0.3, Qt::cyan);
+        colorMap->addColorStop(0.5, Qt::green);
+        colorMap->addColorStop(0.6, Qt::yellow);
+        colorMap->addColorStop(0.9, Qt::red);
+
+        return colorMap;
+    }
+
+    const QStringList items = spec.split(',');
+    if (items.size() < 2) {
+        return nullptr;
+    }
+
+    const QColor color1(items[0].trimmed());
+    const QColor color2(items[1].trimmed());
+    if (!(color1.isValid() && color2.isValid())) {
+        return nullptr;
+    }
+
+    LinearColorMap *colorMap = new LinearColorMap(color1, color2);
+
+    for (int i = 2; i < items.size(); i++) {
+        const QStringList stop = items[i].split(':');
+
+        bool ok = (stop.size() == 2);
+
+        double position = 0.0;
+        if (ok) {
+            position = stop[0].toDouble(&ok);
+        }
+
+        const QColor color(ok ? stop[1].trimmed() : QString());
+        if (!(ok && color.isValid())) {
+            delete colorMap;
+            return nullptr;
+        }
+
+        colorMap->addColorStop(position, color);
+    }
+
+    return colorMap;
+}
+
+/*
+    Renders a section of the volume into an image file. Each job has its
+    own shallow copy of the volume, so that the pipelines of concurrent
+    jobs don't share any VTK object.
+ */
+class SectionJob : public QRunnable
+{
+public:
+    SectionJob(vtkStructuredPoints *volume, const QString &fileName, const Options &options,
+               const LinearColorMap &colorMap, int renderThreadCount, QAtomicInt &numFailed) :
+        m_volume(volume), m_renderThreadCount(renderThreadCount), m_fileName(fileName), m_options(options),
+        m_colorMap(colorMap), m_numFailed(numFailed)
+    {
+    }
+
+    virtual void run() override
+    {
+        VtkArrayRasterData *rasterData = createRasterData();
+        rasterData->setResampleMode(m_options.resampleMode);
+
+        const Interval xInterval = rasterData->interval(Qt::XAxis);
+        const Interval yInterval = rasterData->interval(Qt::YAxis);
+
+        if ((rasterData->numRows() <= 0) || !xInterval.isValid() || !yInterval.isValid()) {
+            qWarning("No scalar data found for %s", qPrintable(m_fileName));
+            m_numFailed.fetchAndAddOrdered(1);
+
+            delete rasterData;
+            return;
+        }
+
+        PlotSpectrogram spectrogram;
+        spectrogram.setRenderThreadCount(m_renderThreadCount);
+        spectrogram.setData(rasterData);
+
+        // the lookup table of the color map is shared with all jobs
+        spectrogram.setColorMap(new LinearColorMap(m_colorMap));
+
+        if (!m_options.contourLevels.isEmpty()) {
+            spectrogram.setContourLevels(m_options.contourLevels);
+            spectrogram.setDisplayMode(PlotSpectrogram::ContourMode, true);
+        }
+
+        QSize size = m_options.size;
+        if (!size.isValid()) {
+            size = QSize(rasterData->numColumns(), rasterData->numRows());
+        }
+
+        const QRect rect(QPoint(0, 0), size);
+
+        ScaleMap xMap;
+        xMap.setScaleInterval(xInterval.minValue(), xInterval.maxValue());
+        xMap.setPaintInterval(rect.left(), rect.right());
+        ScaleMap yMap;
+        yMap.setScaleInterval(yInterval.minValue(), yInterval.maxValue());
+        yMap.setPaintInterval(rect.bottom(), rect.top());
+
+        QImage image(rect.size(), QImage::Format_ARGB32);
+        image.fill(0);
+
+        QPainter painter(&image);
+        spectrogram.draw(&painter, xMap, yMap, rect);
+        painter.end();
+
+        if (!image.save(m_fileName)) {
+            qWarning("Writing %s failed", qPrintable(m_fileName));
+            m_numFailed.fetchAndAddOrdered(1);
+        }
+    }
+
+protected:
+    // ! Resample the section, called from run()
+    virtual VtkArrayRasterData *createRasterData() const = 0;
+
+    vtkSmartPointer<vtkStructuredPoints> m_volume;
+    const int m_renderThreadCount;
+
+private:
+    const QString m_fileName;
+    const Options &m_options;
+    const LinearColorMap &m_colorMap;
+    QAtomicInt &m_numFailed;
+};
+
+// ! Renders the slice of a plane
+class SliceJob : public SectionJob
+{
+public:
+    SliceJob(vtkStructuredPoints *volume, const Plane &plane, const QString &fileName, const Options &options,
+             const LinearColorMap &colorMap, int renderThreadCount, QAtomicInt &numFailed) :
+        SectionJob(volume, fileName, options, colorMap, renderThreadCount, numFailed), m_plane(plane)
+    {
+    }
+
+protected:
+    virtual VtkArrayRasterData *createRasterData() const override
+    {
+        return new SliceRasterData(m_volume, m_plane, m_renderThreadCount);
+    }
+
+private:
+    const Plane m_plane;
+};
+
+// ! Renders a fence as one unfolded image
+class FenceJob : public SectionJob
+{
+public:
+    FenceJob(vtkStructuredPoints *volume, const Fence &fence, const QString &fileName, const Options &options,
+             const LinearColorMap &colorMap, int renderThreadCount, QAtomicInt &numFailed) :
+        SectionJob(volume, fileName, options, colorMap, renderThreadCount, numFailed), m_fence(fence)
+    {
+    }
+
+protected:
+    virtual VtkArrayRasterData *createRasterData() const override
+    {
+        return new FenceRasterData(m_volume, m_fence, m_renderThreadCount);
+    }
+
+private:
+    const Fence m_fence;
 };
 
 } // namespace
 
 int main(int argc, char *argv[])
 {
-    QApplication a(argc, argv);
+    // no GUI, so that slices can be rendered on servers without display
+    QCoreApplication a(argc, argv);
+
+    Options options;
+    if (!parseOptions(a.arguments(), options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    QList<Plane> planes;
+    if (!options.planes.isEmpty() && !readPlanes(options.planes, planes)) {
+        std::cerr << "Invalid planes: " << qPrintable(options.planes) << std::endl;
+        return 1;
+    }
 
-    SliceRasterData *rasterData = new SliceRasterData();
-    rasterData->setResampleMode(QwtMatrixRasterData::ResampleMode::BilinearInterpolation);
+    Fence fence;
+    if (!options.fence.isEmpty() && !readFence(options.fence, options.depthRange, fence)) {
+        std::cerr << "Invalid fence: " << qPrintable(options.fence) << std::endl;
+        return 1;
+    }
 
-    LinearColorMap *lineColorMap = new LinearColorMap(Qt::darkBlue, Qt::darkRed);
-    lineColorMap->addColorStop(0.1, Qt::blue);
-    lineColorMap->addColorStop(0.3, Qt::cyan);
-    lineColorMap->addColorStop(0.5, Qt::green);
-    lineColorMap->addColorStop(0.6, Qt::yellow);
-    lineColorMap->addColorStop(0.9, Qt::red);
+    // the fence is rendered after the planes
+    const int numSections = planes.size() + (options.fence.isEmpty() ? 0 : 1);
 
-    PlotSpectrogram *spectrogram = new PlotSpectrogram();
-    spectrogram->setRenderThreadCount(4); // use system specific thread count
-    spectrogram->setData(rasterData);
-    spectrogram->setColorMap(lineColorMap);
+    if ((numSections > 1) && !options.output.contains("%1")) {
+        std::cerr << "The output pattern needs %1 for more than one section" << std::endl;
+        return 1;
+    }
 
-    QList<double> contourLevels;
-    for (double level = 0.1; level < 1.0; level += 0.1) {
-        contourLevels += level;
+    QScopedPointer<LinearColorMap> colorMap(createColorMap(options.colorMap));
+    if (colorMap.isNull()) {
+        std::cerr << "Invalid color map: " << qPrintable(options.colorMap) << std::endl;
+        return 1;
+    }
+
+    // the volume is loaded once for all planes
+    vtkSmartPointer<vtkStructuredPointsReader> reader = vtkSmartPointer<vtkStructuredPointsReader>::New();
+    reader->SetFileName(qPrintable(options.input));
+    reader->Update();
+
+    vtkStructuredPoints *volume = reader->GetOutput();
+    if ((volume == nullptr) || (volume->GetPointData()->GetScalars() == nullptr)) {
+        std::cerr << "No scalar data found in " << qPrintable(options.input) << std::endl;
+        return 1;
     }
-    spectrogram->setContourLevels(contourLevels);
 
-    // spectrogram->setDisplayMode(PlotSpectrogram::ContourMode, true);
-    // spectrogram->setDisplayMode(PlotSpectrogram::ImageMode, true);
-    // spectrogram->setDefaultContourPen(true ? QPen(Qt::black, 0) : QPen(Qt::NoPen));
+    const int numJobs = qMin(options.jobs, numSections);
+    const int renderThreadCount = qMax(QThread::idealThreadCount() / qMax(numJobs, 1), 1);
 
-    const Interval xInterval = spectrogram->data()->interval(Qt::XAxis);
-    const Interval yInterval = spectrogram->data()->interval(Qt::YAxis);
-    const Interval zInterval = spectrogram->data()->interval(Qt::ZAxis);
+    QThreadPool pool;
+    pool.setMaxThreadCount(qMax(numJobs, 1));
 
-    QRect rect(QPoint(0, 0), QSize(xInterval.width(), yInterval.width()));
+    QAtomicInt numFailed(0);
 
-    ScaleMap xMap;
-    xMap.setScaleInterval(xInterval.minValue(), xInterval.maxValue());
-    xMap.setPaintInterval(rect.left(), rect.right());
-    ScaleMap yMap;
-    yMap.setScaleInterval(yInterval.minValue(), yInterval.maxValue());
-    yMap.setPaintInterval(rect.bottom(), rect.top());
+    for (int i = 0; i < numSections; i++) {
+        vtkSmartPointer<vtkStructuredPoints> copy = vtkSmartPointer<vtkStructuredPoints>::New();
+        copy->ShallowCopy(volume);
 
-    QImage image(rect.size(), QImage::Format_ARGB32);
-    QPainter p;
-    p.begin(&image);
+        const QString fileName = options.output.contains("%1") ? options.output.arg(i, 4, 10, QLatin1Char('0'))
+                                                               : options.output;
 
-    p.drawRect(rect);
-    spectrogram->draw(&p, xMap, yMap, rect);
+        if (i < planes.size()) {
+            pool.start(new SliceJob(copy, planes[i], fileName, options, *colorMap, renderThreadCount, numFailed));
+        } else {
+            pool.start(new FenceJob(copy, fence, fileName, options, *colorMap, renderThreadCount, numFailed));
+        }
+    }
 
-    p.end();
+    pool.waitForDone();
 
-    image.save("../image.png");
+    const int failed = numFailed.fetchAndAddOrdered(0);
+    std::cout << numSections - failed << " of " << numSections << " sections rendered" << std::endl;
 
-    return 0;
+    return (failed == 0) ? 0 : 1;
 }
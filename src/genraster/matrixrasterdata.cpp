@@ -0,0 +1,9 @@
+﻿#include "matrixrasterdata.h"
+
+/*
+    The instantiations for the types of the documentation. Other types
+    are instantiated implicitly from the header.
+ */
+template class MatrixRasterData<float>;
+template class MatrixRasterData<unsigned short>;
+template class MatrixRasterData<unsigned char>;
@@ -0,0 +1,431 @@
+﻿#ifndef MATRIX_RASTER_DATA_H
+#define MATRIX_RASTER_DATA_H
+
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+
+#include <qnumeric.h>
+
+#include "interval.h"
+#include "matrixresampler.h"
+#include "rasterdata.h"
+
+/*!
+   \brief A matrix of values of type T as raster data
+
+   MatrixRasterData is a QwtMatrixRasterData, that stores its values in
+   their native type ( f.e. float, unsigned short or unsigned char )
+   instead of double. A matrix of float needs half, a matrix of unsigned
+   short a quarter of the memory and memory bandwidth.
+
+   The resampling kernels are instantiated for T: values, that fit into
+   the mantissa of a float, are interpolated in float, all others in
+   double ( see QwtResampleTraits ). The values returned by value() and
+   values() are always doubles.
+
+   Unlike QwtMatrixRasterData there is no pyramid, and changes are not
+   tracked in blocks: changedArea() is the bounding rectangle of the data.
+
+   \sa QwtMatrixRasterData, VtkArrayRasterData
+ */
+template <typename T>
+class MatrixRasterData : public RasterData
+{
+public:
+    MatrixRasterData();
+    virtual ~MatrixRasterData();
+
+    void setResampleMode(QwtMatrixRasterData::ResampleMode mode);
+    QwtMatrixRasterData::ResampleMode resampleMode() const;
+
+    void setInterval(Qt::Axis, const Interval &);
+    virtual Interval interval(Qt::Axis axis) const override final;
+
+    void setValueMatrix(const QVector<T> &values, int numColumns);
+    const QVector<T> valueMatrix() const;
+
+    void setValue(int row, int col, T value);
+
+    int numColumns() const;
+    int numRows() const;
+
+    virtual QRectF pixelHint(const QRectF &) const override;
+
+    virtual void initRaster(const QRectF &, const QSize &raster) override;
+    virtual void discardRaster() override;
+
+    virtual double value(double x, double y) const override;
+    virtual void values(double x, double dx, double y, int numValues, double *values) const override;
+
+    virtual int revision() const override;
+
+private:
+    void update();
+
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+template <typename T>
+class MatrixRasterData<T>::PrivateData
+{
+public:
+    PrivateData() : resampleMode(QwtMatrixRasterData::NearestNeighbour), numColumns(0), revision(0) {}
+
+    void invalidateTables()
+    {
+        columnTable.invalidate();
+        rowTable.invalidate();
+    }
+
+    Interval intervals[3];
+    QwtMatrixRasterData::ResampleMode resampleMode;
+
+    QVector<T> values;
+    int numColumns;
+
+    // the geometry of the values, that is resampled
+    QwtMatrixView<T> matrix;
+
+    int revision;
+
+    // precalculated in initRaster()
+    QwtResampleTable columnTable;
+    QwtResampleTable rowTable;
+};
+
+// ! Constructor
+template <typename T>
+MatrixRasterData<T>::MatrixRasterData()
+{
+    m_data = new PrivateData();
+    update();
+}
+
+// ! Destructor
+template <typename T>
+MatrixRasterData<T>::~MatrixRasterData()
+{
+    delete m_data;
+}
+
+/*!
+   \brief Set the resampling algorithm
+
+   \param mode Resampling mode
+   \sa resampleMode(), value()
+ */
+template <typename T>
+void MatrixRasterData<T>::setResampleMode(QwtMatrixRasterData::ResampleMode mode)
+{
+    if (mode != m_data->resampleMode) {
+        m_data->resampleMode = mode;
+        m_data->invalidateTables();
+        m_data->revision++;
+    }
+}
+
+/*!
+   \return resampling algorithm
+   \sa setResampleMode(), value()
+ */
+template <typename T>
+QwtMatrixRasterData::ResampleMode MatrixRasterData<T>::resampleMode() const
+{
+    return m_data->resampleMode;
+}
+
+/*!
+   \brief Assign the bounding interval for an axis
+
+   \param axis X, Y or Z axis
+   \param interval Interval
+
+   \sa RasterData::interval(), setValueMatrix()
+ */
+template <typename T>
+void MatrixRasterData<T>::setInterval(Qt::Axis axis, const Interval &interval)
+{
+    if ((axis >= 0) && (axis <= 2)) {
+        m_data->intervals[axis] = interval;
+        update();
+    }
+}
+
+/*!
+   \return Bounding interval for an axis
+   \sa setInterval
+ */
+template <typename T>
+Interval MatrixRasterData<T>::interval(Qt::Axis axis) const
+{
+    if ((axis >= 0) && (axis <= 2)) {
+        return m_data->intervals[axis];
+    }
+
+    return Interval();
+}
+
+/*!
+   \brief Assign a value matrix
+
+   \param values Vector of values
+   \param numColumns Number of columns
+
+   \sa valueMatrix(), QwtMatrixRasterData::setValueMatrix()
+ */
+template <typename T>
+void MatrixRasterData<T>::setValueMatrix(const QVector<T> &values, int numColumns)
+{
+    m_data->values = values;
+    m_data->numColumns = qMax(numColumns, 0);
+    update();
+}
+
+/*!
+   \return Value matrix
+   \sa setValueMatrix()
+ */
+template <typename T>
+const QVector<T> MatrixRasterData<T>::valueMatrix() const
+{
+    return m_data->values;
+}
+
+/*!
+   \brief Change a single value in the matrix
+
+   \param row Row index
+   \param col Column index
+   \param value New value
+
+   \sa value(), setValueMatrix()
+ */
+template <typename T>
+void MatrixRasterData<T>::setValue(int row, int col, T value)
+{
+    if ((row >= 0) && (row < m_data->matrix.numRows) && (col >= 0) && (col < m_data->numColumns)) {
+        m_data->values.data()[row * m_data->numColumns + col] = value;
+
+        // data() might have detached the values
+        m_data->matrix.values = m_data->values.constData();
+        m_data->revision++;
+    }
+}
+
+/*!
+   \return Number of columns of the value matrix
+   \sa numRows(), setValueMatrix()
+ */
+template <typename T>
+int MatrixRasterData<T>::numColumns() const
+{
+    return m_data->numColumns;
+}
+
+/*!
+   \return Number of rows of the value matrix
+   \sa numColumns(), setValueMatrix()
+ */
+template <typename T>
+int MatrixRasterData<T>::numRows() const
+{
+    return m_data->matrix.numRows;
+}
+
+/*!
+   \brief Calculate the pixel hint
+
+   \param area Requested area, ignored
+   \return Surrounding pixel of the top left value for NearestNeighbour,
+           otherwise an empty rectangle
+
+   \sa QwtMatrixRasterData::pixelHint()
+ */
+template <typename T>
+QRectF MatrixRasterData<T>::pixelHint(const QRectF &area) const
+{
+    Q_UNUSED(area)
+
+    QRectF rect;
+    if (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) {
+        const Interval intervalX = interval(Qt::XAxis);
+        const Interval intervalY = interval(Qt::YAxis);
+        if (intervalX.isValid() && intervalY.isValid()) {
+            rect = QRectF(intervalX.minValue(), intervalY.minValue(), m_data->matrix.dx, m_data->matrix.dy);
+        }
+    }
+
+    return rect;
+}
+
+/*!
+   \brief Initialize a raster
+
+   Precalculates the indexes and weights of the interpolating resample modes
+   for the grid of positions of the raster.
+
+   \param area Area of the raster
+   \param raster Number of horizontal and vertical pixels
+
+   \sa discardRaster(), QwtMatrixRasterData::initRaster()
+ */
+template <typename T>
+void MatrixRasterData<T>::initRaster(const QRectF &area, const QSize &raster)
+{
+    m_data->invalidateTables();
+
+    const QwtMatrixView<T> &matrix = m_data->matrix;
+
+    if ((matrix.numRows <= 0) || (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) ||
+        (raster.width() < 2) || (raster.height() < 2)) {
+        return;
+    }
+
+    const double xStep = area.width() / (raster.width() - 1);
+    const double yStep = area.height() / (raster.height() - 1);
+
+    m_data->columnTable.init(m_data->resampleMode, area.left(), xStep, raster.width(), m_data->intervals[Qt::XAxis],
+                             matrix.dx, matrix.numColumns);
+
+    m_data->rowTable.init(m_data->resampleMode, area.top(), yStep, raster.height(), m_data->intervals[Qt::YAxis],
+                          matrix.dy, matrix.numRows);
+}
+
+/*!
+   \brief Discard a raster
+
+   Releases the tables calculated in initRaster()
+   \sa initRaster()
+ */
+template <typename T>
+void MatrixRasterData<T>::discardRaster()
+{
+    m_data->invalidateTables();
+}
+
+/*!
+   \return the value at a raster position
+
+   \param x X value in plot coordinates
+   \param y Y value in plot coordinates
+
+   \sa QwtMatrixRasterData::ResampleMode
+ */
+template <typename T>
+double MatrixRasterData<T>::value(double x, double y) const
+{
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    if ((m_data->matrix.numRows <= 0) || !(xInterval.contains(x) && yInterval.contains(y))) {
+        return qQNaN();
+    }
+
+    return qwtResampleValue(m_data->resampleMode, m_data->matrix, xInterval, yInterval, x, y);
+}
+
+/*!
+   \brief Values of a scanline
+
+   \param x X value of the first position in plot coordinates
+   \param dx Distance between 2 positions in plot coordinates
+   \param y Y value in plot coordinates
+   \param numValues Number of values
+   \param values Array of at least numValues doubles
+
+   \sa value(), QwtMatrixRasterData::values()
+ */
+template <typename T>
+void MatrixRasterData<T>::values(double x, double dx, double y, int numValues, double *values) const
+{
+    if (numValues <= 0) {
+        return;
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    int first = 0;
+    int last = numValues;
+
+    if ((m_data->matrix.numRows <= 0) || !yInterval.contains(y)) {
+        last = 0;
+    } else {
+        // the positions are monotonic, so the valid ones are a single range
+        while ((first < last) && !xInterval.contains(x + first * dx)) {
+            first++;
+        }
+
+        while ((last > first) && !xInterval.contains(x + (last - 1) * dx)) {
+            last--;
+        }
+    }
+
+    for (int i = 0; i < first; i++) {
+        values[i] = qQNaN();
+    }
+
+    for (int i = last; i < numValues; i++) {
+        values[i] = qQNaN();
+    }
+
+    if (first >= last) {
+        return;
+    }
+
+    if (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) {
+        qwtNearestNeighbours(m_data->matrix, xInterval, yInterval, x + first * dx, dx, y, last - first,
+                             values + first);
+    } else {
+        qwtResampleValues(m_data->resampleMode, m_data->matrix, xInterval, yInterval, m_data->columnTable,
+                          m_data->rowTable, x + first * dx, dx, y, last - first, values + first);
+    }
+}
+
+/*!
+   \return Revision of the matrix, increased by each modification
+   \sa RasterData::changedArea()
+ */
+template <typename T>
+int MatrixRasterData<T>::revision() const
+{
+    return m_data->revision;
+}
+
+template <typename T>
+void MatrixRasterData<T>::update()
+{
+    m_data->invalidateTables();
+
+    QwtMatrixView<T> &matrix = m_data->matrix;
+
+    matrix.values = m_data->values.constData();
+    matrix.numColumns = m_data->numColumns;
+    matrix.numRows = 0;
+    matrix.dx = 0.0;
+    matrix.dy = 0.0;
+
+    if (m_data->numColumns > 0) {
+        matrix.numRows = m_data->values.size() / m_data->numColumns;
+
+        const Interval xInterval = interval(Qt::XAxis);
+        const Interval yInterval = interval(Qt::YAxis);
+        if (xInterval.isValid()) {
+            matrix.dx = xInterval.width() / matrix.numColumns;
+        }
+        if (yInterval.isValid() && (matrix.numRows > 0)) {
+            matrix.dy = yInterval.width() / matrix.numRows;
+        }
+    }
+
+    m_data->revision++;
+}
+
+// instantiated in matrixrasterdata.cpp
+extern template class MatrixRasterData<float>;
+extern template class MatrixRasterData<unsigned short>;
+extern template class MatrixRasterData<unsigned char>;
+
+#endif
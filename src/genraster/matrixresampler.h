@@ -0,0 +1,548 @@
+﻿#ifndef MATRIX_RESAMPLER_H
+#define MATRIX_RESAMPLER_H
+
+/*
+    Resampling kernels for a matrix of equidistant values, that are shared
+    by the raster data classes. The kernels are templates for the type of
+    the values, so that a matrix is resampled in its native type without
+    converting it to doubles before. The results are always doubles.
+
+    Each instantiation is specialized at compile time: the type of the
+    interpolation is selected by QwtResampleTraits, and contiguous doubles
+    are resampled with the vector instructions of simd.h.
+ */
+
+#include <QVarLengthArray>
+#include <QVector>
+
+#include <qnumeric.h>
+
+#include "interval.h"
+#include "rasterdata.h"
+#include "simd.h"
+
+/*
+    A matrix of values of type T, stored row by row. stride is the distance
+    between 2 values of a row, f.e. the number of components of a
+    vtkDataArray.
+ */
+template <typename T>
+class QwtMatrixView
+{
+public:
+    QwtMatrixView() : values(nullptr), numColumns(0), numRows(0), stride(1), dx(0.0), dy(0.0) {}
+
+    inline const T *line(int row) const { return values + qint64(row) * numColumns * stride; }
+    inline double value(int row, int col) const { return line(row)[qint64(col) * stride]; }
+
+    const T *values;
+    int numColumns;
+    int numRows;
+    int stride;
+
+    double dx;
+    double dy;
+};
+
+static inline void qwtClampIndexes(int index[4], int size)
+{
+    if (index[1] < 0) {
+        index[1] = index[2];
+    }
+
+    if (index[0] < 0) {
+        index[0] = index[1];
+    }
+
+    if (index[2] >= size) {
+        index[2] = index[1];
+    }
+
+    if (index[3] >= size) {
+        index[3] = index[2];
+    }
+}
+
+/*
+    Indexes and weights of the matrix columns ( or rows ), that are
+    combined for a position. The weights of the bicubic interpolation
+    are the coefficients of qwtHermiteInterpolate for A, B, C and D.
+
+    Returns the number of taps
+ */
+static inline int qwtResampleTaps(QwtMatrixRasterData::ResampleMode mode, double pos, double min, double pixelSize,
+                                  int size, int index[4], double weight[4])
+{
+    if (mode == QwtMatrixRasterData::BicubicInterpolation) {
+        const double f = (pos - min) / pixelSize;
+        const int i = qRound(f);
+
+        index[0] = i - 2;
+        index[1] = i - 1;
+        index[2] = i;
+        index[3] = i + 1;
+        qwtClampIndexes(index, size);
+
+        const double t = f - i + 0.5;
+        const double t2 = t * t;
+        const double t3 = t2 * t;
+
+        weight[0] = 0.5 * (-t3 + 2.0 * t2 - t);
+        weight[1] = 0.5 * (3.0 * t3 - 5.0 * t2 + 2.0);
+        weight[2] = 0.5 * (-3.0 * t3 + 4.0 * t2 + t);
+        weight[3] = 0.5 * (t3 - t2);
+
+        return 4;
+    }
+
+    int i1 = qRound((pos - min) / pixelSize) - 1;
+    int i2 = i1 + 1;
+
+    if (i1 < 0) {
+        i1 = i2;
+    } else if (i2 >= size) {
+        i2 = i1;
+    }
+
+    const double r = (min + (i2 + 0.5) * pixelSize - pos) / pixelSize;
+
+    index[0] = i1;
+    index[1] = i2;
+    weight[0] = r;
+    weight[1] = 1.0 - r;
+
+    return 2;
+}
+
+/*
+    Resampling taps for a regular grid of positions, stored per tap
+    ( structure of arrays ), so that the weights of consecutive
+    positions can be loaded as vectors.
+ */
+class QwtResampleTable
+{
+public:
+    QwtResampleTable() : numTaps(0), origin(0.0), step(0.0), count(0) {}
+
+    void init(QwtMatrixRasterData::ResampleMode mode, double origin, double step, int count, const Interval &interval,
+              double pixelSize, int size)
+    {
+        this->origin = origin;
+        this->step = step;
+        this->count = count;
+
+        numTaps = (mode == QwtMatrixRasterData::BicubicInterpolation) ? 4 : 2;
+        for (int j = 0; j < numTaps; j++) {
+            indexes[j].resize(count);
+            weights[j].resize(count);
+        }
+
+        for (int i = 0; i < count; i++) {
+            // positions outside of the interval are never requested, but
+            // need to be clamped to have valid indexes
+            const double pos = qBound(interval.minValue(), origin + i * step, interval.maxValue());
+
+            int index[4];
+            double weight[4];
+            qwtResampleTaps(mode, pos, interval.minValue(), pixelSize, size, index, weight);
+
+            for (int j = 0; j < numTaps; j++) {
+                indexes[j][i] = index[j];
+                weights[j][i] = weight[j];
+            }
+        }
+    }
+
+    void invalidate()
+    {
+        numTaps = 0;
+        count = 0;
+
+        for (int j = 0; j < 4; j++) {
+            indexes[j].clear();
+            weights[j].clear();
+        }
+    }
+
+    /*
+        Index of pos in the grid, or -1 when pos is not on the grid
+        or the grid has a different step
+     */
+    int find(double pos, double step = 0.0) const
+    {
+        if ((count <= 0) || (this->step == 0.0)) {
+            return -1;
+        }
+
+        const double tolerance = 1e-6;
+
+        if ((step != 0.0) && (qAbs(step - this->step) > tolerance * qAbs(this->step))) {
+            return -1;
+        }
+
+        const double f = (pos - origin) / this->step;
+        const int i = qRound(f);
+
+        if ((i < 0) || (i >= count) || (qAbs(f - i) > tolerance)) {
+            return -1;
+        }
+
+        return i;
+    }
+
+    int numTaps;
+
+    double origin;
+    double step;
+    int count;
+
+    QVector<int> indexes[4];
+    QVector<double> weights[4];
+};
+
+/*
+    Value at a position inside of the bounding rectangle of the matrix
+ */
+template <typename T>
+static inline double qwtResampleValue(QwtMatrixRasterData::ResampleMode mode, const QwtMatrixView<T> &matrix,
+                                      const Interval &xInterval, const Interval &yInterval, double x, double y)
+{
+    if ((mode != QwtMatrixRasterData::BilinearInterpolation) && (mode != QwtMatrixRasterData::BicubicInterpolation)) {
+        // In case of intervals, where the maximum is included
+        // we get out of bound for row/col, when the value for the
+        // maximum is requested. Instead we return the value
+        // from the last row/col
+
+        const int row = qMin(int((y - yInterval.minValue()) / matrix.dy), matrix.numRows - 1);
+        const int col = qMin(int((x - xInterval.minValue()) / matrix.dx), matrix.numColumns - 1);
+
+        return matrix.value(row, col);
+    }
+
+    int rows[4];
+    double wy[4];
+    const int numRowTaps = qwtResampleTaps(mode, y, yInterval.minValue(), matrix.dy, matrix.numRows, rows, wy);
+
+    int cols[4];
+    double wx[4];
+    const int numTaps = qwtResampleTaps(mode, x, xInterval.minValue(), matrix.dx, matrix.numColumns, cols, wx);
+
+    double value = 0.0;
+    for (int k = 0; k < numRowTaps; k++) {
+        double v = 0.0;
+        for (int j = 0; j < numTaps; j++) {
+            v += wx[j] * matrix.value(rows[k], cols[j]);
+        }
+
+        value += wy[k] * v;
+    }
+
+    return value;
+}
+
+/*
+    Nearest neighbours of a row of positions, that are all inside
+    of the bounding rectangle of the matrix
+ */
+template <typename T>
+static inline void qwtNearestNeighbours(const QwtMatrixView<T> &matrix, const Interval &xInterval,
+                                        const Interval &yInterval, double x, double dx, double y, int numValues,
+                                        double *out)
+{
+    int row = int((y - yInterval.minValue()) / matrix.dy);
+    if (row >= matrix.numRows) {
+        row = matrix.numRows - 1;
+    }
+
+    const T *line = matrix.line(row);
+    const int stride = matrix.stride;
+    const int maxCol = matrix.numColumns - 1;
+
+    const double col0 = (x - xInterval.minValue()) / matrix.dx;
+    const double colStep = dx / matrix.dx;
+
+    const QwtVector vStep = qwtVectorSet(QwtVectorSize * colStep);
+
+    double colF[QwtVectorSize];
+    for (int k = 0; k < QwtVectorSize; k++) {
+        colF[k] = col0 + k * colStep;
+    }
+
+    QwtVector vCol = qwtVectorLoad(colF);
+
+    int i = 0;
+    for (; i + QwtVectorSize <= numValues; i += QwtVectorSize) {
+        int cols[QwtVectorSize];
+        qwtVectorTruncate(vCol, cols);
+        vCol = qwtVectorAdd(vCol, vStep);
+
+        for (int k = 0; k < QwtVectorSize; k++) {
+            out[i + k] = line[qBound(0, cols[k], maxCol) * stride];
+        }
+    }
+
+    for (; i < numValues; i++) {
+        out[i] = line[qBound(0, int(col0 + i * colStep), maxCol) * stride];
+    }
+}
+
+/*
+    Type, that is used for interpolating values of type T. Values, that
+    fit into the mantissa of a float, are interpolated in float, which
+    halves the width of the intermediate results.
+ */
+template <typename T>
+class QwtResampleTraits
+{
+public:
+    typedef double Accumulator;
+};
+
+template <>
+class QwtResampleTraits<float>
+{
+public:
+    typedef float Accumulator;
+};
+
+template <>
+class QwtResampleTraits<unsigned short>
+{
+public:
+    typedef float Accumulator;
+};
+
+template <>
+class QwtResampleTraits<short>
+{
+public:
+    typedef float Accumulator;
+};
+
+template <>
+class QwtResampleTraits<unsigned char>
+{
+public:
+    typedef float Accumulator;
+};
+
+template <>
+class QwtResampleTraits<signed char>
+{
+public:
+    typedef float Accumulator;
+};
+
+/*
+    Vertical pass of the resampling: interpolates the span columns
+    starting at colMin from numRowTaps lines of the matrix.
+
+    Contiguous lines are interpolated with a fixed number of taps,
+    so that the compiler can vectorize the loops for each type.
+ */
+template <typename T>
+static inline void qwtInterpolateLines(const T *const *lines, const double *wy, int numRowTaps, int stride, int colMin,
+                                       int span, double *columns)
+{
+    typedef typename QwtResampleTraits<T>::Accumulator Accumulator;
+
+    Accumulator w[4];
+    for (int k = 0; k < numRowTaps; k++) {
+        w[k] = Accumulator(wy[k]);
+    }
+
+    if ((stride == 1) && (numRowTaps == 2)) {
+        const T *l0 = lines[0] + colMin;
+        const T *l1 = lines[1] + colMin;
+
+        for (int c = 0; c < span; c++) {
+            columns[c] = w[0] * Accumulator(l0[c]) + w[1] * Accumulator(l1[c]);
+        }
+
+        return;
+    }
+
+    if ((stride == 1) && (numRowTaps == 4)) {
+        const T *l0 = lines[0] + colMin;
+        const T *l1 = lines[1] + colMin;
+        const T *l2 = lines[2] + colMin;
+        const T *l3 = lines[3] + colMin;
+
+        for (int c = 0; c < span; c++) {
+            columns[c] = w[0] * Accumulator(l0[c]) + w[1] * Accumulator(l1[c]) + w[2] * Accumulator(l2[c]) +
+                         w[3] * Accumulator(l3[c]);
+        }
+
+        return;
+    }
+
+    for (int c = 0; c < span; c++) {
+        const qint64 index = qint64(colMin + c) * stride;
+
+        Accumulator v = 0;
+        for (int k = 0; k < numRowTaps; k++) {
+            v += w[k] * Accumulator(lines[k][index]);
+        }
+
+        columns[c] = v;
+    }
+}
+
+// doubles, that are stored contiguously, are interpolated as vectors
+static inline void qwtInterpolateLines(const double *const *lines, const double *wy, int numRowTaps, int stride,
+                                       int colMin, int span, double *columns)
+{
+    if (stride != 1) {
+        qwtInterpolateLines<double>(lines, wy, numRowTaps, stride, colMin, span, columns);
+        return;
+    }
+
+    QwtVector vWy[4];
+    for (int k = 0; k < numRowTaps; k++) {
+        vWy[k] = qwtVectorSet(wy[k]);
+    }
+
+    int c = 0;
+    for (; c + QwtVectorSize <= span; c += QwtVectorSize) {
+        QwtVector v = qwtVectorMul(vWy[0], qwtVectorLoad(lines[0] + colMin + c));
+        for (int k = 1; k < numRowTaps; k++) {
+            v = qwtVectorAdd(v, qwtVectorMul(vWy[k], qwtVectorLoad(lines[k] + colMin + c)));
+        }
+
+        qwtVectorStore(columns + c, v);
+    }
+
+    for (; c < span; c++) {
+        double v = 0.0;
+        for (int k = 0; k < numRowTaps; k++) {
+            v += wy[k] * lines[k][colMin + c];
+        }
+
+        columns[c] = v;
+    }
+}
+
+/*
+    Bilinear or bicubic resampling of a row of positions, that are all
+    inside of the bounding rectangle of the matrix. The taps are taken
+    from the tables of initRaster(), when the positions are on their grid.
+ */
+template <typename T>
+static inline void qwtResampleValues(QwtMatrixRasterData::ResampleMode mode, const QwtMatrixView<T> &matrix,
+                                     const Interval &xInterval, const Interval &yInterval,
+                                     const QwtResampleTable &columnTable, const QwtResampleTable &rowTable, double x,
+                                     double dx, double y, int numValues, double *out)
+{
+    // taps of the row
+
+    int rows[4];
+    double wy[4];
+
+    int numRowTaps;
+
+    const int rowIndex = rowTable.find(y);
+    if (rowIndex >= 0) {
+        numRowTaps = rowTable.numTaps;
+        for (int k = 0; k < numRowTaps; k++) {
+            rows[k] = rowTable.indexes[k][rowIndex];
+            wy[k] = rowTable.weights[k][rowIndex];
+        }
+    } else {
+        const double yy = qBound(yInterval.minValue(), y, yInterval.maxValue());
+        numRowTaps = qwtResampleTaps(mode, yy, yInterval.minValue(), matrix.dy, matrix.numRows, rows, wy);
+    }
+
+    // taps of the columns, usually found in the table of initRaster()
+
+    QwtResampleTable localTable;
+    const QwtResampleTable *table = &columnTable;
+
+    int first = columnTable.find(x, dx);
+    if ((first < 0) || (first + numValues > columnTable.count)) {
+        localTable.init(mode, x, dx, numValues, xInterval, matrix.dx, matrix.numColumns);
+
+        table = &localTable;
+        first = 0;
+    }
+
+    const int numTaps = table->numTaps;
+
+    const int *colIndexes[4];
+    const double *colWeights[4];
+
+    for (int j = 0; j < numTaps; j++) {
+        colIndexes[j] = table->indexes[j].constData() + first;
+        colWeights[j] = table->weights[j].constData() + first;
+    }
+
+    // the positions are monotonic and so are the indexes of each tap
+
+    const int colMin = qMin(colIndexes[0][0], colIndexes[0][numValues - 1]);
+    const int colMax = qMax(colIndexes[numTaps - 1][0], colIndexes[numTaps - 1][numValues - 1]);
+    const int span = colMax - colMin + 1;
+
+    const T *lines[4];
+    for (int k = 0; k < numRowTaps; k++) {
+        lines[k] = matrix.line(rows[k]);
+    }
+
+    if (span > numTaps * numValues) {
+        /*
+            Far more columns than values: the vertical pass would
+            interpolate mostly columns, that are never used
+         */
+        for (int i = 0; i < numValues; i++) {
+            double v = 0.0;
+            for (int j = 0; j < numTaps; j++) {
+                const qint64 index = qint64(colIndexes[j][i]) * matrix.stride;
+
+                double vc = 0.0;
+                for (int k = 0; k < numRowTaps; k++) {
+                    vc += wy[k] * lines[k][index];
+                }
+
+                v += colWeights[j][i] * vc;
+            }
+
+            out[i] = v;
+        }
+
+        return;
+    }
+
+    // vertical pass: interpolate the row for all columns in [colMin, colMax]
+
+    QVarLengthArray<double, 1024> buffer(span);
+    double *columns = buffer.data();
+
+    qwtInterpolateLines(lines, wy, numRowTaps, matrix.stride, colMin, span, columns);
+
+    // horizontal pass: one dot product of numTaps values for each value
+
+    int i = 0;
+    for (; i + QwtVectorSize <= numValues; i += QwtVectorSize) {
+        QwtVector v = qwtVectorSet(0.0);
+
+        for (int j = 0; j < numTaps; j++) {
+            double gathered[QwtVectorSize];
+            for (int l = 0; l < QwtVectorSize; l++) {
+                gathered[l] = columns[colIndexes[j][i + l] - colMin];
+            }
+
+            v = qwtVectorAdd(v, qwtVectorMul(qwtVectorLoad(colWeights[j] + i), qwtVectorLoad(gathered)));
+        }
+
+        qwtVectorStore(out + i, v);
+    }
+
+    for (; i < numValues; i++) {
+        double v = 0.0;
+        for (int j = 0; j < numTaps; j++) {
+            v += colWeights[j][i] * columns[colIndexes[j][i] - colMin];
+        }
+
+        out[i] = v;
+    }
+}
+
+#endif
@@ -1,14 +1,14 @@
-﻿#include <QtConcurrentRun>
-#include <limits>
+﻿#include <limits>
+#include <string.h>
 
-#include <qfuture.h>
 #include <qmath.h>
+#include <qmutex.h>
 #include <qpaintengine.h>
 #include <qpainter.h>
-#include <qthread.h>
 
 #include "interval.h"
 #include "plotrasteritembase.h"
+#include "simd.h"
 
 class PlotRasterItemBase::PrivateData
 {
@@ -16,6 +16,10 @@ public:
     PrivateData() : alpha(-1), paintAttributes(PlotRasterItemBase::PaintInDeviceResolution)
     {
         cache.policy = PlotRasterItemBase::NoCache;
+        cache.maxBytes = 64 * 1024 * 1024;
+        cache.hits = 0;
+        cache.partialHits = 0;
+        cache.misses = 0;
     }
 
     int alpha;
@@ -23,14 +27,50 @@ public:
     PlotRasterItemBase::PaintAttributes paintAttributes;
 
     uint renderThreadCount = 6;
+    QSize renderTileSize;
 
-    struct ImageCache
+    // renderImage() might be called from several threads
+    QMutex timingMutex;
+    QVector<TileScheduler::TileTiming> tileTimings;
+
+    struct CacheEntry
     {
-        PlotRasterItemBase::CachePolicy policy;
         QRectF area;
         QSizeF size;
+        ScaleMap xMap;
+        ScaleMap yMap;
         QImage image;
+    };
+
+    struct ImageCache
+    {
+        PlotRasterItemBase::CachePolicy policy;
+        qint64 maxBytes;
+
+        // most recently used entry first
+        QList<CacheEntry> entries;
+
+        int hits;
+        int partialHits;
+        int misses;
     } cache;
+
+    void trimCache()
+    {
+        qint64 numBytes = 0;
+        for (int i = 0; i < cache.entries.size(); i++) {
+            const QImage &image = cache.entries[i].image;
+            numBytes += qint64(image.bytesPerLine()) * image.height();
+
+            // the most recent image is kept, even if it exceeds the budget
+            if (i > 0 && numBytes > cache.maxBytes) {
+                while (cache.entries.size() > i) {
+                    cache.entries.removeLast();
+                }
+                break;
+            }
+        }
+    }
 };
 
 static QRectF qwtAlignRect(const QRectF &rect)
@@ -93,7 +133,7 @@ static QRectF qwtStripRect(const QRectF &rect, const QRectF &area, const ScaleMa
 
 static QImage qwtExpandImage(const QImage &image, const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
                              const QRectF &area2, const QRectF &paintRect, const Interval &xInterval,
-                             const Interval &yInterval)
+                             const Interval &yInterval, uint numThreads)
 {
     const QRectF strippedRect = qwtStripRect(paintRect, area2, xMap, yMap, xInterval, yInterval);
     const QSize sz = strippedRect.toRect().size();
@@ -137,122 +177,82 @@ static QImage qwtExpandImage(const QImage &image, const ScaleMap &xMap, const Sc
         expanded.setColorTable(image.colorTable());
     }
 
-    switch (image.depth()) {
-    case 32 :
-    {
-        for (int y1 = 0; y1 < h; y1++) {
-            int yy1;
-            if (y1 == 0) {
-                yy1 = 0;
-            } else {
-                yy1 = qRound(y1 * ph - py0);
-                if (yy1 < 0) {
-                    yy1 = 0;
-                }
-            }
+    if ((image.depth() != 32) && (image.depth() != 8)) {
+        return image;
+    }
 
-            int yy2;
-            if (y1 == h - 1) {
-                yy2 = sz.height();
-            } else {
-                yy2 = qRound((y1 + 1) * ph - py0);
-                if (yy2 > sz.height()) {
-                    yy2 = sz.height();
-                }
-            }
+    // the borders of the expanded pixels are the same for all rows and columns
 
-            const quint32 *line1 = reinterpret_cast<const quint32 *>(image.scanLine(y1));
+    QVector<int> xBorders(w + 1);
+    xBorders[0] = 0;
+    xBorders[w] = sz.width();
+    for (int x1 = 1; x1 < w; x1++) {
+        xBorders[x1] = qBound(0, qRound(x1 * pw - px0), sz.width());
+    }
 
-            for (int x1 = 0; x1 < w; x1++) {
-                int xx1;
-                if (x1 == 0) {
-                    xx1 = 0;
-                } else {
-                    xx1 = qRound(x1 * pw - px0);
-                    if (xx1 < 0) {
-                        xx1 = 0;
-                    }
-                }
+    QVector<int> yBorders(h + 1);
+    yBorders[0] = 0;
+    yBorders[h] = sz.height();
+    for (int y1 = 1; y1 < h; y1++) {
+        yBorders[y1] = qBound(0, qRound(y1 * ph - py0), sz.height());
+    }
 
-                int xx2;
-                if (x1 == w - 1) {
-                    xx2 = sz.width();
-                } else {
-                    xx2 = qRound((x1 + 1) * pw - px0);
-                    if (xx2 > sz.width()) {
-                        xx2 = sz.width();
-                    }
-                }
+    // scanLine() of a shared image would detach, what is not thread safe
+    uchar *bits = expanded.bits();
+    const int bytesPerLine = expanded.bytesPerLine();
+    const int numBytes = sz.width() * image.depth() / 8;
 
-                const quint32 rgb(line1[x1]);
-                for (int y2 = yy1; y2 < yy2; y2++) {
-                    quint32 *line2 = reinterpret_cast<quint32 *>(expanded.scanLine(y2));
+    const QwtPixelKernels &kernels = qwtPixelKernels();
 
-                    for (int x2 = xx1; x2 < xx2; x2++) {
-                        line2[x2] = rgb;
-                    }
-                }
-            }
-        }
-        break;
-    }
-    case 8 :
-    {
-        for (int y1 = 0; y1 < h; y1++) {
-            int yy1;
-            if (y1 == 0) {
-                yy1 = 0;
-            } else {
-                yy1 = qRound(y1 * ph - py0);
-                if (yy1 < 0) {
-                    yy1 = 0;
-                }
-            }
+    /*
+        The first row of the expanded pixels of a row is filled span
+        by span and copied to the other rows. The rows of the image
+        are expanded in parallel, their expanded rows don't overlap.
+     */
 
-            int yy2;
-            if (y1 == h - 1) {
-                yy2 = sz.height();
-            } else {
-                yy2 = qRound((y1 + 1) * ph - py0);
-                if (yy2 > sz.height()) {
-                    yy2 = sz.height();
-                }
+    const auto expandRows = [&](const QRect &tile) {
+        for (int y1 = tile.top(); y1 <= tile.bottom(); y1++) {
+            const int yy1 = yBorders[y1];
+            const int yy2 = qMax(yBorders[y1 + 1], yy1);
+            if (yy1 >= yy2) {
+                continue;
             }
 
-            const uchar *line1 = image.scanLine(y1);
+            uchar *line2 = bits + qint64(yy1) * bytesPerLine;
+
+            if (image.depth() == 32) {
+                const quint32 *line1 = reinterpret_cast<const quint32 *>(image.scanLine(y1));
+                quint32 *rgbLine2 = reinterpret_cast<quint32 *>(line2);
 
-            for (int x1 = 0; x1 < w; x1++) {
-                int xx1;
-                if (x1 == 0) {
-                    xx1 = 0;
-                } else {
-                    xx1 = qRound(x1 * pw - px0);
-                    if (xx1 < 0) {
-                        xx1 = 0;
+                for (int x1 = 0; x1 < w; x1++) {
+                    const int xx1 = xBorders[x1];
+                    const int xx2 = xBorders[x1 + 1];
+                    if (xx2 > xx1) {
+                        kernels.fill(rgbLine2 + xx1, line1[x1], xx2 - xx1);
                     }
                 }
+            } else {
+                const uchar *line1 = image.scanLine(y1);
 
-                int xx2;
-                if (x1 == w - 1) {
-                    xx2 = sz.width();
-                } else {
-                    xx2 = qRound((x1 + 1) * pw - px0);
-                    if (xx2 > sz.width()) {
-                        xx2 = sz.width();
+                for (int x1 = 0; x1 < w; x1++) {
+                    const int xx1 = xBorders[x1];
+                    const int xx2 = xBorders[x1 + 1];
+                    if (xx2 > xx1) {
+                        memset(line2 + xx1, line1[x1], xx2 - xx1);
                     }
                 }
+            }
 
-                for (int y2 = yy1; y2 < yy2; y2++) {
-                    uchar *line2 = expanded.scanLine(y2);
-                    memset(line2 + xx1, line1[x1], xx2 - xx1);
-                }
+            for (int y2 = yy1 + 1; y2 < yy2; y2++) {
+                memcpy(bits + qint64(y2) * bytesPerLine, line2, numBytes);
             }
         }
-        break;
-    }
-    default :
-        expanded = image;
-    }
+    };
+
+    // bands of rows, that are large enough to be worth a thread
+    const int bandHeight = qMax(1, h / qMax(int(numThreads) * 4, 1));
+
+    TileScheduler::instance()->run(QSize(1, h), QSize(1, bandHeight), numThreads, expandRows);
 
     return expanded;
 }
@@ -336,39 +336,49 @@ static bool qwtUseCache(PlotRasterItemBase::CachePolicy policy, const QPainter *
     return doCache;
 }
 
+static void qwtCopyImage(const QImage &from, const QRect &fromRect, QImage *to, const QPoint &toPos)
+{
+    const int bytesPerPixel = from.depth() / 8;
+    const int numBytes = fromRect.width() * bytesPerPixel;
+
+    for (int y = 0; y < fromRect.height(); y++) {
+        const uchar *src = from.constScanLine(fromRect.top() + y) + fromRect.left() * bytesPerPixel;
+        uchar *dst = to->scanLine(toPos.y() + y) + toPos.x() * bytesPerPixel;
+
+        ::memcpy(dst, src, numBytes);
+    }
+}
+
 static void qwtToRgba(const QImage *from, QImage *to, const QRect &tile, int alpha)
 {
-    const QRgb mask1 = qRgba(0, 0, 0, alpha);
-    const QRgb mask2 = qRgba(255, 255, 255, 0);
-    const QRgb mask3 = qRgba(0, 0, 0, 255);
+    const quint32 mask = qRgba(0, 0, 0, alpha);
 
-    const int y0 = tile.top();
-    const int y1 = tile.bottom();
     const int x0 = tile.left();
-    const int x1 = tile.right();
+    const int numPixels = tile.width();
+
+    const QwtPixelKernels &kernels = qwtPixelKernels();
 
     if (from->depth() == 8) {
-        for (int y = y0; y <= y1; y++) {
-            QRgb *alphaLine = reinterpret_cast<QRgb *>(to->scanLine(y));
-            const unsigned char *line = from->scanLine(y);
+        // the alpha value is applied to the color table once
 
-            for (int x = x0; x <= x1; x++) {
-                *alphaLine++ = (from->color(*line++) & mask2) | mask1;
-            }
+        quint32 table[256];
+        for (int i = 0; i < 256; i++) {
+            table[i] = mask;
+        }
+
+        const QVector<QRgb> colorTable = from->colorTable();
+        for (int i = 0; i < qMin(colorTable.size(), 256); i++) {
+            table[i] = (colorTable[i] & 0x00ffffffu) | mask;
+        }
+
+        for (int y = tile.top(); y <= tile.bottom(); y++) {
+            kernels.mapIndexes(from->scanLine(y) + x0, reinterpret_cast<quint32 *>(to->scanLine(y)) + x0,
+                               numPixels, table);
         }
     } else if (from->depth() == 32) {
-        for (int y = y0; y <= y1; y++) {
-            QRgb *alphaLine = reinterpret_cast<QRgb *>(to->scanLine(y));
-            const QRgb *line = reinterpret_cast<const QRgb *>(from->scanLine(y));
-
-            for (int x = x0; x <= x1; x++) {
-                const QRgb rgb = *line++;
-                if (rgb & mask3) { // alpha != 0
-                    *alphaLine++ = (rgb & mask2) | mask1;
-                } else {
-                    *alphaLine++ = rgb;
-                }
-            }
+        for (int y = tile.top(); y <= tile.bottom(); y++) {
+            kernels.setAlpha(reinterpret_cast<const quint32 *>(from->scanLine(y)) + x0,
+                             reinterpret_cast<quint32 *>(to->scanLine(y)) + x0, numPixels, mask);
         }
     }
 }
@@ -494,9 +504,74 @@ PlotRasterItemBase::CachePolicy PlotRasterItemBase::cachePolicy() const
  */
 void PlotRasterItemBase::invalidateCache()
 {
-    m_data->cache.image = QImage();
-    m_data->cache.area = QRect();
-    m_data->cache.size = QSize();
+    m_data->cache.entries.clear();
+}
+
+/*!
+   \brief Set the memory budget of the paint cache
+
+   With the PaintCache policy several images are kept, so that going back
+   to a previous view or panning does not need to render the complete image
+   again. When the images exceed the budget the least recently used
+   ones are dropped. The most recent image is always kept.
+
+   The default budget is 64MB.
+
+   \param numBytes Memory budget in bytes
+   \sa cacheSize(), setCachePolicy()
+ */
+void PlotRasterItemBase::setCacheSize(qint64 numBytes)
+{
+    m_data->cache.maxBytes = qMax(numBytes, qint64(0));
+    m_data->trimCache();
+}
+
+/*!
+   \return Memory budget of the paint cache in bytes
+   \sa setCacheSize()
+ */
+qint64 PlotRasterItemBase::cacheSize() const
+{
+    return m_data->cache.maxBytes;
+}
+
+/*!
+   \return Number of images, that have been taken from the cache
+   \sa cachePartialHits(), cacheMisses(), resetCacheStatistics()
+ */
+int PlotRasterItemBase::cacheHits() const
+{
+    return m_data->cache.hits;
+}
+
+/*!
+   \return Number of images, that have been composed from the overlapping
+           region of a cached image and the newly exposed strips
+   \sa cacheHits(), cacheMisses(), resetCacheStatistics()
+ */
+int PlotRasterItemBase::cachePartialHits() const
+{
+    return m_data->cache.partialHits;
+}
+
+/*!
+   \return Number of images, that had to be rendered completely
+   \sa cacheHits(), cachePartialHits(), resetCacheStatistics()
+ */
+int PlotRasterItemBase::cacheMisses() const
+{
+    return m_data->cache.misses;
+}
+
+/*!
+   Reset the hit/miss counters of the paint cache
+   \sa cacheHits(), cachePartialHits(), cacheMisses()
+ */
+void PlotRasterItemBase::resetCacheStatistics()
+{
+    m_data->cache.hits = 0;
+    m_data->cache.partialHits = 0;
+    m_data->cache.misses = 0;
 }
 
 /*!
@@ -664,7 +739,8 @@ void PlotRasterItemBase::draw(QPainter *painter, const ScaleMap &xMap, const Sca
             // need to be expanded manually to rectangles of
             // different sizes
 
-            image = qwtExpandImage(image, xxMap, yyMap, imageArea, area, paintRect, xInterval, yInterval);
+            image = qwtExpandImage(image, xxMap, yyMap, imageArea, area, paintRect, xInterval, yInterval,
+                                   renderThreadCount());
         }
     }
 
@@ -752,6 +828,65 @@ uint PlotRasterItemBase::renderThreadCount() const
     return m_data->renderThreadCount;
 }
 
+/*!
+   \brief Set the size of the tiles for rendering in parallel threads
+
+   Smaller tiles balance the load between the threads better, but
+   add some overhead for each tile.
+
+   \param size Maximum size of a tile, an invalid size means
+               TileScheduler::defaultTileSize()
+
+   \sa renderTileSize(), setRenderThreadCount(), renderTileTimings()
+ */
+void PlotRasterItemBase::setRenderTileSize(const QSize &size)
+{
+    m_data->renderTileSize = size;
+}
+
+/*!
+   \return Size of the tiles for rendering in parallel threads
+   \sa setRenderTileSize()
+ */
+QSize PlotRasterItemBase::renderTileSize() const
+{
+    return m_data->renderTileSize;
+}
+
+/*!
+   \return Timings of the tiles, that have been processed for
+           composing the last image, or by the last renderImage()
+           call, when it has been called directly
+   \sa setRenderTileSize(), setRenderThreadCount()
+ */
+QVector<TileScheduler::TileTiming> PlotRasterItemBase::renderTileTimings() const
+{
+    QMutexLocker locker(&m_data->timingMutex);
+    return m_data->tileTimings;
+}
+
+/*!
+   \brief Process an image in tiles
+
+   The tiles are processed by TileScheduler::instance() using
+   renderThreadCount() threads and tiles of renderTileSize().
+
+   The timings of the tiles replace the ones of the previous call.
+
+   \param imageSize Size of the image
+   \param function Function, that is called for each tile
+
+   \sa renderTileTimings()
+ */
+void PlotRasterItemBase::renderTiles(const QSize &imageSize, const TileScheduler::TileFunction &function) const
+{
+    const QVector<TileScheduler::TileTiming> timings =
+        TileScheduler::instance()->run(imageSize, m_data->renderTileSize, renderThreadCount(), function);
+
+    QMutexLocker locker(&m_data->timingMutex);
+    m_data->tileTimings = timings;
+}
+
 QImage PlotRasterItemBase::compose(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &imageArea,
                                    const QRectF &paintRect, const QSize &imageSize, bool doCache) const
 {
@@ -760,10 +895,22 @@ QImage PlotRasterItemBase::compose(const ScaleMap &xMap, const ScaleMap &yMap, c
         return image;
     }
 
+    {
+        QMutexLocker locker(&m_data->timingMutex);
+        m_data->tileTimings.clear();
+    }
+
     if (doCache) {
-        if (!m_data->cache.image.isNull() && (m_data->cache.area == imageArea)
-            && (m_data->cache.size == paintRect.size())) {
-            image = m_data->cache.image;
+        QList<PrivateData::CacheEntry> &entries = m_data->cache.entries;
+        for (int i = 0; i < entries.size(); i++) {
+            const PrivateData::CacheEntry &entry = entries[i];
+            if ((entry.area == imageArea) && (entry.size == paintRect.size()) && (entry.image.size() == imageSize)) {
+                image = entry.image;
+                entries.move(i, 0);
+
+                m_data->cache.hits++;
+                break;
+            }
         }
     }
 
@@ -782,54 +929,246 @@ QImage PlotRasterItemBase::compose(const ScaleMap &xMap, const ScaleMap &yMap, c
 
         const ScaleMap yyMap = imageMap(Qt::Vertical, yMap, imageArea, imageSize, dy);
 
-        image = renderImage(xxMap, yyMap, imageArea, imageSize);
-
         if (doCache) {
-            m_data->cache.area = imageArea;
-            m_data->cache.size = paintRect.size();
-            m_data->cache.image = image;
+            image = composeFromCache(xxMap, yyMap, paintRect.size(), imageSize);
+            if (!image.isNull()) {
+                m_data->cache.partialHits++;
+            }
+        }
+
+        if (image.isNull()) {
+            image = renderImage(xxMap, yyMap, imageArea, imageSize);
+
+            if (doCache) {
+                m_data->cache.misses++;
+            }
+        }
+
+        if (doCache && !image.isNull() && isImageFinal()) {
+            PrivateData::CacheEntry entry;
+            entry.area = imageArea;
+            entry.size = paintRect.size();
+            entry.xMap = xxMap;
+            entry.yMap = yyMap;
+            entry.image = image;
+
+            m_data->cache.entries.prepend(entry);
+            m_data->trimCache();
         }
     }
 
     if ((m_data->alpha >= 0) && (m_data->alpha < 255)) {
         QImage alphaImage(image.size(), QImage::Format_ARGB32);
 
-#if !defined(QT_NO_QFUTURE)
-        uint numThreads = renderThreadCount();
+        // the timings of renderImage() and of the conversion
+        QVector<TileScheduler::TileTiming> timings = renderTileTimings();
+
+        const int alpha = m_data->alpha;
+        renderTiles(image.size(), [&image, &alphaImage, alpha](const QRect &tile) {
+            qwtToRgba(&image, &alphaImage, tile, alpha);
+        });
 
-        if (numThreads <= 0) {
-            numThreads = QThread::idealThreadCount();
+        {
+            QMutexLocker locker(&m_data->timingMutex);
+            timings += m_data->tileTimings;
+            m_data->tileTimings = timings;
         }
 
-        if (numThreads <= 0) {
-            numThreads = 1;
+        image = alphaImage;
+    }
+
+    return image;
+}
+
+/*!
+   \brief Check if the last image of renderImage() is final
+
+   Images, that are not final, are not inserted into the paint cache.
+   The default implementation returns always true.
+
+   \return true, when the image returned by the last renderImage() call
+           won't be refined later
+   \sa setCachePolicy()
+ */
+bool PlotRasterItemBase::isImageFinal() const
+{
+    return true;
+}
+
+/*!
+   \brief Draw on top of the image
+
+   A RasterCompositor composes the images of its items only. It calls
+   drawOverlay() for each item afterwards, so that the parts of an item,
+   that are not part of its image, are drawn on top of the composed image.
+   The default implementation does nothing.
+
+   \param painter Painter
+   \param xMap X-Scale Map
+   \param yMap Y-Scale Map
+   \param canvasRect Contents rectangle of the plot canvas
+
+   \sa RasterCompositor::draw()
+ */
+void PlotRasterItemBase::drawOverlay(QPainter *painter, const ScaleMap &xMap, const ScaleMap &yMap,
+                                     const QRectF &canvasRect) const
+{
+    Q_UNUSED(painter);
+    Q_UNUSED(xMap);
+    Q_UNUSED(yMap);
+    Q_UNUSED(canvasRect);
+}
+
+/*!
+   \brief Prepare rendering the image in tiles
+
+   Rendering in tiles allows a RasterCompositor to blend the tiles of
+   several items, without rendering the complete image of each item.
+   The default implementation returns false, what means, that
+   the item is composed from the result of renderImage().
+
+   \param area Area of the image in scale coordinates
+   \param imageSize Size of the image
+
+   \return true, when tileImage() and renderTile() are implemented
+   \sa tileImage(), renderTile(), endTiles(), RasterCompositor
+ */
+bool PlotRasterItemBase::beginTiles(const QRectF &area, const QSize &imageSize) const
+{
+    Q_UNUSED(area);
+    Q_UNUSED(imageSize);
+
+    return false;
+}
+
+/*!
+   \brief Create an image for rendering a tile
+
+   \param size Size of the tile
+   \return Image of the format and color table of renderImage()
+   \sa beginTiles(), renderTile()
+ */
+QImage PlotRasterItemBase::tileImage(const QSize &size) const
+{
+    Q_UNUSED(size);
+    return QImage();
+}
+
+/*!
+   \brief Render a tile of an image
+
+   Called from parallel threads between beginTiles() and endTiles().
+   The default implementation does nothing.
+
+   \param xMap X-Scale Map
+   \param yMap Y-Scale Map
+   \param tile Geometry of the tile in image coordinates
+   \param image Image of tileImage()
+
+   \sa beginTiles()
+ */
+void PlotRasterItemBase::renderTile(const ScaleMap &xMap, const ScaleMap &yMap, const QRect &tile,
+                                    QImage *image) const
+{
+    Q_UNUSED(xMap);
+    Q_UNUSED(yMap);
+    Q_UNUSED(tile);
+    Q_UNUSED(image);
+}
+
+/*!
+   \brief Release the resources of beginTiles()
+   \sa beginTiles()
+ */
+void PlotRasterItemBase::endTiles() const
+{
+}
+
+/*!
+   \brief Compose an image from a cached image of a panned view
+
+   Looks for a cached image of the same size and scale, that is shifted by
+   an integer number of pixels. The overlapping region is copied and only
+   the newly exposed strips are passed to renderImage().
+
+   \param xMap X-Scale Map of the image
+   \param yMap Y-Scale Map of the image
+   \param paintSize Size of the paint rectangle
+   \param imageSize Size of the image
+
+   \return Composed image, or a null image when no cached image can be reused
+ */
+QImage PlotRasterItemBase::composeFromCache(const ScaleMap &xMap, const ScaleMap &yMap, const QSizeF &paintSize,
+                                            const QSize &imageSize) const
+{
+    const QList<PrivateData::CacheEntry> &entries = m_data->cache.entries;
+
+    for (int i = 0; i < entries.size(); i++) {
+        const PrivateData::CacheEntry &entry = entries[i];
+        if ((entry.size != paintSize) || (entry.image.size() != imageSize)) {
+            continue;
         }
 
-        const int numRows = image.height() / numThreads;
+        int dx, dy;
+        if (!pixelOffset(entry.xMap, xMap, imageSize.width(), dx)
+            || !pixelOffset(entry.yMap, yMap, imageSize.height(), dy)) {
+            continue;
+        }
 
-        QVector<QFuture<void>> futures;
-        futures.reserve(numThreads - 1);
+        const QRect imageRect(QPoint(0, 0), imageSize);
+        const QRect overlap = imageRect & imageRect.translated(dx, dy);
 
-        for (uint i = 0; i < numThreads; i++) {
-            QRect tile(0, i * numRows, image.width(), numRows);
-            if (i == numThreads - 1) {
-                tile.setHeight(image.height() - i * numRows);
-                qwtToRgba(&image, &alphaImage, tile, m_data->alpha);
-            } else {
-                futures += QtConcurrent::run(&qwtToRgba, &image, &alphaImage, tile, m_data->alpha);
-            }
+        // newly exposed strips: a full height one on the left/right
+        // and one above/below the overlapping region
+
+        QVector<QRect> strips;
+        if (dx > 0) {
+            strips += QRect(0, 0, dx, imageSize.height());
+        } else if (dx < 0) {
+            strips += QRect(imageSize.width() + dx, 0, -dx, imageSize.height());
         }
-        for (int i = 0; i < futures.size(); i++) {
-            futures[i].waitForFinished();
+
+        if (dy > 0) {
+            strips += QRect(overlap.left(), 0, overlap.width(), dy);
+        } else if (dy < 0) {
+            strips += QRect(overlap.left(), imageSize.height() + dy, overlap.width(), -dy);
         }
-#else
-        const QRect tile(0, 0, image.width(), image.height());
-        qwtToRgba(&image, &alphaImage, tile, m_data->alpha);
-#endif
-        image = alphaImage;
+
+        QImage image(imageSize, entry.image.format());
+        if (image.format() == QImage::Format_Indexed8) {
+            image.setColorTable(entry.image.colorTable());
+        }
+
+        qwtCopyImage(entry.image, overlap.translated(-dx, -dy), &image, overlap.topLeft());
+
+        for (int j = 0; j < strips.size(); j++) {
+            const QRect &strip = strips[j];
+
+            ScaleMap sxMap = xMap;
+            sxMap.setPaintInterval(xMap.p1() - strip.left(), xMap.p2() - strip.left());
+
+            ScaleMap syMap = yMap;
+            syMap.setPaintInterval(yMap.p1() - strip.top(), yMap.p2() - strip.top());
+
+            const double x1 = xMap.invTransform(strip.left());
+            const double x2 = xMap.invTransform(strip.right());
+            const double y1 = yMap.invTransform(strip.top());
+            const double y2 = yMap.invTransform(strip.bottom());
+
+            const QRectF stripArea(QPointF(qMin(x1, x2), qMin(y1, y2)), QPointF(qMax(x1, x2), qMax(y1, y2)));
+
+            const QImage stripImage = renderImage(sxMap, syMap, stripArea, strip.size());
+            if (!isImageFinal() || stripImage.format() != image.format() || stripImage.size() != strip.size()) {
+                return QImage();
+            }
+
+            qwtCopyImage(stripImage, stripImage.rect(), &image, strip.topLeft());
+        }
+
+        return image;
     }
 
-    return image;
+    return QImage();
 }
 
 /*!
@@ -882,3 +1221,32 @@ ScaleMap PlotRasterItemBase::imageMap(Qt::Orientation orientation, const ScaleMa
 
     return newMap;
 }
+
+/*!
+   \brief Calculate the pixel offset between 2 scale maps
+
+   \param from Scale map of an image, that has been rendered before
+   \param to Scale map of the image to be painted
+   \param length Width or height of the images in pixels
+   \param offset Position of the pixel 0 of "from" in the pixels of "to"
+
+   \return true, when both maps have the same scale, the offset is
+           a whole number of pixels and the images overlap
+ */
+bool PlotRasterItemBase::pixelOffset(const ScaleMap &from, const ScaleMap &to, int length, int &offset)
+{
+    // the position of the pixels of "from" in the pixel coordinates of "to"
+    const double p1 = to.transform(from.invTransform(0.0));
+    const double p2 = to.transform(from.invTransform(length));
+
+    if (qAbs(p2 - p1 - length) > 1e-3) {
+        return false; // different scale
+    }
+
+    offset = qRound(p1);
+    if (qAbs(p1 - offset) > 1e-3 || qAbs(offset) >= length) {
+        return false; // subpixel shift or no overlap
+    }
+
+    return true;
+}
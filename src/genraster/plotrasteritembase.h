@@ -5,6 +5,7 @@
 #include <QString>
 
 #include "scalemap.h"
+#include "tilescheduler.h"
 
 class Interval;
 
@@ -17,7 +18,8 @@ class Interval;
 
    Often a plot has several types of raster data organized in layers.
    ( f.e a geographical map, with weather statistics ).
-   Using setAlpha() raster items can be stacked easily.
+   Using setAlpha() raster items can be stacked easily, a RasterCompositor
+   blends stacked items in a single pass.
 
    PlotRasterItemBase is only implemented for images of the following formats:
    QImage::Format_Indexed8, QImage::Format_ARGB32.
@@ -43,9 +45,10 @@ public:
            renderImage() is called, whenever the image cache is not valid,
            or the scales, or the size of the canvas has changed.
 
-           This type of cache is useful for improving the performance
-           of hide/show operations or manipulations of the alpha value.
-           All other situations are handled by the canvas backing store.
+           Several images are kept within the budget of setCacheSize().
+           When panning without changing the scale, the overlapping
+           region of a cached image is reused and only the newly
+           exposed strips are rendered.
          */
         PaintCache
     };
@@ -87,6 +90,14 @@ public:
 
     void invalidateCache();
 
+    void setCacheSize(qint64 numBytes);
+    qint64 cacheSize() const;
+
+    int cacheHits() const;
+    int cachePartialHits() const;
+    int cacheMisses() const;
+    void resetCacheStatistics();
+
     virtual void draw(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &canvasRect) const;
 
     virtual QRectF pixelHint(const QRectF &) const;
@@ -97,6 +108,11 @@ public:
     void setRenderThreadCount(uint numThreads);
     uint renderThreadCount() const;
 
+    void setRenderTileSize(const QSize &);
+    QSize renderTileSize() const;
+
+    QVector<TileScheduler::TileTiming> renderTileTimings() const;
+
 protected:
     /*!
        \brief Render an image
@@ -117,10 +133,25 @@ protected:
     virtual QImage renderImage(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
                                const QSize &imageSize) const = 0;
 
+    virtual bool isImageFinal() const;
+
+    virtual void drawOverlay(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &canvasRect) const;
+
     virtual ScaleMap imageMap(Qt::Orientation, const ScaleMap &map, const QRectF &area, const QSize &imageSize,
                               double pixelSize) const;
 
+    static bool pixelOffset(const ScaleMap &from, const ScaleMap &to, int length, int &offset);
+
+    void renderTiles(const QSize &imageSize, const TileScheduler::TileFunction &) const;
+
+    virtual bool beginTiles(const QRectF &area, const QSize &imageSize) const;
+    virtual QImage tileImage(const QSize &) const;
+    virtual void renderTile(const ScaleMap &xMap, const ScaleMap &yMap, const QRect &tile, QImage *) const;
+    virtual void endTiles() const;
+
 private:
+    friend class RasterCompositor;
+
     explicit PlotRasterItemBase(const PlotRasterItemBase &);
     PlotRasterItemBase &operator=(const PlotRasterItemBase &);
 
@@ -129,6 +160,9 @@ private:
     QImage compose(const ScaleMap &, const ScaleMap &, const QRectF &imageArea, const QRectF &paintRect,
                    const QSize &imageSize, bool doCache) const;
 
+    QImage composeFromCache(const ScaleMap &, const ScaleMap &, const QSizeF &paintSize,
+                            const QSize &imageSize) const;
+
     class PrivateData;
     PrivateData *m_data;
 };
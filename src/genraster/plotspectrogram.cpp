@@ -1,14 +1,15 @@
 ﻿#include "plotspectrogram.h"
 
+#include <QMutex>
 #include <QPaintEngine>
 #include <QtConcurrentRun>
 
+#include <qelapsedtimer.h>
 #include <qfuture.h>
 #include <qimage.h>
 #include <qmath.h>
 #include <qpainter.h>
 #include <qpen.h>
-#include <qthread.h>
 
 #include "colormap.h"
 #include "interval.h"
@@ -17,10 +18,11 @@
 #define DEBUG_RENDER 0
 
 #if DEBUG_RENDER
-#include <qelapsedtimer.h>
+#include <qdebug.h>
 #endif
 
 #include <algorithm>
+#include <string.h>
 
 static inline bool qwtIsNaN(double d)
 {
@@ -35,14 +37,100 @@ static inline bool qwtIsNaN(double d)
     }
 }
 
+// number of cell rows of a band of the contour cache
+static const int qwtContourCacheRows = 32;
+
+// coarsest level of the progressive mode: 1/8 of the resolution
+static const int qwtMaxRenderLevel = 3;
+
+static bool qwtIsSameMap(const ScaleMap &map1, const ScaleMap &map2)
+{
+    return (map1.p1() == map2.p1()) && (map1.p2() == map2.p2()) && (map1.s1() == map2.s1())
+        && (map1.s2() == map2.s2());
+}
+
+// mark the rows of an image, that are affected by the interval [y1, y2]
+static void qwtMarkRows(const ScaleMap &yMap, double y1, double y2, QVector<bool> &rows)
+{
+    const double limit = rows.size() + 1.0;
+
+    double p1 = qBound(-limit, yMap.transform(y1), limit);
+    double p2 = qBound(-limit, yMap.transform(y2), limit);
+    if (p1 > p2) {
+        qSwap(p1, p2);
+    }
+
+    // one extra row for the rounding of the pixel positions
+    const int row1 = qMax(qFloor(p1) - 1, 0);
+    const int row2 = qMin(qCeil(p2) + 1, rows.size() - 1);
+
+    for (int row = row1; row <= row2; row++) {
+        rows[row] = true;
+    }
+}
+
+static QSize qwtLevelSize(const QSize &imageSize, int factor)
+{
+    // pixel i of the level corresponds to pixel i * factor of the image
+
+    const int w = qRound(double(imageSize.width() - 1) / factor) + 1;
+    const int h = qRound(double(imageSize.height() - 1) / factor) + 1;
+
+    return QSize(qMin(w, imageSize.width()), qMin(h, imageSize.height()));
+}
+
+static QImage qwtUpscaleImage(const QImage &image, const QSize &imageSize, int factor)
+{
+    QImage scaled(imageSize, image.format());
+    if (image.format() == QImage::Format_Indexed8) {
+        scaled.setColorTable(image.colorTable());
+    }
+
+    QVector<int> columns(imageSize.width());
+    for (int x = 0; x < columns.size(); x++) {
+        columns[x] = qMin((x + factor / 2) / factor, image.width() - 1);
+    }
+
+    for (int y = 0; y < imageSize.height(); y++) {
+        const int row = qMin((y + factor / 2) / factor, image.height() - 1);
+
+        if (image.depth() == 32) {
+            const QRgb *from = reinterpret_cast<const QRgb *>(image.constScanLine(row));
+            QRgb *to = reinterpret_cast<QRgb *>(scaled.scanLine(y));
+
+            for (int x = 0; x < columns.size(); x++) {
+                to[x] = from[columns[x]];
+            }
+        } else {
+            const uchar *from = image.constScanLine(row);
+            uchar *to = scaled.scanLine(y);
+
+            for (int x = 0; x < columns.size(); x++) {
+                to[x] = from[columns[x]];
+            }
+        }
+    }
+
+    return scaled;
+}
+
 class PlotSpectrogram::PrivateData
 {
 public:
-    PrivateData() : data(NULL), colorTableSize(0)
+    PrivateData() :
+        data(NULL), contourAlgorithm(RasterData::Conrec), colorTableSize(0), renderMode(DirectRender),
+        renderLatency(50)
     {
         colorMap = new LinearColorMap();
         displayMode = ImageMode;
 
+        refinement.level = 0;
+        refinement.returnedLevel = 0;
+        refinement.cancelled = false;
+
+        resetContourCaches();
+        scrollCache.revision = -1;
+
         conrecFlags = RasterData::IgnoreAllVerticesOnLevel;
 #if 0
         conrecFlags |= RasterData::IgnoreOutOfRange;
@@ -75,9 +163,109 @@ public:
     QList<double> contourLevels;
     QPen defaultContourPen;
     RasterData::ConrecFlags conrecFlags;
+    RasterData::ContourAlgorithm contourAlgorithm;
 
     int colorTableSize;
     QVector<QRgb> colorTable;
+
+    PlotSpectrogram::RenderMode renderMode;
+    int renderLatency;
+    PlotSpectrogram::RefinementFunction refinementFunction;
+
+    /*
+        State of the progressive mode. Everything but future and returnedLevel
+        is shared with the refinement running in the background
+     */
+    struct Refinement
+    {
+        QMutex mutex;
+
+        ScaleMap xMap;
+        ScaleMap yMap;
+        QRectF area;
+        QSize imageSize;
+
+        QImage image;
+        int level;
+        bool cancelled;
+
+        QFuture<void> future;
+        int returnedLevel;
+    } refinement;
+
+    /*
+        Contour lines of the last draw() split into bands of cell rows,
+        so that only the bands, that are affected by a change of
+        the data, need to be recalculated.
+
+        For data without revision the lines are a single band, that is
+        reused only while a refinement is running: the data must not
+        be modified then.
+     */
+    struct ContourCache
+    {
+        QRectF rect;
+        QSize raster;
+        QList<double> levels;
+        RasterData::ConrecFlags flags;
+
+        int revision;
+        bool untracked;
+        QVector<RasterData::ContourLines> bands;
+    } contourCache;
+
+    // connected contour lines of the last draw(), valid like the contour cache
+    struct PolylineCache
+    {
+        QRectF rect;
+        QSize raster;
+        QList<double> levels;
+        RasterData::ConrecFlags flags;
+
+        bool isValid;
+        int revision;
+        RasterData::ContourPolylines polylines;
+    } polylineCache;
+
+    void resetContourCaches()
+    {
+        contourCache.revision = -1;
+        contourCache.untracked = false;
+        contourCache.bands.clear();
+
+        polylineCache.isValid = false;
+        polylineCache.polylines.clear();
+    }
+
+    /*
+        Image of the last renderImage() in ScrollingRender mode. The ring
+        has 2 copies of the image rows, so that any window of height rows
+        is contiguous in memory.
+     */
+    struct ScrollCache
+    {
+        ScaleMap xMap;
+        ScaleMap yMap;
+        QSize size;
+
+        QImage ring;
+        int offset;
+
+        int revision;
+        Interval yInterval;
+    } scrollCache;
+
+    void resetScrollCache()
+    {
+        scrollCache.ring = QImage();
+        scrollCache.revision = -1;
+    }
+
+    bool isRefinementCancelled()
+    {
+        QMutexLocker locker(&refinement.mutex);
+        return refinement.cancelled;
+    }
 };
 
 /*!
@@ -99,6 +287,7 @@ PlotSpectrogram::PlotSpectrogram(const QString &title) : PlotRasterItemBase(titl
 // ! Destructor
 PlotSpectrogram::~PlotSpectrogram()
 {
+    cancelRefinement();
     delete m_data;
 }
 
@@ -134,6 +323,98 @@ bool PlotSpectrogram::testDisplayMode(DisplayMode mode) const
     return (m_data->displayMode & mode);
 }
 
+/*!
+   \brief Change the render mode
+
+   In ProgressiveRender mode renderImage() returns a coarse image
+   and refines it in the background. The refinement calls
+   RasterData::initRaster(), values() and discardRaster() of the data
+   from another thread: while it is running the data must not be used
+   or modified by the application. Changing the data, the color map or
+   the render mode cancels the refinement, as does calculating contour
+   lines, when the data has to be accessed for it. Otherwise
+   waitForRefinement() or cancelRefinement() has to be called before.
+
+   The default setting is DirectRender.
+
+   \param mode Render mode
+   \sa RenderMode, renderMode(), setRenderLatency(), setRefinementFunction()
+ */
+void PlotSpectrogram::setRenderMode(RenderMode mode)
+{
+    if (mode != m_data->renderMode) {
+        cancelRefinement();
+
+        m_data->renderMode = mode;
+        m_data->resetScrollCache();
+        invalidateCache();
+    }
+}
+
+/*!
+   \return Render mode
+   \sa setRenderMode()
+ */
+PlotSpectrogram::RenderMode PlotSpectrogram::renderMode() const
+{
+    return m_data->renderMode;
+}
+
+/*!
+   \brief Set the latency budget of the progressive mode
+
+   In ProgressiveRender mode the coarsest level ( 1/8 of the resolution )
+   is always rendered. Finer levels are rendered before renderImage()
+   returns as long as they are expected to fit into the budget, the
+   remaining ones are rendered in the background.
+
+   The default setting is 50ms.
+
+   \param msecs Latency budget in milliseconds
+   \sa renderLatency(), setRenderMode()
+ */
+void PlotSpectrogram::setRenderLatency(int msecs)
+{
+    m_data->renderLatency = qMax(msecs, 0);
+}
+
+/*!
+   \return Latency budget of the progressive mode in milliseconds
+   \sa setRenderLatency()
+ */
+int PlotSpectrogram::renderLatency() const
+{
+    return m_data->renderLatency;
+}
+
+/*!
+   \brief Set a function, that is called when a finer level is ready
+
+   The function is called from the thread of the background refinement
+   with the level of the image: 0 is the full resolution, n is
+   1 / 2^n of it. An application usually schedules a replot, that
+   picks up the refined image in renderImage().
+
+   \param function Notification function
+   \sa setRenderMode(), waitForRefinement()
+ */
+void PlotSpectrogram::setRefinementFunction(const RefinementFunction &function)
+{
+    cancelRefinement();
+    m_data->refinementFunction = function;
+}
+
+/*!
+   Wait until the background refinement of the progressive mode
+   has finished.
+
+   \sa setRenderMode()
+ */
+void PlotSpectrogram::waitForRefinement() const
+{
+    m_data->refinement.future.waitForFinished();
+}
+
 /*!
    Change the color map
 
@@ -151,12 +432,15 @@ void PlotSpectrogram::setColorMap(ColorMap *colorMap)
         return;
     }
 
+    cancelRefinement();
+
     if (colorMap != m_data->colorMap) {
         delete m_data->colorMap;
         m_data->colorMap = colorMap;
     }
 
     m_data->updateColorTable();
+    m_data->resetScrollCache();
 
     invalidateCache();
 }
@@ -193,8 +477,11 @@ void PlotSpectrogram::setColorTableSize(int numColors)
 {
     numColors = qMax(numColors, 0);
     if (numColors != m_data->colorTableSize) {
+        cancelRefinement();
+
         m_data->colorTableSize = numColors;
         m_data->updateColorTable();
+        m_data->resetScrollCache();
         invalidateCache();
     }
 }
@@ -315,6 +602,33 @@ bool PlotSpectrogram::testConrecFlag(RasterData::ConrecFlag flag) const
     return m_data->conrecFlags & flag;
 }
 
+/*!
+   \brief Change the algorithm for the contour lines
+
+   MarchingSquares results in connected polylines, that are painted
+   with one QPainter::drawPolyline() each, instead of one line
+   for each segment of Conrec.
+
+   The default setting is RasterData::Conrec.
+
+   \param algorithm Contour algorithm
+   \sa contourAlgorithm(), renderContourPolylines(),
+       RasterData::contourPolylines()
+ */
+void PlotSpectrogram::setContourAlgorithm(RasterData::ContourAlgorithm algorithm)
+{
+    m_data->contourAlgorithm = algorithm;
+}
+
+/*!
+   \return Algorithm for the contour lines
+   \sa setContourAlgorithm()
+ */
+RasterData::ContourAlgorithm PlotSpectrogram::contourAlgorithm() const
+{
+    return m_data->contourAlgorithm;
+}
+
 /*!
    Set the levels of the contour lines
 
@@ -352,6 +666,11 @@ QList<double> PlotSpectrogram::contourLevels() const
 void PlotSpectrogram::setData(RasterData *data)
 {
     if (data != m_data->data) {
+        cancelRefinement();
+
+        m_data->resetContourCaches();
+        m_data->resetScrollCache();
+
         delete m_data->data;
         m_data->data = data;
 
@@ -448,77 +767,492 @@ QImage PlotSpectrogram::renderImage(const ScaleMap &xMap, const ScaleMap &yMap,
         return QImage();
     }
 
+    if (m_data->renderMode == ProgressiveRender) {
+        return renderProgressive(xMap, yMap, area, imageSize);
+    }
+
+    if (m_data->renderMode == ScrollingRender) {
+        return renderScrolling(xMap, yMap, area, imageSize);
+    }
+
+#if DEBUG_RENDER
+    QElapsedTimer time;
+    time.start();
+#endif
+
+    const QImage image = renderLevel(xMap, yMap, area, imageSize, 0, false);
+
+#if DEBUG_RENDER
+    const qint64 elapsed = time.elapsed();
+    qDebug() << "renderImage" << imageSize << elapsed;
+
+    const QVector<TileScheduler::TileTiming> timings = renderTileTimings();
+
+    QVector<qint64> workerNSecs;
+    for (int i = 0; i < timings.size(); i++) {
+        const TileScheduler::TileTiming &timing = timings[i];
+        if (timing.worker >= workerNSecs.size()) {
+            workerNSecs.resize(timing.worker + 1);
+        }
+        workerNSecs[timing.worker] += timing.nsecs;
+    }
+    qDebug() << "tiles" << timings.size() << "nsecs per worker" << workerNSecs;
+#endif
+
+    return image;
+}
+
+/*!
+   \return true, when the last image returned by renderImage() is not
+           going to be refined
+ */
+bool PlotSpectrogram::isImageFinal() const
+{
+    switch (m_data->renderMode) {
+    case ProgressiveRender :
+        return m_data->refinement.returnedLevel == 0;
+    case ScrollingRender :
+        // the image shares its memory with the scroll cache
+        return false;
+    default :
+        return true;
+    }
+}
+
+/*!
+   \brief Render an image at a reduced resolution
+
+   \param xMap X-Scale Map of the image
+   \param yMap Y-Scale Map of the image
+   \param area Requested area for the image in scale coordinates
+   \param imageSize Size of the image
+   \param level Level of detail: the resolution is reduced by 2^level
+   \param background true, when called from the background refinement
+
+   \return Image of qwtLevelSize( imageSize, 2^level )
+ */
+QImage PlotSpectrogram::renderLevel(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
+                                    const QSize &imageSize, int level, bool background) const
+{
+    const int factor = 1 << level;
+    const QSize size = qwtLevelSize(imageSize, factor);
+
+    ScaleMap xxMap = xMap;
+    ScaleMap yyMap = yMap;
+    QRectF rect = area;
+
+    if (level > 0) {
+        xxMap.setPaintInterval(xMap.p1() / factor, xMap.p2() / factor);
+        yyMap.setPaintInterval(yMap.p1() / factor, yMap.p2() / factor);
+
+        const double x1 = xxMap.invTransform(0);
+        const double x2 = xxMap.invTransform(size.width() - 1);
+        const double y1 = yyMap.invTransform(0);
+        const double y2 = yyMap.invTransform(size.height() - 1);
+
+        rect = QRectF(QPointF(qMin(x1, x2), qMin(y1, y2)), QPointF(qMax(x1, x2), qMax(y1, y2)));
+    }
+
     const QImage::Format format =
         (m_data->colorMap->format() == ColorMap::RGB) ? QImage::Format_ARGB32 : QImage::Format_Indexed8;
 
-    QImage image(imageSize, format);
+    QImage image(size, format);
 
     if (m_data->colorMap->format() == ColorMap::Indexed) {
         image.setColorTable(m_data->colorMap->colorTable256());
     }
 
-    m_data->data->initRaster(area, image.size());
+    m_data->data->initRaster(rect, image.size());
 
-#if DEBUG_RENDER
-    QElapsedTimer time;
-    time.start();
-#endif
+    const TileScheduler::TileFunction function = [this, &xxMap, &yyMap, &image](const QRect &tile) {
+        renderTile(xxMap, yyMap, tile, &image);
+    };
 
-#if !defined(QT_NO_QFUTURE)
-    uint numThreads = renderThreadCount();
+    if (background) {
+        // the timings of renderTiles() belong to the foreground
 
-    if (numThreads <= 0) {
-        numThreads = QThread::idealThreadCount();
+        TileScheduler::instance()->run(image.size(), renderTileSize(), renderThreadCount(),
+                                       [this, &function](const QRect &tile) {
+                                           if (!m_data->isRefinementCancelled()) {
+                                               function(tile);
+                                           }
+                                       });
+    } else {
+        renderTiles(image.size(), function);
     }
 
-    if (numThreads <= 0) {
-        numThreads = 1;
+    m_data->data->discardRaster();
+
+    return image;
+}
+
+/*!
+   \brief Render an image in ProgressiveRender mode
+
+   As long as the background refinement for the same maps, area and
+   size is in progress the best level available so far is returned.
+   Otherwise a running refinement is cancelled, the coarse levels are
+   rendered within the latency budget and the refinement of the
+   remaining levels is started.
+
+   \param xMap X-Scale Map
+   \param yMap Y-Scale Map
+   \param area Requested area for the image in scale coordinates
+   \param imageSize Requested size of the image
+
+   \return Image of imageSize, upscaled from a coarse level if necessary
+ */
+QImage PlotSpectrogram::renderProgressive(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
+                                          const QSize &imageSize) const
+{
+    PrivateData::Refinement &refinement = m_data->refinement;
+
+    {
+        QMutexLocker locker(&refinement.mutex);
+
+        if (!refinement.image.isNull() && (refinement.area == area) && (refinement.imageSize == imageSize)
+            && qwtIsSameMap(refinement.xMap, xMap) && qwtIsSameMap(refinement.yMap, yMap)) {
+            const QImage image = refinement.image;
+            const int level = refinement.level;
+
+            if (level == 0) {
+                // from now on the image is in the hands of the paint cache
+                refinement.image = QImage();
+            }
+
+            locker.unlock();
+
+            refinement.returnedLevel = level;
+            return (level > 0) ? qwtUpscaleImage(image, imageSize, 1 << level) : image;
+        }
     }
 
-    const int numRows = imageSize.height() / numThreads;
+    cancelRefinement();
 
-    QVector<QFuture<void>> futures;
-    futures.reserve(numThreads - 1);
+    QElapsedTimer timer;
+    timer.start();
 
-    for (uint i = 0; i < numThreads; i++) {
-        QRect tile(0, i * numRows, image.width(), numRows);
-        if (i == numThreads - 1) {
-            tile.setHeight(image.height() - i * numRows);
-            renderTile(xMap, yMap, tile, &image);
-        } else {
-            futures += QtConcurrent::run(
-#if QT_VERSION >= 0x060000
-                &PlotSpectrogram::renderTile, this,
-#else
-                this, &PlotSpectrogram::renderTile,
-#endif
-                xMap, yMap, tile, &image);
+    int level = qwtMaxRenderLevel;
+    QImage image = renderLevel(xMap, yMap, area, imageSize, level, false);
+
+    qint64 cost = qMax(timer.elapsed(), qint64(1));
+
+    while (level > 0) {
+        // the next level has 4 times the pixels
+
+        if (timer.elapsed() + 4 * cost > m_data->renderLatency) {
+            break;
         }
+
+        QElapsedTimer levelTimer;
+        levelTimer.start();
+
+        level--;
+        image = renderLevel(xMap, yMap, area, imageSize, level, false);
+
+        cost = qMax(levelTimer.elapsed(), qint64(1));
     }
 
-    for (int i = 0; i < futures.size(); i++) {
-        futures[i].waitForFinished();
+    refinement.returnedLevel = level;
+
+    if (level == 0) {
+        return image;
     }
-#else
-    const QRect tile(0, 0, image.width(), image.height());
-    renderTile(xMap, yMap, tile, &image);
-#endif
 
-#if DEBUG_RENDER
-    const qint64 elapsed = time.elapsed();
-    qDebug() << "renderImage" << imageSize << elapsed;
-#endif
+    {
+        QMutexLocker locker(&refinement.mutex);
+
+        refinement.xMap = xMap;
+        refinement.yMap = yMap;
+        refinement.area = area;
+        refinement.imageSize = imageSize;
+        refinement.image = image;
+        refinement.level = level;
+        refinement.cancelled = false;
+    }
 
-    m_data->data->discardRaster();
+    refinement.future = QtConcurrent::run(this, &PlotSpectrogram::refine, xMap, yMap, area, imageSize, level);
+
+    return qwtUpscaleImage(image, imageSize, 1 << level);
+}
+
+/*!
+   \brief Render an image in ScrollingRender mode
+
+   When the maps differ from the previous call by a vertical shift of
+   an integer number of pixels only, the rows of the previous image are
+   reused. Rendered are the exposed rows, the rows of
+   RasterData::changedArea() since the previous call and the rows,
+   that have been dropped from the interval of the y axis.
+
+   Data without a revision ( see RasterData::revision() ) is always
+   rendered completely.
+
+   \param xMap X-Scale Map
+   \param yMap Y-Scale Map
+   \param area Requested area for the image in scale coordinates
+   \param imageSize Requested size of the image
+
+   \return Image, that refers to the memory of the scroll cache. It is
+           valid until the next call of renderImage().
+ */
+QImage PlotSpectrogram::renderScrolling(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
+                                        const QSize &imageSize) const
+{
+    PrivateData::ScrollCache &cache = m_data->scrollCache;
+
+    const RasterData *data = m_data->data;
+    const int revision = data->revision();
+
+    const int w = imageSize.width();
+    const int h = imageSize.height();
+
+    const QImage::Format format =
+        (m_data->colorMap->format() == ColorMap::RGB) ? QImage::Format_ARGB32 : QImage::Format_Indexed8;
+
+    int dy = 0;
+
+    const bool doScroll = (revision >= 0) && (cache.revision >= 0) && !cache.ring.isNull()
+                          && (cache.size == imageSize) && (cache.ring.format() == format)
+                          && qwtIsSameMap(cache.xMap, xMap) && pixelOffset(cache.yMap, yMap, h, dy);
+
+    const int bytesPerLine = (format == QImage::Format_ARGB32) ? 4 * w : w;
+
+    if (!doScroll) {
+        const QImage image = renderLevel(xMap, yMap, area, imageSize, 0, false);
+        if (revision < 0) {
+            m_data->resetScrollCache();
+            return image;
+        }
+
+        cache.ring = QImage(w, 2 * h, format);
+        if (format == QImage::Format_Indexed8) {
+            cache.ring.setColorTable(image.colorTable());
+        }
+
+        for (int y = 0; y < h; y++) {
+            memcpy(cache.ring.scanLine(y), image.constScanLine(y), bytesPerLine);
+            memcpy(cache.ring.scanLine(y + h), image.constScanLine(y), bytesPerLine);
+        }
+
+        cache.offset = 0;
+    } else {
+        // row y of the previous image is row y + dy now
+        cache.offset = ((cache.offset - dy) % h + h) % h;
+
+        QVector<bool> rows(h, false);
+
+        // the exposed rows
+        for (int y = 0; y < h; y++) {
+            if ((y - dy < 0) || (y - dy >= h)) {
+                rows[y] = true;
+            }
+        }
+
+        const QRectF changedArea = data->changedArea(cache.revision);
+        if (!changedArea.isNull()) {
+            qwtMarkRows(yMap, changedArea.top(), changedArea.bottom(), rows);
+        }
+
+        // the rows, that have been dropped from the data
+
+        const Interval yInterval = data->interval(Qt::YAxis);
+        const Interval &oldInterval = cache.yInterval;
+
+        if (oldInterval.isValid()) {
+            if (!yInterval.isValid()) {
+                qwtMarkRows(yMap, oldInterval.minValue(), oldInterval.maxValue(), rows);
+            } else {
+                if (oldInterval.minValue() < yInterval.minValue()) {
+                    qwtMarkRows(yMap, oldInterval.minValue(), yInterval.minValue(), rows);
+                }
+
+                if (oldInterval.maxValue() > yInterval.maxValue()) {
+                    qwtMarkRows(yMap, yInterval.maxValue(), oldInterval.maxValue(), rows);
+                }
+            }
+        }
+
+        // render each run of marked rows as a strip
+
+        int y1 = 0;
+        while (y1 < h) {
+            if (!rows[y1]) {
+                y1++;
+                continue;
+            }
+
+            int y2 = y1;
+            while ((y2 + 1 < h) && rows[y2 + 1]) {
+                y2++;
+            }
+
+            ScaleMap syMap = yMap;
+            syMap.setPaintInterval(yMap.p1() - y1, yMap.p2() - y1);
+
+            const double v1 = yMap.invTransform(y1);
+            const double v2 = yMap.invTransform(y2);
+
+            const QRectF stripArea(QPointF(area.left(), qMin(v1, v2)), QPointF(area.right(), qMax(v1, v2)));
+
+            const QImage strip = renderLevel(xMap, syMap, stripArea, QSize(w, y2 - y1 + 1), 0, false);
+
+            for (int y = y1; y <= y2; y++) {
+                const int ringRow = (cache.offset + y) % h;
+
+                memcpy(cache.ring.scanLine(ringRow), strip.constScanLine(y - y1), bytesPerLine);
+                memcpy(cache.ring.scanLine(ringRow + h), strip.constScanLine(y - y1), bytesPerLine);
+            }
+
+            y1 = y2 + 1;
+        }
+    }
+
+    cache.xMap = xMap;
+    cache.yMap = yMap;
+    cache.size = imageSize;
+    cache.revision = revision;
+    cache.yInterval = data->interval(Qt::YAxis);
+
+    // no copy: a window of the ring
+
+    const QImage &ring = cache.ring;
+
+    QImage image(ring.constScanLine(cache.offset), w, h, ring.bytesPerLine(), format);
+    if (format == QImage::Format_Indexed8) {
+        image.setColorTable(ring.colorTable());
+    }
 
     return image;
 }
 
+/*!
+   Render the levels finer than level in the background
+
+   \sa renderProgressive(), setRefinementFunction()
+ */
+void PlotSpectrogram::refine(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
+                             const QSize &imageSize, int level) const
+{
+    PrivateData::Refinement &refinement = m_data->refinement;
+
+    while (level-- > 0) {
+        const QImage image = renderLevel(xMap, yMap, area, imageSize, level, true);
+
+        {
+            QMutexLocker locker(&refinement.mutex);
+            if (refinement.cancelled) {
+                return;
+            }
+
+            refinement.image = image;
+            refinement.level = level;
+        }
+
+        if (m_data->refinementFunction) {
+            m_data->refinementFunction(level);
+        }
+    }
+}
+
+/*!
+   \return true, when the background refinement is running
+ */
+bool PlotSpectrogram::isRefining() const
+{
+    return m_data->refinement.future.isRunning();
+}
+
+/*!
+   Cancel the background refinement, when it is running. Unlike
+   cancelRefinement() the image of a finished refinement is kept,
+   so that the next renderImage() still picks it up.
+ */
+void PlotSpectrogram::stopRefinement() const
+{
+    if (isRefining()) {
+        cancelRefinement();
+    }
+}
+
+/*!
+   Cancel the background refinement and wait until it has stopped
+
+   \sa renderProgressive(), waitForRefinement()
+ */
+void PlotSpectrogram::cancelRefinement() const
+{
+    PrivateData::Refinement &refinement = m_data->refinement;
+
+    {
+        QMutexLocker locker(&refinement.mutex);
+        refinement.cancelled = true;
+        refinement.image = QImage();
+    }
+
+    refinement.future.waitForFinished();
+}
+
+/*!
+   \brief Prepare rendering the image in tiles
+
+   A running background refinement is cancelled, as the raster
+   of the data is initialized for the area.
+
+   \param area Area of the image in scale coordinates
+   \param imageSize Size of the image
+
+   \return false, when there is nothing to render
+   \sa renderTile(), endTiles(), RasterCompositor
+ */
+bool PlotSpectrogram::beginTiles(const QRectF &area, const QSize &imageSize) const
+{
+    if (imageSize.isEmpty() || (m_data->data == NULL) || (m_data->colorMap == NULL)) {
+        return false;
+    }
+
+    if (!m_data->data->interval(Qt::ZAxis).isValid()) {
+        return false;
+    }
+
+    cancelRefinement();
+
+    m_data->data->initRaster(area, imageSize);
+    return true;
+}
+
+/*!
+   \param size Size of the tile
+   \return A QImage::Format_Indexed8 or QImage::Format_ARGB32 depending
+           on the color map
+ */
+QImage PlotSpectrogram::tileImage(const QSize &size) const
+{
+    if (m_data->colorMap->format() == ColorMap::RGB) {
+        return QImage(size, QImage::Format_ARGB32);
+    }
+
+    QImage image(size, QImage::Format_Indexed8);
+    image.setColorTable(m_data->colorMap->colorTable256());
+
+    return image;
+}
+
+/*!
+   \brief Release the raster of beginTiles()
+   \sa beginTiles()
+ */
+void PlotSpectrogram::endTiles() const
+{
+    m_data->data->discardRaster();
+}
+
 /*!
     \brief Render a tile of an image.
 
     Rendering in tiles can be used to composite an image in parallel
-    threads.
+    threads. The values of each row are requested with a single
+    call of RasterData::values().
 
     \param xMap X-Scale Map
     \param yMap Y-Scale Map
@@ -532,51 +1266,87 @@ void PlotSpectrogram::renderTile(const ScaleMap &xMap, const ScaleMap &yMap, con
         return;
     }
 
-    const bool hasGaps = !m_data->data->testAttribute(RasterData::WithoutGaps);
+    // the maps are linear: a row of pixels is a row of equidistant positions
+    const double tx0 = xMap.invTransform(tile.left());
+    const double dtx = xMap.invTransform(tile.left() + 1) - tx0;
 
-    if (m_data->colorMap->format() == ColorMap::RGB) {
+    const QRectF tileArea = QRectF(QPointF(tx0, yMap.invTransform(tile.top())),
+                                   QPointF(xMap.invTransform(tile.right()), yMap.invTransform(tile.bottom())))
+                                .normalized();
+
+    const RasterData::Validity validity = m_data->data->validity(tileArea);
+
+    if (validity == RasterData::NoneValid) {
+        // nothing to resample: the tile is transparent
+
+        const int numBytes = tile.width() * image->depth() / 8;
+        for (int y = tile.top(); y <= tile.bottom(); y++) {
+            memset(image->scanLine(y) + tile.left() * image->depth() / 8, 0, numBytes);
+        }
+
+        return;
+    }
+
+    const bool hasGaps = (validity != RasterData::AllValid);
+
+    const int numValues = tile.width();
+    QVector<double> values(numValues);
+
+    // the colors of a row are mapped in one pass, gaps are patched afterwards
+    QVector<uint> indexes(numValues);
+
+    const ColorMap *colorMap = m_data->colorMap;
+
+    if (colorMap->format() == ColorMap::RGB) {
         const int numColors = m_data->colorTable.size();
         const QRgb *rgbTable = m_data->colorTable.constData();
-        const ColorMap *colorMap = m_data->colorMap;
 
         for (int y = tile.top(); y <= tile.bottom(); y++) {
             const double ty = yMap.invTransform(y);
 
+            m_data->data->values(tx0, dtx, ty, numValues, values.data());
+
             QRgb *line = reinterpret_cast<QRgb *>(image->scanLine(y));
             line += tile.left();
 
-            for (int x = tile.left(); x <= tile.right(); x++) {
-                const double tx = xMap.invTransform(x);
+            if (numColors == 0) {
+                colorMap->rgbValues(range, values.constData(), numValues, line);
+            } else {
+                colorMap->colorIndexes(numColors, range, values.constData(), numValues, indexes.data());
 
-                const double value = m_data->data->value(tx, ty);
+                for (int x = 0; x < numValues; x++) {
+                    line[x] = rgbTable[indexes[x]];
+                }
+            }
 
-                if (hasGaps && qwtIsNaN(value)) {
-                    *line++ = 0u;
-                } else if (numColors == 0) {
-                    *line++ = colorMap->rgb(range, value);
-                } else {
-                    const uint index = colorMap->colorIndex(numColors, range, value);
-                    *line++ = rgbTable[index];
+            if (hasGaps) {
+                for (int x = 0; x < numValues; x++) {
+                    if (qwtIsNaN(values[x])) {
+                        line[x] = 0u;
+                    }
                 }
             }
         }
-    } else if (m_data->colorMap->format() == ColorMap::Indexed) {
+    } else if (colorMap->format() == ColorMap::Indexed) {
         for (int y = tile.top(); y <= tile.bottom(); y++) {
             const double ty = yMap.invTransform(y);
 
+            m_data->data->values(tx0, dtx, ty, numValues, values.data());
+
             unsigned char *line = image->scanLine(y);
             line += tile.left();
 
-            for (int x = tile.left(); x <= tile.right(); x++) {
-                const double tx = xMap.invTransform(x);
+            colorMap->colorIndexes(256, range, values.constData(), numValues, indexes.data());
 
-                const double value = m_data->data->value(tx, ty);
+            for (int x = 0; x < numValues; x++) {
+                line[x] = static_cast<unsigned char>(indexes[x]);
+            }
 
-                if (hasGaps && qwtIsNaN(value)) {
-                    *line++ = 0;
-                } else {
-                    const uint index = m_data->colorMap->colorIndex(256, range, value);
-                    *line++ = static_cast<unsigned char>(index);
+            if (hasGaps) {
+                for (int x = 0; x < numValues; x++) {
+                    if (qwtIsNaN(values[x])) {
+                        line[x] = 0;
+                    }
                 }
             }
         }
@@ -620,16 +1390,187 @@ QSize PlotSpectrogram::contourRasterSize(const QRectF &area, const QRect &rect)
    \param raster Raster, used by the CONREC algorithm
    \return Calculated contour lines
 
+   When the data tracks its modifications ( RasterData::revision() )
+   the lines are cached in bands of rows. As long as area, raster, levels
+   and flags are unchanged only the bands intersecting
+   RasterData::changedArea() are recalculated.
+
+   The data is only accessed, when lines have to be recalculated. Then a
+   running refinement is cancelled, as it uses the raster state of the data
+   ( RasterData::initRaster() ) concurrently.
+
    \sa contourLevels(), setConrecFlag(),
        RasterData::contourLines()
  */
 RasterData::ContourLines PlotSpectrogram::renderContourLines(const QRectF &rect, const QSize &raster) const
 {
-    if (m_data->data == NULL) {
+    const RasterData *data = m_data->data;
+    if (data == NULL) {
         return RasterData::ContourLines();
     }
 
-    return m_data->data->contourLines(rect, raster, m_data->contourLevels, m_data->conrecFlags);
+    PrivateData::ContourCache &cache = m_data->contourCache;
+
+    const int revision = data->revision();
+    const int numCellRows = raster.height() - 1;
+
+    const bool isSameRaster = (cache.rect == rect) && (cache.raster == raster)
+        && (cache.levels == m_data->contourLevels) && (cache.flags == m_data->conrecFlags);
+
+    if ((revision < 0) || (numCellRows <= 0)) {
+        if (cache.untracked && isSameRaster && isRefining()) {
+            return cache.bands.value(0);
+        }
+
+        stopRefinement();
+
+        const RasterData::ContourLines lines =
+            data->contourLines(rect, raster, m_data->contourLevels, m_data->conrecFlags);
+
+        cache.rect = rect;
+        cache.raster = raster;
+        cache.levels = m_data->contourLevels;
+        cache.flags = m_data->conrecFlags;
+        cache.revision = -1;
+        cache.untracked = true;
+        cache.bands = QVector<RasterData::ContourLines>() << lines;
+
+        return lines;
+    }
+
+    const int numBands = (numCellRows + qwtContourCacheRows - 1) / qwtContourCacheRows;
+    const double dy = rect.height() / raster.height();
+
+    const bool isValid = (cache.revision >= 0) && !cache.untracked && isSameRaster;
+
+    QVector<bool> isDirty(numBands, !isValid);
+
+    if (isValid) {
+        const QRectF area = data->changedArea(cache.revision);
+        if (!area.isEmpty()) {
+            // rows of the raster, whose values might have changed
+            const int row1 = qCeil((area.top() - rect.top()) / dy);
+            const int row2 = qFloor((area.bottom() - rect.top()) / dy);
+
+            // and the cells above and below of them
+            const int first = qMax(row1 - 1, 0);
+            const int last = qMin(row2, numCellRows - 1);
+
+            for (int row = first; row <= last; row++) {
+                isDirty[row / qwtContourCacheRows] = true;
+            }
+        }
+    } else {
+        cache.rect = rect;
+        cache.raster = raster;
+        cache.levels = m_data->contourLevels;
+        cache.flags = m_data->conrecFlags;
+        cache.untracked = false;
+        cache.bands = QVector<RasterData::ContourLines>(numBands);
+    }
+
+    if (isDirty.contains(true)) {
+        stopRefinement();
+    }
+
+    // recalculate each sequence of dirty bands in one call
+
+    for (int b = 0; b < numBands;) {
+        if (!isDirty[b]) {
+            b++;
+            continue;
+        }
+
+        int e = b;
+        while ((e < numBands) && isDirty[e]) {
+            cache.bands[e++].clear();
+        }
+
+        const int firstRow = b * qwtContourCacheRows;
+        const int lastRow = qMin(e * qwtContourCacheRows, numCellRows);
+
+        const QRectF bandRect(rect.x(), rect.y() + firstRow * dy, rect.width(), (lastRow - firstRow + 1) * dy);
+        const QSize bandRaster(raster.width(), lastRow - firstRow + 1);
+
+        const RasterData::ContourLines lines =
+            data->contourLines(bandRect, bandRaster, m_data->contourLevels, m_data->conrecFlags);
+
+        // each segment lies inside of a cell: its center identifies the band
+
+        for (RasterData::ContourLines::const_iterator it = lines.constBegin(); it != lines.constEnd(); ++it) {
+            const QPolygonF &segments = it.value();
+
+            for (int i = 0; i + 1 < segments.size(); i += 2) {
+                const double y = 0.5 * (segments[i].y() + segments[i + 1].y());
+                const int row = qBound(firstRow, int((y - rect.top()) / dy), lastRow - 1);
+
+                QPolygonF &bandLines = cache.bands[row / qwtContourCacheRows][it.key()];
+                bandLines += segments[i];
+                bandLines += segments[i + 1];
+            }
+        }
+
+        b = e;
+    }
+
+    cache.revision = revision;
+
+    RasterData::ContourLines contourLines;
+    for (int b = 0; b < numBands; b++) {
+        const RasterData::ContourLines &lines = cache.bands[b];
+        for (RasterData::ContourLines::const_iterator it = lines.constBegin(); it != lines.constEnd(); ++it) {
+            contourLines[it.key()] += it.value();
+        }
+    }
+
+    return contourLines;
+}
+
+/*!
+   Calculate connected contour lines
+
+   \param rect Rectangle, where to calculate the contour lines
+   \param raster Raster, used by the marching squares algorithm
+   \return Calculated contour lines
+
+   The lines are cached like the lines of renderContourLines(), but
+   recalculated completely, when the data has changed. Then a running
+   refinement is cancelled, as it uses the raster state of the data
+   ( RasterData::initRaster() ) concurrently.
+
+   \sa contourLevels(), setContourAlgorithm(),
+       RasterData::contourPolylines()
+ */
+RasterData::ContourPolylines PlotSpectrogram::renderContourPolylines(const QRectF &rect, const QSize &raster) const
+{
+    const RasterData *data = m_data->data;
+    if (data == NULL) {
+        return RasterData::ContourPolylines();
+    }
+
+    PrivateData::PolylineCache &cache = m_data->polylineCache;
+
+    const int revision = data->revision();
+
+    if (cache.isValid && (cache.rect == rect) && (cache.raster == raster)
+        && (cache.levels == m_data->contourLevels) && (cache.flags == m_data->conrecFlags)) {
+        const bool isUnchanged = (revision >= 0) ? (revision == cache.revision) : isRefining();
+        if (isUnchanged) {
+            return cache.polylines;
+        }
+    }
+
+    stopRefinement();
+
+    cache.polylines = data->contourPolylines(rect, raster, m_data->contourLevels, m_data->conrecFlags);
+    cache.rect = rect;
+    cache.raster = raster;
+    cache.levels = m_data->contourLevels;
+    cache.flags = m_data->conrecFlags;
+    cache.revision = revision;
+    cache.isValid = true;
+
+    return cache.polylines;
 }
 
 /*!
@@ -675,6 +1616,57 @@ void PlotSpectrogram::drawContourLines(QPainter *painter, const ScaleMap &xMap,
     }
 }
 
+/*!
+   Paint connected contour lines
+
+   \param painter Painter
+   \param xMap Maps x-values into pixel coordinates.
+   \param yMap Maps y-values into pixel coordinates.
+   \param contourLines Contour lines
+
+   \sa renderContourPolylines(), defaultContourPen(), contourPen()
+ */
+void PlotSpectrogram::drawContourPolylines(QPainter *painter, const ScaleMap &xMap, const ScaleMap &yMap,
+                                           const RasterData::ContourPolylines &contourLines) const
+{
+    if (m_data->data == NULL) {
+        return;
+    }
+
+    const int numLevels = m_data->contourLevels.size();
+    for (int l = 0; l < numLevels; l++) {
+        const double level = m_data->contourLevels[l];
+
+        RasterData::ContourPolylines::const_iterator it = contourLines.constFind(level);
+        if (it == contourLines.constEnd()) {
+            continue;
+        }
+
+        QPen pen = defaultContourPen();
+        if (pen.style() == Qt::NoPen) {
+            pen = contourPen(level);
+        }
+
+        if (pen.style() == Qt::NoPen) {
+            continue;
+        }
+
+        painter->setPen(pen);
+
+        const QVector<QPolygonF> &polylines = it.value();
+        for (int i = 0; i < polylines.size(); i++) {
+            const QPolygonF &polyline = polylines[i];
+
+            QPolygonF points(polyline.size());
+            for (int j = 0; j < polyline.size(); j++) {
+                points[j] = QPointF(xMap.transform(polyline[j].x()), yMap.transform(polyline[j].y()));
+            }
+
+            painter->drawPolyline(points);
+        }
+    }
+}
+
 /*!
    \brief Draw the spectrogram
 
@@ -689,34 +1681,104 @@ void PlotSpectrogram::drawContourLines(QPainter *painter, const ScaleMap &xMap,
 void PlotSpectrogram::draw(QPainter *painter, const ScaleMap &xMap, const ScaleMap &yMap,
                            const QRectF &canvasRect) const
 {
+    /*
+        The contour lines are calculated before the image is drawn:
+        in ProgressiveRender mode drawing the image starts a refinement,
+        that uses the raster state of the data in the background.
+     */
+
+    RasterData::ContourLines contourLines;
+    RasterData::ContourPolylines contourPolylines;
+
+    const bool hasContours = calculateContours(xMap, yMap, canvasRect, contourLines, contourPolylines);
+
     if (m_data->displayMode & ImageMode) {
         PlotRasterItemBase::draw(painter, xMap, yMap, canvasRect);
     }
 
-    if (m_data->displayMode & ContourMode) {
-        // Add some pixels at the borders
-        const int margin = 2;
-        QRectF rasterRect(canvasRect.x() - margin, canvasRect.y() - margin, canvasRect.width() + 2 * margin,
-                          canvasRect.height() + 2 * margin);
+    if (hasContours) {
+        drawContours(painter, xMap, yMap, contourLines, contourPolylines);
+    }
+}
 
-        QRectF area = ScaleMap::invTransform(xMap, yMap, rasterRect);
+/*!
+   \brief Draw the contour lines on top of a composed image
 
-        const QRectF br = boundingRect();
-        if (br.isValid()) {
-            area &= br;
-            if (area.isEmpty()) {
-                return;
-            }
+   A RasterCompositor composes the image of the spectrogram with the
+   images of other items and calls drawOverlay() afterwards. In ContourMode
+   the contour lines are drawn like in draw().
 
-            rasterRect = ScaleMap::transform(xMap, yMap, area);
-        }
+   \param painter Painter
+   \param xMap Maps x-values into pixel coordinates.
+   \param yMap Maps y-values into pixel coordinates.
+   \param canvasRect Contents rectangle of the canvas in painter coordinates
+
+   \sa RasterCompositor::draw()
+ */
+void PlotSpectrogram::drawOverlay(QPainter *painter, const ScaleMap &xMap, const ScaleMap &yMap,
+                                  const QRectF &canvasRect) const
+{
+    RasterData::ContourLines contourLines;
+    RasterData::ContourPolylines contourPolylines;
+
+    if (calculateContours(xMap, yMap, canvasRect, contourLines, contourPolylines)) {
+        drawContours(painter, xMap, yMap, contourLines, contourPolylines);
+    }
+}
+
+/*
+    Calculate the contour lines for the canvas in ContourMode, using
+    the algorithm of contourAlgorithm(). Returns false, when no lines
+    are visible.
+ */
+bool PlotSpectrogram::calculateContours(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &canvasRect,
+                                        RasterData::ContourLines &contourLines,
+                                        RasterData::ContourPolylines &contourPolylines) const
+{
+    if (!(m_data->displayMode & ContourMode)) {
+        return false;
+    }
 
-        QSize raster = contourRasterSize(area, rasterRect.toRect());
-        raster = raster.boundedTo(rasterRect.toRect().size());
-        if (raster.isValid()) {
-            const RasterData::ContourLines lines = renderContourLines(area, raster);
+    // Add some pixels at the borders
+    const int margin = 2;
+    QRectF rasterRect(canvasRect.x() - margin, canvasRect.y() - margin, canvasRect.width() + 2 * margin,
+                      canvasRect.height() + 2 * margin);
 
-            drawContourLines(painter, xMap, yMap, lines);
+    QRectF area = ScaleMap::invTransform(xMap, yMap, rasterRect);
+
+    const QRectF br = boundingRect();
+    if (br.isValid()) {
+        area &= br;
+        if (area.isEmpty()) {
+            return false;
         }
+
+        rasterRect = ScaleMap::transform(xMap, yMap, area);
+    }
+
+    QSize raster = contourRasterSize(area, rasterRect.toRect());
+    raster = raster.boundedTo(rasterRect.toRect().size());
+    if (!raster.isValid()) {
+        return false;
+    }
+
+    if (m_data->contourAlgorithm == RasterData::MarchingSquares) {
+        contourPolylines = renderContourPolylines(area, raster);
+    } else {
+        contourLines = renderContourLines(area, raster);
+    }
+
+    return true;
+}
+
+// Draw the result of calculateContours()
+void PlotSpectrogram::drawContours(QPainter *painter, const ScaleMap &xMap, const ScaleMap &yMap,
+                                   const RasterData::ContourLines &contourLines,
+                                   const RasterData::ContourPolylines &contourPolylines) const
+{
+    if (m_data->contourAlgorithm == RasterData::MarchingSquares) {
+        drawContourPolylines(painter, xMap, yMap, contourPolylines);
+    } else {
+        drawContourLines(painter, xMap, yMap, contourLines);
     }
 }
@@ -43,12 +43,55 @@ public:
 
     Q_DECLARE_FLAGS(DisplayModes, DisplayMode)
 
+    /*!
+       The render mode controls how the image is rendered.
+       \sa setRenderMode(), renderMode()
+     */
+    enum RenderMode
+    {
+        // ! renderImage() blocks until the image is rendered completely
+        DirectRender,
+
+        /*!
+           renderImage() returns a coarse image within the latency budget
+           and refines it in the background. The data must not be used
+           by the application, while a refinement is running.
+           \sa setRenderLatency(), setRefinementFunction(), cancelRefinement()
+         */
+        ProgressiveRender,
+
+        /*!
+           For data, that is scrolling along the y axis, like a waterfall.
+           The image of the previous renderImage() is kept in a ring buffer
+           and only the exposed rows and the rows of
+           RasterData::changedArea() are rendered.
+           \sa WaterfallRasterData
+         */
+        ScrollingRender
+    };
+
+    /*!
+       Function, that is called from the background refinement,
+       whenever a finer level is ready. 0 is the full resolution.
+     */
+    typedef std::function<void(int level)> RefinementFunction;
+
     explicit PlotSpectrogram(const QString &title = QString());
     virtual ~PlotSpectrogram();
 
     void setDisplayMode(DisplayMode, bool on = true);
     bool testDisplayMode(DisplayMode) const;
 
+    void setRenderMode(RenderMode);
+    RenderMode renderMode() const;
+
+    void setRenderLatency(int msecs);
+    int renderLatency() const;
+
+    void setRefinementFunction(const RefinementFunction &);
+    void waitForRefinement() const;
+    void cancelRefinement() const;
+
     void setData(RasterData *data);
     const RasterData *data() const;
     RasterData *data();
@@ -71,6 +114,9 @@ public:
     void setConrecFlag(RasterData::ConrecFlag, bool on);
     bool testConrecFlag(RasterData::ConrecFlag) const;
 
+    void setContourAlgorithm(RasterData::ContourAlgorithm);
+    RasterData::ContourAlgorithm contourAlgorithm() const;
+
     void setContourLevels(const QList<double> &);
     QList<double> contourLevels() const;
 
@@ -80,6 +126,11 @@ protected:
     virtual QImage renderImage(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
                                const QSize &imageSize) const override;
 
+    virtual bool isImageFinal() const override;
+
+    virtual void drawOverlay(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap,
+                             const QRectF &canvasRect) const override;
+
     virtual QSize contourRasterSize(const QRectF &, const QRect &) const;
 
     virtual RasterData::ContourLines renderContourLines(const QRectF &rect, const QSize &raster) const;
@@ -87,9 +138,34 @@ protected:
     virtual void drawContourLines(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap,
                                   const RasterData::ContourLines &) const;
 
-    void renderTile(const ScaleMap &xMap, const ScaleMap &yMap, const QRect &tile, QImage *) const;
+    virtual RasterData::ContourPolylines renderContourPolylines(const QRectF &rect, const QSize &raster) const;
+
+    virtual void drawContourPolylines(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap,
+                                      const RasterData::ContourPolylines &) const;
+
+    virtual bool beginTiles(const QRectF &area, const QSize &imageSize) const override;
+    virtual QImage tileImage(const QSize &) const override;
+    virtual void renderTile(const ScaleMap &xMap, const ScaleMap &yMap, const QRect &tile,
+                            QImage *) const override;
+    virtual void endTiles() const override;
 
 private:
+    QImage renderLevel(const ScaleMap &, const ScaleMap &, const QRectF &area, const QSize &imageSize, int level,
+                       bool background) const;
+
+    QImage renderProgressive(const ScaleMap &, const ScaleMap &, const QRectF &area, const QSize &imageSize) const;
+
+    QImage renderScrolling(const ScaleMap &, const ScaleMap &, const QRectF &area, const QSize &imageSize) const;
+
+    void refine(const ScaleMap &, const ScaleMap &, const QRectF &area, const QSize &imageSize, int level) const;
+    bool isRefining() const;
+    void stopRefinement() const;
+
+    bool calculateContours(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &canvasRect,
+                           RasterData::ContourLines &, RasterData::ContourPolylines &) const;
+    void drawContours(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap, const RasterData::ContourLines &,
+                      const RasterData::ContourPolylines &) const;
+
     class PrivateData;
     PrivateData *m_data;
 };
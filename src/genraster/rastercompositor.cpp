@@ -0,0 +1,403 @@
+﻿#include "rastercompositor.h"
+
+#include <string.h>
+
+#include <qmath.h>
+#include <qpainter.h>
+
+#include "interval.h"
+#include "plotrasteritembase.h"
+#include "simd.h"
+
+// An item, that takes part in a composition
+class QwtCompositorLayer
+{
+public:
+    const PlotRasterItemBase *item;
+
+    // true, when the item is rendered tile by tile
+    bool tiled;
+
+    // renderImage() of the items, that are not rendered in tiles
+    QImage image;
+
+    int alpha;
+    quint32 mask;
+
+    // the colors of an Indexed8 image including the alpha value
+    QVector<quint32> colorTable;
+};
+
+static ScaleMap qwtImageMap(const ScaleMap &map, double s1, double s2, int length)
+{
+    // the boundaries of the area are the centers of the first and last pixel
+
+    if (map.isInverting() && (s1 < s2)) {
+        qSwap(s1, s2);
+    }
+
+    ScaleMap newMap = map;
+    newMap.setPaintInterval(0.0, qMax(length - 1, 1));
+    newMap.setScaleInterval(s1, s2);
+
+    return newMap;
+}
+
+static QVector<quint32> qwtLayerColorTable(const QVector<QRgb> &colors, int alpha)
+{
+    QVector<quint32> table(256, (alpha >= 0) ? qRgba(0, 0, 0, alpha) : 0u);
+
+    for (int i = 0; i < qMin(colors.size(), 256); i++) {
+        table[i] = (alpha >= 0) ? ((colors[i] & 0x00ffffffu) | qRgba(0, 0, 0, alpha)) : colors[i];
+    }
+
+    return table;
+}
+
+/*
+    Blend a row of a layer over a row of the composed image. buffer is
+    used for the conversion, when the row is not ARGB32 with the alpha
+    value of the item.
+ */
+static void qwtBlendRow(const QwtCompositorLayer &layer, const uchar *from, int depth, quint32 *to, int count,
+                        quint32 *buffer)
+{
+    const QwtPixelKernels &kernels = qwtPixelKernels();
+
+    const quint32 *rgb = buffer;
+
+    if (depth == 8) {
+        kernels.mapIndexes(from, buffer, count, layer.colorTable.constData());
+    } else if (layer.alpha >= 0) {
+        kernels.setAlpha(reinterpret_cast<const quint32 *>(from), buffer, count, layer.mask);
+    } else {
+        rgb = reinterpret_cast<const quint32 *>(from);
+    }
+
+    kernels.blend(rgb, to, count);
+}
+
+class RasterCompositor::PrivateData
+{
+public:
+    PrivateData() : renderThreadCount(6) {}
+
+    QList<const PlotRasterItemBase *> items;
+
+    uint renderThreadCount;
+    QSize renderTileSize;
+
+    QVector<TileScheduler::TileTiming> tileTimings;
+};
+
+// ! Constructor
+RasterCompositor::RasterCompositor()
+{
+    m_data = new PrivateData();
+}
+
+// ! Destructor
+RasterCompositor::~RasterCompositor()
+{
+    delete m_data;
+}
+
+/*!
+   \brief Add an item on top of the stack
+
+   \param item Raster item, that is not owned by the compositor
+   \sa removeItem(), items()
+ */
+void RasterCompositor::addItem(const PlotRasterItemBase *item)
+{
+    if ((item != NULL) && !m_data->items.contains(item)) {
+        m_data->items += item;
+    }
+}
+
+/*!
+   \brief Remove an item from the stack
+
+   \param item Raster item
+   \sa addItem(), clearItems()
+ */
+void RasterCompositor::removeItem(const PlotRasterItemBase *item)
+{
+    m_data->items.removeAll(item);
+}
+
+/*!
+   Remove all items
+   \sa addItem()
+ */
+void RasterCompositor::clearItems()
+{
+    m_data->items.clear();
+}
+
+/*!
+   \return Stacked items, the first item is at the bottom
+   \sa addItem()
+ */
+QList<const PlotRasterItemBase *> RasterCompositor::items() const
+{
+    return m_data->items;
+}
+
+/*!
+   \brief Set the number of threads for composing the image
+
+   \param numThreads Number of threads, 0 means QThread::idealThreadCount()
+   \sa renderThreadCount(), PlotRasterItemBase::setRenderThreadCount()
+ */
+void RasterCompositor::setRenderThreadCount(uint numThreads)
+{
+    m_data->renderThreadCount = numThreads;
+}
+
+/*!
+   \return Number of threads for composing the image
+   \sa setRenderThreadCount()
+ */
+uint RasterCompositor::renderThreadCount() const
+{
+    return m_data->renderThreadCount;
+}
+
+/*!
+   \brief Set the size of the tiles
+
+   The buffers of a tile are allocated for each item, small tiles
+   keep them in the cache of the CPU.
+
+   \param size Maximum size of a tile, an invalid size means
+               TileScheduler::defaultTileSize()
+
+   \sa renderTileSize(), PlotRasterItemBase::setRenderTileSize()
+ */
+void RasterCompositor::setRenderTileSize(const QSize &size)
+{
+    m_data->renderTileSize = size;
+}
+
+/*!
+   \return Size of the tiles
+   \sa setRenderTileSize()
+ */
+QSize RasterCompositor::renderTileSize() const
+{
+    return m_data->renderTileSize;
+}
+
+/*!
+   \return Timings of the tiles, that have been processed for
+           composing the last image
+   \sa setRenderTileSize(), setRenderThreadCount()
+ */
+QVector<TileScheduler::TileTiming> RasterCompositor::renderTileTimings() const
+{
+    return m_data->tileTimings;
+}
+
+/*!
+   \brief Draw the composed items
+
+   The composed image is drawn first, then the overlays of the items
+   in the order of the stack.
+
+   \param painter Painter
+   \param xMap X-Scale Map
+   \param yMap Y-Scale Map
+   \param canvasRect Contents rectangle of the plot canvas
+
+   \sa renderImage(), PlotRasterItemBase::draw(), PlotRasterItemBase::drawOverlay()
+ */
+void RasterCompositor::draw(QPainter *painter, const ScaleMap &xMap, const ScaleMap &yMap,
+                            const QRectF &canvasRect) const
+{
+    if (canvasRect.isEmpty() || m_data->items.isEmpty()) {
+        return;
+    }
+
+    const QTransform &transform = painter->transform();
+
+    const QPointF p1 = transform.map(QPointF(xMap.p1(), yMap.p1()));
+    const QPointF p2 = transform.map(QPointF(xMap.p2(), yMap.p2()));
+
+    ScaleMap xxMap = xMap;
+    xxMap.setPaintInterval(p1.x(), p2.x());
+
+    ScaleMap yyMap = yMap;
+    yyMap.setPaintInterval(p1.y(), p2.y());
+
+    QRectF paintRect = transform.mapRect(canvasRect);
+    QRectF area = ScaleMap::invTransform(xxMap, yyMap, paintRect);
+
+    // the part of the canvas, that is covered by any of the items
+
+    QRectF br;
+    for (int i = 0; i < m_data->items.size(); i++) {
+        const QRectF r = m_data->items[i]->boundingRect();
+        if (!r.isValid()) {
+            br = QRectF();
+            break;
+        }
+
+        br = br.isValid() ? (br | r) : r;
+    }
+
+    if (br.isValid() && !br.contains(area)) {
+        area &= br;
+        if (!area.isValid()) {
+            return;
+        }
+
+        paintRect = ScaleMap::transform(xxMap, yyMap, area);
+    }
+
+    paintRect = QRectF(QPointF(qRound(paintRect.left()), qRound(paintRect.top())),
+                       QPointF(qRound(paintRect.right()), qRound(paintRect.bottom())));
+
+    const QSize imageSize = paintRect.size().toSize();
+    if (imageSize.isEmpty()) {
+        return;
+    }
+
+    const QImage image = renderImage(xxMap, yyMap, area, imageSize);
+    if (!image.isNull()) {
+        painter->save();
+        painter->setWorldTransform(QTransform());
+        painter->drawImage(paintRect.toAlignedRect(), image);
+        painter->restore();
+    }
+
+    for (int i = 0; i < m_data->items.size(); i++) {
+        m_data->items[i]->drawOverlay(painter, xMap, yMap, canvasRect);
+    }
+}
+
+/*!
+   \brief Render the composed image of all items
+
+   The image is divided into tiles of renderTileSize(). For each tile
+   the items are rendered bottom up into a buffer of the tile size and
+   blended with the tile of the composed image.
+
+   \param xMap X-Scale Map of the paint device
+   \param yMap Y-Scale Map of the paint device
+   \param area Requested area for the image in scale coordinates
+   \param imageSize Size of the image
+
+   \return Image of QImage::Format_ARGB32_Premultiplied
+ */
+QImage RasterCompositor::renderImage(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
+                                     const QSize &imageSize) const
+{
+    m_data->tileTimings.clear();
+
+    if (area.isEmpty() || imageSize.isEmpty()) {
+        return QImage();
+    }
+
+    const ScaleMap xxMap = qwtImageMap(xMap, area.left(), area.right(), imageSize.width());
+    const ScaleMap yyMap = qwtImageMap(yMap, area.top(), area.bottom(), imageSize.height());
+
+    QVector<QwtCompositorLayer> layers;
+
+    for (int i = 0; i < m_data->items.size(); i++) {
+        const PlotRasterItemBase *item = m_data->items[i];
+        if (item->alpha() == 0) {
+            continue;
+        }
+
+        QwtCompositorLayer layer;
+        layer.item = item;
+        layer.alpha = item->alpha();
+        layer.mask = qRgba(0, 0, 0, qMax(layer.alpha, 0));
+        layer.tiled = item->beginTiles(area, imageSize);
+
+        QVector<QRgb> colors;
+
+        if (layer.tiled) {
+            const QImage image = item->tileImage(QSize(1, 1));
+            if ((image.depth() != 8) && (image.depth() != 32)) {
+                item->endTiles();
+                continue;
+            }
+
+            colors = image.colorTable();
+        } else {
+            layer.image = item->renderImage(xxMap, yyMap, area, imageSize);
+            if ((layer.image.size() != imageSize) || ((layer.image.depth() != 8) && (layer.image.depth() != 32))) {
+                continue;
+            }
+
+            colors = layer.image.colorTable();
+        }
+
+        layer.colorTable = qwtLayerColorTable(colors, layer.alpha);
+        layers += layer;
+    }
+
+    if (layers.isEmpty()) {
+        return QImage();
+    }
+
+    QImage image(imageSize, QImage::Format_ARGB32_Premultiplied);
+
+    // scanLine() of a shared image would detach, what is not thread safe
+    uchar *bits = image.bits();
+    const int bytesPerLine = image.bytesPerLine();
+
+    const auto composeTile = [&](const QRect &tile) {
+        const int numPixels = tile.width();
+
+        QVector<quint32> buffer(numPixels);
+
+        for (int y = tile.top(); y <= tile.bottom(); y++) {
+            memset(bits + qint64(y) * bytesPerLine + tile.left() * 4, 0, numPixels * 4);
+        }
+
+        for (int i = 0; i < layers.size(); i++) {
+            const QwtCompositorLayer &layer = layers[i];
+
+            if (layer.tiled) {
+                ScaleMap sxMap = xxMap;
+                sxMap.setPaintInterval(xxMap.p1() - tile.left(), xxMap.p2() - tile.left());
+
+                ScaleMap syMap = yyMap;
+                syMap.setPaintInterval(yyMap.p1() - tile.top(), yyMap.p2() - tile.top());
+
+                QImage tileImage = layer.item->tileImage(tile.size());
+                layer.item->renderTile(sxMap, syMap, QRect(QPoint(0, 0), tile.size()), &tileImage);
+
+                for (int y = 0; y < tile.height(); y++) {
+                    quint32 *to =
+                        reinterpret_cast<quint32 *>(bits + qint64(tile.top() + y) * bytesPerLine) + tile.left();
+
+                    qwtBlendRow(layer, tileImage.constScanLine(y), tileImage.depth(), to, numPixels, buffer.data());
+                }
+            } else {
+                const QImage &from = layer.image;
+                const int offset = tile.left() * from.depth() / 8;
+
+                for (int y = tile.top(); y <= tile.bottom(); y++) {
+                    quint32 *to = reinterpret_cast<quint32 *>(bits + qint64(y) * bytesPerLine) + tile.left();
+
+                    qwtBlendRow(layer, from.constScanLine(y) + offset, from.depth(), to, numPixels, buffer.data());
+                }
+            }
+        }
+    };
+
+    m_data->tileTimings = TileScheduler::instance()->run(imageSize, m_data->renderTileSize,
+                                                         m_data->renderThreadCount, composeTile);
+
+    for (int i = 0; i < layers.size(); i++) {
+        if (layers[i].tiled) {
+            layers[i].item->endTiles();
+        }
+    }
+
+    return image;
+}
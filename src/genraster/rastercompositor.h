@@ -0,0 +1,68 @@
+﻿#ifndef RASTER_COMPOSITOR_H
+#define RASTER_COMPOSITOR_H
+
+#include <QImage>
+#include <QList>
+
+#include "scalemap.h"
+#include "tilescheduler.h"
+
+class PlotRasterItemBase;
+class QPainter;
+
+/*!
+   \brief Composes stacked raster items in a single tiled pass
+
+   Drawing several raster items on top of each other renders a complete
+   image for each item, converts it for its alpha value and blends it
+   with QPainter. RasterCompositor renders the tiles of all items into
+   small buffers and blends them right away, so that only the composed
+   image is allocated and painted.
+
+   Items implementing PlotRasterItemBase::beginTiles() are rendered tile
+   by tile, all others are composed from their PlotRasterItemBase::renderImage().
+   The image is rendered in paint device resolution, the render modes and
+   the paint caches of the items are not used.
+
+   draw() paints the overlays of the items ( PlotRasterItemBase::drawOverlay() )
+   on top of the composed image, like the contour lines of a PlotSpectrogram
+   in ContourMode. So they are above the images of all items, and they are
+   not part of renderImage().
+
+   The items are not owned by the compositor and are stacked in the order
+   of addItem(): the first item is at the bottom.
+
+   \sa PlotRasterItemBase::setAlpha()
+ */
+class RasterCompositor
+{
+public:
+    RasterCompositor();
+    virtual ~RasterCompositor();
+
+    void addItem(const PlotRasterItemBase *);
+    void removeItem(const PlotRasterItemBase *);
+    void clearItems();
+    QList<const PlotRasterItemBase *> items() const;
+
+    void setRenderThreadCount(uint numThreads);
+    uint renderThreadCount() const;
+
+    void setRenderTileSize(const QSize &);
+    QSize renderTileSize() const;
+
+    QVector<TileScheduler::TileTiming> renderTileTimings() const;
+
+    virtual void draw(QPainter *, const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &canvasRect) const;
+
+    QImage renderImage(const ScaleMap &xMap, const ScaleMap &yMap, const QRectF &area,
+                       const QSize &imageSize) const;
+
+private:
+    Q_DISABLE_COPY(RasterCompositor)
+
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+#endif
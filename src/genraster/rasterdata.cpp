@@ -1,15 +1,23 @@
 ﻿#include "rasterdata.h"
 
+#include <QHash>
 #include <QList>
 #include <QMap>
+#include <QPair>
 #include <QPolygon>
 #include <QRect>
 #include <QVector>
 
 #include <qnumeric.h>
 
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
 #include "interval.h"
+#include "matrixresampler.h"
 #include "point3d.h"
+#include "tilescheduler.h"
 
 class RasterData::ContourPlane
 {
@@ -254,6 +262,259 @@ QRectF RasterData::pixelHint(const QRectF &area) const
     return QRectF();
 }
 
+/*!
+   \brief Values of a scanline
+
+   Fill values with the values at the positions ( x + i * dx, y )
+   for i in [0, numValues[. Rendering an image calls values()
+   once per row instead of calling value() for every pixel.
+
+   The default implementation calls value() for each position, but
+   derived classes can reimplement it to avoid the overhead of
+   a virtual call and of looking up the intervals for every value.
+
+   \param x X value of the first position in plot coordinates
+   \param dx Distance between 2 positions in plot coordinates
+   \param y Y value in plot coordinates
+   \param numValues Number of values
+   \param values Array of at least numValues doubles
+
+   \sa value()
+ */
+void RasterData::values(double x, double dx, double y, int numValues, double *values) const
+{
+    for (int i = 0; i < numValues; i++) {
+        values[i] = value(x + i * dx, y);
+    }
+}
+
+/*!
+   \brief Validity of the values in an area
+
+   Rendering and contouring skip areas, where all values are NaN, and
+   don't check for NaN values in areas, where all values are valid.
+
+   The default implementation returns AllValid, when WithoutGaps is
+   enabled, otherwise PartiallyValid.
+
+   \param area Area in plot coordinates, including its borders
+   \return Validity of the values at any position in area
+
+   \sa Attribute, values()
+ */
+RasterData::Validity RasterData::validity(const QRectF &area) const
+{
+    Q_UNUSED(area);
+    return testAttribute(WithoutGaps) ? AllValid : PartiallyValid;
+}
+
+/*!
+   \brief Revision of the data
+
+   A revision, that is increased whenever the data changes, allows
+   to update results, that have been calculated from the data,
+   incrementally ( see changedArea() ).
+
+   The default implementation returns -1, indicating that changes
+   are not tracked.
+
+   \return Revision of the data, or -1
+   \sa changedArea()
+ */
+int RasterData::revision() const
+{
+    return -1;
+}
+
+/*!
+   \brief Area, where values have changed
+
+   The default implementation returns the bounding rectangle
+   of the X and Y intervals.
+
+   \param revision Revision, that has been returned by revision() before
+   \return Area, where values might be different from those at revision.
+           An empty rectangle indicates, that nothing has changed.
+
+   \sa revision()
+ */
+QRectF RasterData::changedArea(int revision) const
+{
+    Q_UNUSED(revision);
+
+    const Interval xInterval = interval(Qt::XAxis);
+    const Interval yInterval = interval(Qt::YAxis);
+
+    return QRectF(xInterval.minValue(), yInterval.minValue(), xInterval.width(), yInterval.width());
+}
+
+// number of cell rows, that are contoured as one task
+static const int qwtContourBandHeight = 16;
+
+// number of cell columns, whose validity is checked at once
+static const int qwtContourChunkWidth = 64;
+
+/*
+    Ranges of raster columns [first, last] of the rows [firstRow, lastRow],
+    that are not NaN only. Chunks of columns, that are NoneValid
+    ( see RasterData::validity() ), are left out.
+ */
+static QVector<QPair<int, int>> qwtValidColumns(const RasterData *data, const QRectF &rect, const QSize &raster,
+                                                int firstRow, int lastRow)
+{
+    const double dx = rect.width() / raster.width();
+    const double dy = rect.height() / raster.height();
+
+    const double y1 = rect.y() + firstRow * dy;
+    const double y2 = rect.y() + lastRow * dy;
+
+    QVector<QPair<int, int>> ranges;
+
+    const int lastColumn = raster.width() - 1;
+    for (int first = 0; first < lastColumn; first += qwtContourChunkWidth) {
+        const int last = qMin(first + qwtContourChunkWidth, lastColumn);
+
+        const QRectF area(QPointF(rect.x() + first * dx, y1), QPointF(rect.x() + last * dx, y2));
+        if (data->validity(area) == RasterData::NoneValid) {
+            continue;
+        }
+
+        if (!ranges.isEmpty() && (ranges.last().second == first)) {
+            ranges.last().second = last;
+        } else {
+            ranges += qMakePair(first, last);
+        }
+    }
+
+    return ranges;
+}
+
+/*
+    CONREC for the cells of the rows [firstRow, lastRow). Each row of the
+    raster is sampled once, the segments are appended to lines, that
+    has one polygon for each of the sorted levels. Columns, where all
+    values of the band are NaN, are neither sampled nor contoured.
+ */
+static void qwtContourBand(const RasterData *data, const QRectF &rect, const QSize &raster, int firstRow, int lastRow,
+                           const QVector<double> &levels, bool ignoreOnPlane, const Interval &range,
+                           bool ignoreOutOfRange, QVector<QPolygonF> &lines)
+{
+    enum Position
+    {
+        Center,
+
+        TopLeft,
+        TopRight,
+        BottomRight,
+        BottomLeft,
+
+        NumPositions
+    };
+
+    const double dx = rect.width() / raster.width();
+    const double dy = rect.height() / raster.height();
+
+    const QVector<QPair<int, int>> ranges = qwtValidColumns(data, rect, raster, firstRow, lastRow);
+    if (ranges.isEmpty()) {
+        return;
+    }
+
+    const int numValues = raster.width();
+
+    // values outside of the ranges are never sampled
+    QVector<double> top(numValues, qQNaN());
+    QVector<double> bottom(numValues, qQNaN());
+
+    const auto sampleRow = [&](double y, double *values) {
+        for (int i = 0; i < ranges.size(); i++) {
+            const int first = ranges[i].first;
+            data->values(rect.x() + first * dx, dx, y, ranges[i].second - first + 1, values + first);
+        }
+    };
+
+    sampleRow(rect.y() + firstRow * dy, top.data());
+
+    const double *levelsBegin = levels.constData();
+    const double *levelsEnd = levelsBegin + levels.size();
+
+    for (int y = firstRow; y < lastRow; y++) {
+        const double y1 = rect.y() + y * dy;
+        const double y2 = rect.y() + (y + 1) * dy;
+
+        sampleRow(y2, bottom.data());
+
+        for (int r = 0; r < ranges.size(); r++) {
+            for (int x = ranges[r].first; x < ranges[r].second; x++) {
+                const double x1 = rect.x() + x * dx;
+                const double x2 = rect.x() + (x + 1) * dx;
+
+                Point3D xy[NumPositions];
+                xy[TopLeft] = Point3D(x1, y1, top[x]);
+                xy[TopRight] = Point3D(x2, y1, top[x + 1]);
+                xy[BottomRight] = Point3D(x2, y2, bottom[x + 1]);
+                xy[BottomLeft] = Point3D(x1, y2, bottom[x]);
+
+                double zMin = xy[TopLeft].z();
+                double zMax = zMin;
+                double zSum = zMin;
+
+                for (int i = TopRight; i <= BottomLeft; i++) {
+                    const double z = xy[i].z();
+
+                    zSum += z;
+                    if (z < zMin) {
+                        zMin = z;
+                    }
+                    if (z > zMax) {
+                        zMax = z;
+                    }
+                }
+
+                if (qIsNaN(zSum)) {
+                    // one of the points is NaN
+                    continue;
+                }
+
+                if (ignoreOutOfRange) {
+                    if (!range.contains(zMin) || !range.contains(zMax)) {
+                        continue;
+                    }
+                }
+
+                // the first level >= zMin
+                const double *level = std::lower_bound(levelsBegin, levelsEnd, zMin);
+                if ((level == levelsEnd) || (*level > zMax)) {
+                    continue;
+                }
+
+                xy[Center] = Point3D(x1 + 0.5 * dx, y1 + 0.5 * dy, 0.25 * zSum);
+
+                Point3D triangles[4][3];
+                for (int m = TopLeft; m < NumPositions; m++) {
+                    triangles[m - TopLeft][0] = xy[m];
+                    triangles[m - TopLeft][1] = xy[Center];
+                    triangles[m - TopLeft][2] = xy[m != BottomLeft ? m + 1 : TopLeft];
+                }
+
+                for (; (level != levelsEnd) && (*level <= zMax); ++level) {
+                    QPolygonF &polygon = lines[int(level - levelsBegin)];
+                    const RasterData::ContourPlane plane(*level);
+
+                    QPointF line[2];
+                    for (int m = 0; m < 4; m++) {
+                        if (plane.intersect(triangles[m], line, ignoreOnPlane)) {
+                            polygon += line[0];
+                            polygon += line[1];
+                        }
+                    }
+                }
+            }
+        }
+
+        top.swap(bottom);
+    }
+}
+
 /*!
    Calculate contour lines
 
@@ -266,6 +527,10 @@ QRectF RasterData::pixelHint(const QRectF &area) const
 
    An adaption of CONREC, a simple contouring algorithm.
    http://local.wasp.uwa.edu.au/~pbourke/papers/conrec/
+
+   The raster is split into bands of rows, that are contoured in parallel
+   by the TileScheduler. Each row is sampled once with values(),
+   so value() needs to be thread safe.
  */
 RasterData::ContourLines RasterData::contourLines(const QRectF &rect, const QSize &raster, const QList<double> &levels,
                                                   ConrecFlags flags) const
@@ -276,8 +541,12 @@ RasterData::ContourLines RasterData::contourLines(const QRectF &rect, const QSiz
         return contourLines;
     }
 
-    const double dx = rect.width() / raster.width();
-    const double dy = rect.height() / raster.height();
+    const int numCellColumns = raster.width() - 1;
+    const int numCellRows = raster.height() - 1;
+
+    if ((numCellColumns <= 0) || (numCellRows <= 0)) {
+        return contourLines;
+    }
 
     const bool ignoreOnPlane = flags & RasterData::IgnoreAllVerticesOnLevel;
 
@@ -287,113 +556,366 @@ RasterData::ContourLines RasterData::contourLines(const QRectF &rect, const QSiz
         ignoreOutOfRange = flags & IgnoreOutOfRange;
     }
 
+    // sorted once, so that a cell visits only the levels in [zMin, zMax]
+
+    QVector<double> sortedLevels = levels.toVector();
+    std::sort(sortedLevels.begin(), sortedLevels.end());
+    sortedLevels.erase(std::unique(sortedLevels.begin(), sortedLevels.end()), sortedLevels.end());
+
     RasterData *that = const_cast<RasterData *>(this);
     that->initRaster(rect, raster);
 
-    for (int y = 0; y < raster.height() - 1; y++) {
-        enum Position
-        {
-            Center,
-
-            TopLeft,
-            TopRight,
-            BottomRight,
-            BottomLeft,
+    const int numBands = (numCellRows + qwtContourBandHeight - 1) / qwtContourBandHeight;
+    QVector<QVector<QPolygonF>> bandLines(numBands);
 
-            NumPositions
-        };
+    TileScheduler::instance()->run(QSize(numCellColumns, numCellRows), QSize(numCellColumns, qwtContourBandHeight), 0,
+                                   [&](const QRect &band) {
+                                       QVector<QPolygonF> &lines = bandLines[band.top() / qwtContourBandHeight];
+                                       lines.resize(sortedLevels.size());
 
-        Point3D xy[NumPositions];
+                                       qwtContourBand(this, rect, raster, band.top(), band.bottom() + 1,
+                                                      sortedLevels, ignoreOnPlane, range, ignoreOutOfRange, lines);
+                                   });
 
-        for (int x = 0; x < raster.width() - 1; x++) {
-            const QPointF pos(rect.x() + x * dx, rect.y() + y * dy);
+    that->discardRaster();
 
-            if (x == 0) {
-                xy[TopRight].setX(pos.x());
-                xy[TopRight].setY(pos.y());
-                xy[TopRight].setZ(value(xy[TopRight].x(), xy[TopRight].y()));
+    // merging in the order of the bands keeps the result deterministic
 
-                xy[BottomRight].setX(pos.x());
-                xy[BottomRight].setY(pos.y() + dy);
-                xy[BottomRight].setZ(value(xy[BottomRight].x(), xy[BottomRight].y()));
+    for (int b = 0; b < numBands; b++) {
+        const QVector<QPolygonF> &lines = bandLines[b];
+        for (int l = 0; l < lines.size(); l++) {
+            if (!lines[l].isEmpty()) {
+                contourLines[sortedLevels[l]] += lines[l];
             }
+        }
+    }
+
+    return contourLines;
+}
+
+/*
+    Marching squares for one level on a grid of numColumns x numRows
+    values. The crossings of the level with the edges of the cells are
+    stitched into polylines by following the segments, that share an edge.
+ */
+class QwtMarchingSquares
+{
+public:
+    QwtMarchingSquares(const QVector<double> &grid, int numColumns, int numRows, const QRectF &rect, double dx,
+                       double dy) :
+        m_grid(grid), m_numColumns(numColumns), m_numRows(numRows), m_rect(rect), m_dx(dx), m_dy(dy)
+    {
+    }
+
+    QVector<QPolygonF> polylines(double level, const Interval &range, bool ignoreOutOfRange)
+    {
+        m_level = level;
+        m_edges.clear();
+        m_segments.clear();
+
+        for (int j = 0; j < m_numRows - 1; j++) {
+            const double *top = m_grid.constData() + j * m_numColumns;
+            const double *bottom = top + m_numColumns;
+
+            for (int i = 0; i < m_numColumns - 1; i++) {
+                const double a = top[i];
+                const double b = top[i + 1];
+                const double c = bottom[i + 1];
+                const double d = bottom[i];
+
+                const double sum = a + b + c + d;
+                if (qIsNaN(sum)) {
+                    continue;
+                }
 
-            xy[TopLeft] = xy[TopRight];
-            xy[BottomLeft] = xy[BottomRight];
+                if (ignoreOutOfRange) {
+                    if (!(range.contains(a) && range.contains(b) && range.contains(c) && range.contains(d))) {
+                        continue;
+                    }
+                }
+
+                const bool ua = (a >= level);
+                const bool ub = (b >= level);
+                const bool uc = (c >= level);
+                const bool ud = (d >= level);
+
+                if ((ua == ub) && (ub == uc) && (uc == ud)) {
+                    continue;
+                }
 
-            xy[TopRight].setX(pos.x() + dx);
-            xy[TopRight].setY(pos.y());
-            xy[BottomRight].setX(pos.x() + dx);
-            xy[BottomRight].setY(pos.y() + dy);
+                const int topEdge = horizontalEdge(i, j);
+                const int rightEdge = verticalEdge(i + 1, j);
+                const int bottomEdge = horizontalEdge(i, j + 1);
+                const int leftEdge = verticalEdge(i, j);
 
-            xy[TopRight].setZ(value(xy[TopRight].x(), xy[TopRight].y()));
-            xy[BottomRight].setZ(value(xy[BottomRight].x(), xy[BottomRight].y()));
+                if ((ua == uc) && (ub == ud)) {
+                    // saddle: resolved by the value in the center of the cell
+
+                    if ((0.25 * sum >= level) == ua) {
+                        addSegment(topEdge, rightEdge);
+                        addSegment(bottomEdge, leftEdge);
+                    } else {
+                        addSegment(topEdge, leftEdge);
+                        addSegment(rightEdge, bottomEdge);
+                    }
 
-            double zMin = xy[TopLeft].z();
-            double zMax = zMin;
-            double zSum = zMin;
+                    continue;
+                }
 
-            for (int i = TopRight; i <= BottomLeft; i++) {
-                const double z = xy[i].z();
+                int crossing[2];
+                int n = 0;
 
-                zSum += z;
-                if (z < zMin) {
-                    zMin = z;
+                if (ua != ub) {
+                    crossing[n++] = topEdge;
                 }
-                if (z > zMax) {
-                    zMax = z;
+                if (ub != uc) {
+                    crossing[n++] = rightEdge;
+                }
+                if (uc != ud) {
+                    crossing[n++] = bottomEdge;
+                }
+                if (ud != ua) {
+                    crossing[n++] = leftEdge;
                 }
-            }
 
-            if (qIsNaN(zSum)) {
-                // one of the points is NaN
-                continue;
+                addSegment(crossing[0], crossing[1]);
             }
+        }
 
-            if (ignoreOutOfRange) {
-                if (!range.contains(zMin) || !range.contains(zMax)) {
-                    continue;
-                }
+        return stitch();
+    }
+
+private:
+    struct Edge
+    {
+        QPointF point;
+        int segments[2];
+    };
+
+    struct Segment
+    {
+        int edges[2];
+        bool done;
+    };
+
+    inline int horizontalEdge(int i, int j) const { return 2 * (j * m_numColumns + i); }
+    inline int verticalEdge(int i, int j) const { return 2 * (j * m_numColumns + i) + 1; }
+
+    void addSegment(int edge1, int edge2)
+    {
+        const int index = m_segments.size();
+
+        Segment segment;
+        segment.edges[0] = edge1;
+        segment.edges[1] = edge2;
+        segment.done = false;
+
+        m_segments += segment;
+
+        linkEdge(edge1, index);
+        linkEdge(edge2, index);
+    }
+
+    void linkEdge(int edge, int segment)
+    {
+        QHash<int, Edge>::iterator it = m_edges.find(edge);
+        if (it == m_edges.end()) {
+            Edge e;
+            e.point = crossing(edge);
+            e.segments[0] = segment;
+            e.segments[1] = -1;
+
+            m_edges.insert(edge, e);
+        } else {
+            it.value().segments[1] = segment;
+        }
+    }
+
+    QPointF crossing(int edge) const
+    {
+        const int index = edge / 2;
+        const int i = index % m_numColumns;
+        const int j = index / m_numColumns;
+
+        const double z1 = m_grid[index];
+
+        if (edge & 1) {
+            const double z2 = m_grid[index + m_numColumns];
+            const double t = (m_level - z1) / (z2 - z1);
+
+            return QPointF(m_rect.x() + i * m_dx, m_rect.y() + (j + t) * m_dy);
+        }
+
+        const double z2 = m_grid[index + 1];
+        const double t = (m_level - z1) / (z2 - z1);
+
+        return QPointF(m_rect.x() + (i + t) * m_dx, m_rect.y() + j * m_dy);
+    }
+
+    // the other, not yet stitched segment at an edge
+    int nextSegment(int edge) const
+    {
+        const Edge &e = m_edges[edge];
+
+        for (int k = 0; k < 2; k++) {
+            const int s = e.segments[k];
+            if ((s >= 0) && !m_segments[s].done) {
+                return s;
             }
+        }
+
+        return -1;
+    }
+
+    // follow the segments starting at edge, appending their crossings
+    int follow(int edge, QPolygonF &points)
+    {
+        int s;
+        while ((s = nextSegment(edge)) >= 0) {
+            Segment &segment = m_segments[s];
+            segment.done = true;
+
+            edge = (segment.edges[0] == edge) ? segment.edges[1] : segment.edges[0];
+            points += m_edges[edge].point;
+        }
+
+        return edge;
+    }
+
+    QVector<QPolygonF> stitch()
+    {
+        QVector<QPolygonF> polylines;
 
-            if ((zMax < levels[0]) || (zMin > levels[levels.size() - 1])) {
+        for (int s = 0; s < m_segments.size(); s++) {
+            Segment &segment = m_segments[s];
+            if (segment.done) {
                 continue;
             }
 
-            xy[Center].setX(pos.x() + 0.5 * dx);
-            xy[Center].setY(pos.y() + 0.5 * dy);
-            xy[Center].setZ(0.25 * zSum);
+            segment.done = true;
 
-            const int numLevels = levels.size();
-            for (int l = 0; l < numLevels; l++) {
-                const double level = levels[l];
-                if ((level < zMin) || (level > zMax)) {
-                    continue;
-                }
-                QPolygonF &lines = contourLines[level];
-                const ContourPlane plane(level);
+            const int start = segment.edges[0];
 
-                QPointF line[2];
-                Point3D vertex[3];
+            QPolygonF forward;
+            forward += m_edges[start].point;
+            forward += m_edges[segment.edges[1]].point;
 
-                for (int m = TopLeft; m < NumPositions; m++) {
-                    vertex[0] = xy[m];
-                    vertex[1] = xy[0];
-                    vertex[2] = xy[m != BottomLeft ? m + 1 : TopLeft];
-
-                    const bool intersects = plane.intersect(vertex, line, ignoreOnPlane);
-                    if (intersects) {
-                        lines += line[0];
-                        lines += line[1];
-                    }
+            const int end = follow(segment.edges[1], forward);
+
+            if (end != start) {
+                // an open line: continue in the opposite direction
+
+                QPolygonF backward;
+                follow(start, backward);
+
+                if (!backward.isEmpty()) {
+                    std::reverse(backward.begin(), backward.end());
+                    backward += forward;
+                    forward.swap(backward);
                 }
             }
+
+            polylines += forward;
         }
+
+        return polylines;
+    }
+
+    const QVector<double> &m_grid;
+    const int m_numColumns;
+    const int m_numRows;
+
+    const QRectF m_rect;
+    const double m_dx;
+    const double m_dy;
+
+    double m_level;
+
+    QHash<int, Edge> m_edges;
+    QVector<Segment> m_segments;
+};
+
+/*!
+   Calculate connected contour lines
+
+   The default implementation samples the raster once and runs
+   marching squares for each level. Saddle cells are resolved
+   by the value in the center of the cell. The crossings of
+   a level are stitched into polylines, closed lines end with their
+   first point.
+
+   The levels are processed in parallel by the TileScheduler.
+
+   \param rect Bounding rectangle for the contour lines
+   \param raster Number of data pixels of the raster data
+   \param levels List of limits, where to insert contour lines
+   \param flags Flags to customize the contouring algorithm,
+                IgnoreAllVerticesOnLevel has no effect
+
+   \return Calculated contour lines
+   \sa contourLines(), ContourAlgorithm
+ */
+RasterData::ContourPolylines RasterData::contourPolylines(const QRectF &rect, const QSize &raster,
+                                                          const QList<double> &levels, ConrecFlags flags) const
+{
+    ContourPolylines polylines;
+
+    if ((levels.size() == 0) || !rect.isValid() || (raster.width() < 2) || (raster.height() < 2)) {
+        return polylines;
+    }
+
+    const Interval range = interval(Qt::ZAxis);
+    bool ignoreOutOfRange = false;
+    if (range.isValid()) {
+        ignoreOutOfRange = flags & IgnoreOutOfRange;
     }
 
+    QVector<double> sortedLevels = levels.toVector();
+    std::sort(sortedLevels.begin(), sortedLevels.end());
+    sortedLevels.erase(std::unique(sortedLevels.begin(), sortedLevels.end()), sortedLevels.end());
+
+    const double dx = rect.width() / raster.width();
+    const double dy = rect.height() / raster.height();
+
+    const int numColumns = raster.width();
+    const int numRows = raster.height();
+
+    RasterData *that = const_cast<RasterData *>(this);
+    that->initRaster(rect, raster);
+
+    // values, that are not sampled, are NaN
+    QVector<double> grid(numColumns * numRows, qQNaN());
+
+    TileScheduler::instance()->run(raster, QSize(numColumns, qwtContourBandHeight), 0, [&](const QRect &band) {
+        const QVector<QPair<int, int>> ranges = qwtValidColumns(this, rect, raster, band.top(), band.bottom());
+
+        for (int j = band.top(); j <= band.bottom(); j++) {
+            double *row = grid.data() + j * numColumns;
+
+            for (int i = 0; i < ranges.size(); i++) {
+                const int first = ranges[i].first;
+                values(rect.x() + first * dx, dx, rect.y() + j * dy, ranges[i].second - first + 1, row + first);
+            }
+        }
+    });
+
     that->discardRaster();
 
-    return contourLines;
+    QVector<QVector<QPolygonF>> levelLines(sortedLevels.size());
+
+    // one task for each level
+    TileScheduler::instance()->run(QSize(sortedLevels.size(), 1), QSize(1, 1), 0, [&](const QRect &tile) {
+        QwtMarchingSquares marchingSquares(grid, numColumns, numRows, rect, dx, dy);
+        levelLines[tile.left()] = marchingSquares.polylines(sortedLevels[tile.left()], range, ignoreOutOfRange);
+    });
+
+    for (int l = 0; l < sortedLevels.size(); l++) {
+        if (!levelLines[l].isEmpty()) {
+            polylines.insert(sortedLevels[l], levelLines[l]);
+        }
+    }
+
+    return polylines;
 }
 
 /// QwtMatrixRasterData
@@ -424,15 +946,188 @@ static inline double qwtBicubicInterpolate(double v00, double v10, double v20, d
     return qwtHermiteInterpolate(v0, v1, v2, v3, dy);
 }
 
-class QwtMatrixRasterData::PrivateData
+/*
+    Levels of 2x2 reductions of a value matrix. Each cell of a level
+    stores minimum, maximum and mean of the valid ( not NaN ) values
+    it covers, and their number, so that the mean of the next level
+    is weighted correctly.
+ */
+class QwtMatrixPyramid
 {
 public:
-    PrivateData() : resampleMode(QwtMatrixRasterData::NearestNeighbour), numColumns(0) {}
+    struct Level
+    {
+        int numColumns;
+        int numRows;
 
-    inline double value(int row, int col) const { return values.data()[row * numColumns + col]; }
+        QVector<double> minimum;
+        QVector<double> maximum;
+        QVector<double> mean;
+        QVector<int> count;
+    };
 
-    Interval intervals[3];
+    void build(const double *values, int numColumns, int numRows)
+    {
+        levels.clear();
+
+        int cols = numColumns;
+        int rows = numRows;
+
+        while ((cols > 1) || (rows > 1)) {
+            cols = (cols + 1) / 2;
+            rows = (rows + 1) / 2;
+
+            Level level;
+            level.numColumns = cols;
+            level.numRows = rows;
+            level.minimum.resize(cols * rows);
+            level.maximum.resize(cols * rows);
+            level.mean.resize(cols * rows);
+            level.count.resize(cols * rows);
+
+            levels += level;
+
+            const int l = levels.size() - 1;
+            for (int row = 0; row < rows; row++) {
+                for (int col = 0; col < cols; col++) {
+                    reduce(values, numColumns, numRows, l, row, col);
+                }
+            }
+        }
+    }
+
+    // propagate a modified value of the matrix through all levels
+    void update(const double *values, int numColumns, int numRows, int row, int col)
+    {
+        for (int l = 0; l < levels.size(); l++) {
+            row /= 2;
+            col /= 2;
+
+            reduce(values, numColumns, numRows, l, row, col);
+        }
+    }
+
+    void clear() { levels.clear(); }
+
+    QVector<Level> levels; // levels[0] is the first reduction
+
+private:
+    void reduce(const double *values, int numColumns, int numRows, int l, int row, int col)
+    {
+        double sum = 0.0;
+        double min = std::numeric_limits<double>::max();
+        double max = -std::numeric_limits<double>::max();
+        int count = 0;
+
+        const Level *from = (l > 0) ? &levels[l - 1] : NULL;
+
+        const int fromColumns = from ? from->numColumns : numColumns;
+        const int fromRows = from ? from->numRows : numRows;
+
+        for (int r = 2 * row; r < qMin(2 * row + 2, fromRows); r++) {
+            for (int c = 2 * col; c < qMin(2 * col + 2, fromColumns); c++) {
+                const int i = r * fromColumns + c;
+
+                if (from == NULL) {
+                    const double v = values[i];
+                    if (!qIsNaN(v)) {
+                        sum += v;
+                        min = qMin(min, v);
+                        max = qMax(max, v);
+                        count++;
+                    }
+                } else if (from->count[i] > 0) {
+                    sum += from->mean[i] * from->count[i];
+                    min = qMin(min, from->minimum[i]);
+                    max = qMax(max, from->maximum[i]);
+                    count += from->count[i];
+                }
+            }
+        }
+
+        Level &level = levels[l];
+        const int i = row * level.numColumns + col;
+
+        level.count[i] = count;
+        if (count > 0) {
+            level.minimum[i] = min;
+            level.maximum[i] = max;
+            level.mean[i] = sum / count;
+        } else {
+            level.minimum[i] = level.maximum[i] = level.mean[i] = qQNaN();
+        }
+    }
+};
+
+class QwtMatrixRasterData::PrivateData
+{
+public:
+    PrivateData() :
+        resampleMode(QwtMatrixRasterData::NearestNeighbour), pyramidMode(QwtMatrixRasterData::NoPyramid),
+        numColumns(0), level(0), revision(0), fullRevision(0)
+    {
+    }
+
+    inline double value(int row, int col) const { return matrix.value(row, col); }
+
+    void nearestNeighbour(double x, double dx, double y, int numValues, double *out) const;
+    void resample(double x, double dx, double y, int numValues, double *out) const;
+
+    void invalidateTables()
+    {
+        columnTable.invalidate();
+        rowTable.invalidate();
+    }
+
+    void buildPyramid()
+    {
+        if (pyramidMode != QwtMatrixRasterData::NoPyramid) {
+            pyramid.build(values.constData(), numColumns, numRows);
+        } else {
+            pyramid.clear();
+        }
+
+        selectLevel(0);
+    }
+
+    void selectLevel(int level)
+    {
+        if (pyramid.levels.isEmpty()) {
+            level = 0;
+        }
+
+        this->level = qBound(0, level, pyramid.levels.size());
+
+        if (this->level == 0) {
+            matrix.values = values.constData();
+            matrix.numColumns = numColumns;
+            matrix.numRows = numRows;
+            matrix.dx = dx;
+            matrix.dy = dy;
+        } else {
+            const QwtMatrixPyramid::Level &l = pyramid.levels[this->level - 1];
+
+            switch (pyramidMode) {
+            case QwtMatrixRasterData::PyramidMinimum :
+                matrix.values = l.minimum.constData();
+                break;
+            case QwtMatrixRasterData::PyramidMaximum :
+                matrix.values = l.maximum.constData();
+                break;
+            default :
+                matrix.values = l.mean.constData();
+            }
+
+            matrix.numColumns = l.numColumns;
+            matrix.numRows = l.numRows;
+            matrix.dx = dx * (1 << this->level);
+            matrix.dy = dy * (1 << this->level);
+        }
+    }
+
+    Interval intervals[3];
     QwtMatrixRasterData::ResampleMode resampleMode;
+    QwtMatrixRasterData::PyramidMode pyramidMode;
 
     QVector<double> values;
     int numColumns;
@@ -440,6 +1135,90 @@ public:
 
     double dx;
     double dy;
+
+    QwtMatrixPyramid pyramid;
+    int level;
+
+    /*
+        Changes are tracked in blocks of cells: the last revision, that
+        has modified a value of a block, or everything ( fullRevision ).
+     */
+    void touchAll()
+    {
+        fullRevision = ++revision;
+
+        const int numBlockColumns = (numColumns + BlockSize - 1) / BlockSize;
+        const int numBlockRows = (numRows + BlockSize - 1) / BlockSize;
+
+        blockRevisions.fill(revision, numBlockColumns * numBlockRows);
+    }
+
+    void touch(int row, int col)
+    {
+        const int numBlockColumns = (numColumns + BlockSize - 1) / BlockSize;
+        blockRevisions[(row / BlockSize) * numBlockColumns + col / BlockSize] = ++revision;
+    }
+
+    enum
+    {
+        BlockSize = 32
+    };
+
+    int revision;
+    int fullRevision;
+    QVector<int> blockRevisions;
+
+    /*
+        Validity of the values: a bit for each value, that is not NaN,
+        and the number of these values for each block of cells.
+        As a block is 32 cells wide, a row of a block is a word of the bits.
+     */
+    void buildValidity()
+    {
+        const int numBlockColumns = (numColumns + BlockSize - 1) / BlockSize;
+        const int numBlockRows = (numRows + BlockSize - 1) / BlockSize;
+
+        validBits.fill(0u, numBlockColumns * numRows);
+        validCounts.fill(0, numBlockColumns * numBlockRows);
+
+        const double *v = values.constData();
+        for (int row = 0; row < numRows; row++) {
+            quint32 *bits = validBits.data() + row * numBlockColumns;
+            int *counts = validCounts.data() + (row / BlockSize) * numBlockColumns;
+
+            for (int col = 0; col < numColumns; col++) {
+                if (!qIsNaN(*v++)) {
+                    bits[col / BlockSize] |= 1u << (col % BlockSize);
+                    counts[col / BlockSize]++;
+                }
+            }
+        }
+    }
+
+    void updateValidity(int row, int col, bool isValid)
+    {
+        const int numBlockColumns = (numColumns + BlockSize - 1) / BlockSize;
+
+        quint32 &bits = validBits[row * numBlockColumns + col / BlockSize];
+        const quint32 bit = 1u << (col % BlockSize);
+
+        if (bool(bits & bit) != isValid) {
+            bits ^= bit;
+            validCounts[(row / BlockSize) * numBlockColumns + col / BlockSize] += isValid ? 1 : -1;
+        }
+    }
+
+    RasterData::Validity validity(int col1, int col2, int row1, int row2) const;
+
+    QVector<quint32> validBits;
+    QVector<int> validCounts;
+
+    // the matrix, that is resampled: the value matrix or a level of the pyramid
+    QwtMatrixView<double> matrix;
+
+    // precalculated in initRaster()
+    QwtResampleTable columnTable;
+    QwtResampleTable rowTable;
 };
 
 // ! Constructor
@@ -463,7 +1242,11 @@ QwtMatrixRasterData::~QwtMatrixRasterData()
  */
 void QwtMatrixRasterData::setResampleMode(ResampleMode mode)
 {
-    m_data->resampleMode = mode;
+    if (mode != m_data->resampleMode) {
+        m_data->resampleMode = mode;
+        m_data->invalidateTables();
+        m_data->touchAll();
+    }
 }
 
 /*!
@@ -475,6 +1258,52 @@ QwtMatrixRasterData::ResampleMode QwtMatrixRasterData::resampleMode() const
     return m_data->resampleMode;
 }
 
+/*!
+   \brief Enable a pyramid of reduced matrices
+
+   When a raster is much coarser than the value matrix most of the
+   values are skipped, what is expensive and results in aliasing.
+   With a pyramid initRaster() selects the finest level of 2x2 reductions,
+   whose cells are not larger than a pixel of the raster, so that
+   the cost depends on the size of the raster only.
+
+   The pyramid is built in setValueMatrix() and updated in setValue().
+   It needs about the memory of the value matrix for each of
+   minimum, maximum and mean. NaN values are ignored in the reduction.
+
+   The default setting is NoPyramid.
+
+   \param mode Pyramid mode
+   \sa pyramidMode(), initRaster()
+ */
+void QwtMatrixRasterData::setPyramidMode(PyramidMode mode)
+{
+    if (mode != m_data->pyramidMode) {
+        const bool rebuild = (mode == NoPyramid) || (m_data->pyramidMode == NoPyramid);
+
+        m_data->pyramidMode = mode;
+
+        m_data->invalidateTables();
+
+        if (rebuild) {
+            m_data->buildPyramid();
+        } else {
+            m_data->selectLevel(0);
+        }
+
+        m_data->touchAll();
+    }
+}
+
+/*!
+   \return Pyramid mode
+   \sa setPyramidMode()
+ */
+QwtMatrixRasterData::PyramidMode QwtMatrixRasterData::pyramidMode() const
+{
+    return m_data->pyramidMode;
+}
+
 /*!
    \brief Assign the bounding interval for an axis
 
@@ -529,7 +1358,28 @@ void QwtMatrixRasterData::setValueMatrix(const QVector<double> &values, int numC
 {
     m_data->values = values;
     m_data->numColumns = qMax(numColumns, 0);
-    update();
+
+    updateValues();
+}
+
+/*!
+   \brief Assign a value matrix without copying it
+
+   The values are swapped with the current value matrix: afterwards
+   values contains the previous matrix, so that a producer can fill
+   it for the next frame without allocating another buffer.
+
+   \param values Vector of values
+   \param numColumns Number of columns
+
+   \sa setValueMatrix(), writableValues()
+ */
+void QwtMatrixRasterData::setValueMatrix(QVector<double> &&values, int numColumns)
+{
+    m_data->values.swap(values);
+    m_data->numColumns = qMax(numColumns, 0);
+
+    updateValues();
 }
 
 /*!
@@ -541,6 +1391,48 @@ const QVector<double> QwtMatrixRasterData::valueMatrix() const
     return m_data->values;
 }
 
+/*!
+   \return Read only access to the value matrix, that is valid
+           until the matrix is modified
+   \sa valueMatrix(), writableValues()
+ */
+QwtMatrixRasterData::ValueSpan QwtMatrixRasterData::valueSpan() const
+{
+    ValueSpan span;
+    if (m_data->numRows > 0) {
+        span.values = m_data->values.constData();
+        span.numColumns = m_data->numColumns;
+        span.numRows = m_data->numRows;
+    }
+
+    return span;
+}
+
+/*!
+   \brief Modify the value matrix in place
+
+   The values of the returned view can be modified directly, what avoids
+   copying the matrix out and back. Everything, that depends on the
+   values, is updated once, when the view is released.
+
+   \code
+       QwtMatrixRasterData::WritableValues matrix = data->writableValues();
+       for ( int row = 0; row < matrix.numRows(); row++ )
+       {
+           double *line = matrix.line( row );
+           for ( int col = 0; col < matrix.numColumns(); col++ )
+               line[col] = ...;
+       }
+   \endcode
+
+   \return Writable view of the value matrix
+   \sa WritableValues, setValue(), valueSpan()
+ */
+QwtMatrixRasterData::WritableValues QwtMatrixRasterData::writableValues()
+{
+    return WritableValues(this);
+}
+
 /*!
    \brief Change a single value in the matrix
 
@@ -555,6 +1447,16 @@ void QwtMatrixRasterData::setValue(int row, int col, double value)
     if ((row >= 0) && (row < m_data->numRows) && (col >= 0) && (col < m_data->numColumns)) {
         const int index = row * m_data->numColumns + col;
         m_data->values.data()[index] = value;
+
+        if (m_data->pyramidMode != NoPyramid) {
+            m_data->pyramid.update(m_data->values.constData(), m_data->numColumns, m_data->numRows, row, col);
+        }
+
+        // data() might have detached the values
+        m_data->selectLevel(m_data->level);
+
+        m_data->updateValidity(row, col, !qIsNaN(value));
+        m_data->touch(row, col);
     }
 }
 
@@ -634,8 +1536,8 @@ double QwtMatrixRasterData::value(double x, double y) const
     switch (m_data->resampleMode) {
     case BicubicInterpolation :
     {
-        const double colF = (x - xInterval.minValue()) / m_data->dx;
-        const double rowF = (y - yInterval.minValue()) / m_data->dy;
+        const double colF = (x - xInterval.minValue()) / m_data->matrix.dx;
+        const double rowF = (y - yInterval.minValue()) / m_data->matrix.dy;
 
         const int col = qRound(colF);
         const int row = qRound(rowF);
@@ -653,11 +1555,11 @@ double QwtMatrixRasterData::value(double x, double y) const
             col0 = col1;
         }
 
-        if (col2 >= m_data->numColumns) {
+        if (col2 >= m_data->matrix.numColumns) {
             col2 = col1;
         }
 
-        if (col3 >= m_data->numColumns) {
+        if (col3 >= m_data->matrix.numColumns) {
             col3 = col2;
         }
 
@@ -674,11 +1576,11 @@ double QwtMatrixRasterData::value(double x, double y) const
             row0 = row1;
         }
 
-        if (row2 >= m_data->numRows) {
+        if (row2 >= m_data->matrix.numRows) {
             row2 = row1;
         }
 
-        if (row3 >= m_data->numRows) {
+        if (row3 >= m_data->matrix.numRows) {
             row3 = row2;
         }
 
@@ -713,20 +1615,20 @@ double QwtMatrixRasterData::value(double x, double y) const
     }
     case BilinearInterpolation :
     {
-        int col1 = qRound((x - xInterval.minValue()) / m_data->dx) - 1;
-        int row1 = qRound((y - yInterval.minValue()) / m_data->dy) - 1;
+        int col1 = qRound((x - xInterval.minValue()) / m_data->matrix.dx) - 1;
+        int row1 = qRound((y - yInterval.minValue()) / m_data->matrix.dy) - 1;
         int col2 = col1 + 1;
         int row2 = row1 + 1;
 
         if (col1 < 0) {
             col1 = col2;
-        } else if (col2 >= m_data->numColumns) {
+        } else if (col2 >= m_data->matrix.numColumns) {
             col2 = col1;
         }
 
         if (row1 < 0) {
             row1 = row2;
-        } else if (row2 >= m_data->numRows) {
+        } else if (row2 >= m_data->matrix.numRows) {
             row2 = row1;
         }
 
@@ -735,11 +1637,11 @@ double QwtMatrixRasterData::value(double x, double y) const
         const double v12 = m_data->value(row2, col1);
         const double v22 = m_data->value(row2, col2);
 
-        const double x2 = xInterval.minValue() + (col2 + 0.5) * m_data->dx;
-        const double y2 = yInterval.minValue() + (row2 + 0.5) * m_data->dy;
+        const double x2 = xInterval.minValue() + (col2 + 0.5) * m_data->matrix.dx;
+        const double y2 = yInterval.minValue() + (row2 + 0.5) * m_data->matrix.dy;
 
-        const double rx = (x2 - x) / m_data->dx;
-        const double ry = (y2 - y) / m_data->dy;
+        const double rx = (x2 - x) / m_data->matrix.dx;
+        const double ry = (y2 - y) / m_data->matrix.dy;
 
         const double vr1 = rx * v11 + (1.0 - rx) * v21;
         const double vr2 = rx * v12 + (1.0 - rx) * v22;
@@ -751,20 +1653,20 @@ double QwtMatrixRasterData::value(double x, double y) const
     case NearestNeighbour :
     default :
     {
-        int row = int((y - yInterval.minValue()) / m_data->dy);
-        int col = int((x - xInterval.minValue()) / m_data->dx);
+        int row = int((y - yInterval.minValue()) / m_data->matrix.dy);
+        int col = int((x - xInterval.minValue()) / m_data->matrix.dx);
 
         // In case of intervals, where the maximum is included
         // we get out of bound for row/col, when the value for the
         // maximum is requested. Instead we return the value
         // from the last row/col
 
-        if (row >= m_data->numRows) {
-            row = m_data->numRows - 1;
+        if (row >= m_data->matrix.numRows) {
+            row = m_data->matrix.numRows - 1;
         }
 
-        if (col >= m_data->numColumns) {
-            col = m_data->numColumns - 1;
+        if (col >= m_data->matrix.numColumns) {
+            col = m_data->matrix.numColumns - 1;
         }
 
         value = m_data->value(row, col);
@@ -774,8 +1676,354 @@ double QwtMatrixRasterData::value(double x, double y) const
     return value;
 }
 
+/*!
+   \brief Initialize a raster
+
+   For the interpolating resample modes the indexes and weights
+   of the matrix columns and rows depend only on the x or y
+   position. They are calculated once for the grid of positions, that
+   PlotSpectrogram requests for an image of raster.width() x raster.height()
+   pixels spanning area.
+
+   Rows of positions, that are not on this grid, are resampled
+   without the precalculated tables.
+
+   When a pyramid is enabled, the level matching the resolution of the
+   raster is resampled instead of the value matrix until discardRaster().
+
+   \param area Area of the raster
+   \param raster Number of horizontal and vertical pixels
+
+   \sa discardRaster(), values()
+ */
+void QwtMatrixRasterData::initRaster(const QRectF &area, const QSize &raster)
+{
+    m_data->invalidateTables();
+    m_data->selectLevel(0);
+
+    if ((m_data->numRows <= 0) || raster.isEmpty()) {
+        return;
+    }
+
+    if ((m_data->pyramidMode != NoPyramid) && (m_data->dx > 0.0) && (m_data->dy > 0.0)) {
+        // the finest level, whose cells are not larger than a pixel
+
+        const double xScale = area.width() / raster.width() / m_data->dx;
+        const double yScale = area.height() / raster.height() / m_data->dy;
+
+        const double scale = qMin(xScale, yScale);
+        if (scale >= 2.0) {
+            const double level = std::log(scale) / std::log(2.0);
+            m_data->selectLevel(int(qMin(level, 30.0)));
+        }
+    }
+
+    if ((m_data->resampleMode == NearestNeighbour) || (raster.width() < 2) || (raster.height() < 2)) {
+        return;
+    }
+
+    const double xStep = area.width() / (raster.width() - 1);
+    const double yStep = area.height() / (raster.height() - 1);
+
+    const QwtMatrixView<double> &matrix = m_data->matrix;
+
+    m_data->columnTable.init(m_data->resampleMode, area.left(), xStep, raster.width(), m_data->intervals[Qt::XAxis],
+                             matrix.dx, matrix.numColumns);
+
+    m_data->rowTable.init(m_data->resampleMode, area.top(), yStep, raster.height(), m_data->intervals[Qt::YAxis],
+                          matrix.dy, matrix.numRows);
+}
+
+/*!
+   \brief Discard a raster
+
+   Releases the tables calculated in initRaster()
+   \sa initRaster()
+ */
+void QwtMatrixRasterData::discardRaster()
+{
+    m_data->invalidateTables();
+    m_data->selectLevel(0);
+}
+
+/*!
+   \brief Values of a scanline
+
+   Resamples a row of positions in one pass. The bounding intervals
+   are looked up once and the rows of the matrix, that are
+   involved, are resolved only once for all values.
+
+   The interpolating modes are evaluated as separable filters: the
+   involved rows are interpolated vertically first, and each value
+   is a dot product of 2 ( bilinear ) or 4 ( bicubic ) of these
+   interpolated columns.
+
+   \param x X value of the first position in plot coordinates
+   \param dx Distance between 2 positions in plot coordinates
+   \param y Y value in plot coordinates
+   \param numValues Number of values
+   \param values Array of at least numValues doubles
+
+   \sa value(), ResampleMode
+ */
+void QwtMatrixRasterData::values(double x, double dx, double y, int numValues, double *values) const
+{
+    if (numValues <= 0) {
+        return;
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    int first = 0;
+    int last = numValues;
+
+    if ((m_data->numRows <= 0) || !yInterval.contains(y)) {
+        last = 0;
+    } else {
+        // the positions are monotonic, so the valid ones are a single range
+        while ((first < last) && !xInterval.contains(x + first * dx)) {
+            first++;
+        }
+
+        while ((last > first) && !xInterval.contains(x + (last - 1) * dx)) {
+            last--;
+        }
+    }
+
+    for (int i = 0; i < first; i++) {
+        values[i] = qQNaN();
+    }
+
+    for (int i = last; i < numValues; i++) {
+        values[i] = qQNaN();
+    }
+
+    if (first >= last) {
+        return;
+    }
+
+    switch (m_data->resampleMode) {
+    case BicubicInterpolation :
+    case BilinearInterpolation :
+        m_data->resample(x + first * dx, dx, y, last - first, values + first);
+        break;
+    case NearestNeighbour :
+    default :
+        m_data->nearestNeighbour(x + first * dx, dx, y, last - first, values + first);
+    }
+}
+
+void QwtMatrixRasterData::PrivateData::nearestNeighbour(double x, double dx, double y, int numValues,
+                                                        double *out) const
+{
+    qwtNearestNeighbours(matrix, intervals[Qt::XAxis], intervals[Qt::YAxis], x, dx, y, numValues, out);
+}
+
+void QwtMatrixRasterData::PrivateData::resample(double x, double dx, double y, int numValues, double *out) const
+{
+    qwtResampleValues(resampleMode, matrix, intervals[Qt::XAxis], intervals[Qt::YAxis], columnTable, rowTable, x, dx,
+                      y, numValues, out);
+}
+
+/*!
+   \brief Validity of the values in an area
+
+   The validity is looked up from a bit for each value of the matrix,
+   that is not NaN, and the number of these values in blocks of 32x32
+   cells, that are updated by setValueMatrix() and setValue().
+   The area includes the neighbored cells, that are involved in the
+   resampling. Positions outside of the X and Y intervals are NaN.
+
+   When a level of the pyramid is resampled, the area is expanded to
+   the cells of the value matrix, that are reduced into the cells of
+   the level.
+
+   \param area Area in plot coordinates, including its borders
+   \return Validity of the values at any position in area
+
+   \sa RasterData::validity(), setValue()
+ */
+RasterData::Validity QwtMatrixRasterData::validity(const QRectF &area) const
+{
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    const QwtMatrixView<double> &matrix = m_data->matrix;
+
+    if ((matrix.numRows <= 0) || (matrix.dx <= 0.0) || (matrix.dy <= 0.0)) {
+        return NoneValid;
+    }
+
+    if ((area.right() < xInterval.minValue()) || (area.left() > xInterval.maxValue())
+        || (area.bottom() < yInterval.minValue()) || (area.top() > yInterval.maxValue())) {
+        return NoneValid;
+    }
+
+    // neighbors, that are involved in the interpolation
+    int margin = 0;
+    if (m_data->resampleMode == BilinearInterpolation) {
+        margin = 1;
+    } else if (m_data->resampleMode == BicubicInterpolation) {
+        margin = 2;
+    }
+
+    const double x1 = qMax(area.left(), xInterval.minValue()) - xInterval.minValue();
+    const double x2 = qMin(area.right(), xInterval.maxValue()) - xInterval.minValue();
+    const double y1 = qMax(area.top(), yInterval.minValue()) - yInterval.minValue();
+    const double y2 = qMin(area.bottom(), yInterval.maxValue()) - yInterval.minValue();
+
+    const int col1 = qMax(int(std::floor(x1 / matrix.dx)) - margin, 0);
+    const int col2 = qMin(int(std::floor(x2 / matrix.dx)) + margin, matrix.numColumns - 1);
+    const int row1 = qMax(int(std::floor(y1 / matrix.dy)) - margin, 0);
+    const int row2 = qMin(int(std::floor(y2 / matrix.dy)) + margin, matrix.numRows - 1);
+
+    // the cells of the value matrix, that are reduced into the cells of the level
+    const int factor = 1 << m_data->level;
+
+    const Validity validity =
+        m_data->validity(col1 * factor, qMin((col2 + 1) * factor, m_data->numColumns) - 1, row1 * factor,
+                         qMin((row2 + 1) * factor, m_data->numRows) - 1);
+
+    if (validity == AllValid) {
+        const bool inside = xInterval.contains(area.left()) && xInterval.contains(area.right())
+                            && yInterval.contains(area.top()) && yInterval.contains(area.bottom());
+
+        if (!inside) {
+            return PartiallyValid;
+        }
+    }
+
+    return validity;
+}
+
+RasterData::Validity QwtMatrixRasterData::PrivateData::validity(int col1, int col2, int row1, int row2) const
+{
+    const int numBlockColumns = (numColumns + BlockSize - 1) / BlockSize;
+
+    bool hasValid = false;
+    bool hasInvalid = false;
+
+    for (int blockRow = row1 / BlockSize; blockRow <= row2 / BlockSize; blockRow++) {
+        const int r1 = qMax(row1, blockRow * BlockSize);
+        const int r2 = qMin(row2, blockRow * BlockSize + BlockSize - 1);
+
+        for (int blockColumn = col1 / BlockSize; blockColumn <= col2 / BlockSize; blockColumn++) {
+            const int c1 = qMax(col1, blockColumn * BlockSize);
+            const int c2 = qMin(col2, blockColumn * BlockSize + BlockSize - 1);
+
+            const int count = validCounts[blockRow * numBlockColumns + blockColumn];
+
+            const int blockWidth = qMin(int(BlockSize), numColumns - blockColumn * BlockSize);
+            const int blockHeight = qMin(int(BlockSize), numRows - blockRow * BlockSize);
+
+            if (count == 0) {
+                hasInvalid = true;
+            } else if (count == blockWidth * blockHeight) {
+                hasValid = true;
+            } else {
+                // a mixed block: only the bits of the area count
+
+                const int numBits = c2 - c1 + 1;
+                const quint32 mask = ((numBits == 32) ? ~0u : ((1u << numBits) - 1)) << (c1 % BlockSize);
+
+                for (int row = r1; row <= r2; row++) {
+                    const quint32 bits = validBits[row * numBlockColumns + blockColumn] & mask;
+
+                    hasValid = hasValid || (bits != 0);
+                    hasInvalid = hasInvalid || (bits != mask);
+                }
+            }
+
+            if (hasValid && hasInvalid) {
+                return RasterData::PartiallyValid;
+            }
+        }
+    }
+
+    return hasValid ? RasterData::AllValid : RasterData::NoneValid;
+}
+
+/*!
+   \return Revision of the matrix, increased by each modification
+   \sa changedArea(), setValue()
+ */
+int QwtMatrixRasterData::revision() const
+{
+    return m_data->revision;
+}
+
+/*!
+   \brief Area, where values have changed
+
+   Values, that have been modified by setValue(), are tracked in blocks
+   of 32x32 cells. The area includes the neighbored cells, that are involved
+   in the resampling. All other modifications, or modifications while a
+   pyramid is enabled, result in the bounding rectangle of the data.
+
+   \param revision Revision, that has been returned by revision() before
+   \return Area, where values might be different from those at revision.
+           An empty rectangle indicates, that nothing has changed.
+
+   \sa revision(), setValue()
+ */
+QRectF QwtMatrixRasterData::changedArea(int revision) const
+{
+    if (revision >= m_data->revision) {
+        return QRectF();
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    if ((revision < m_data->fullRevision) || (m_data->pyramidMode != NoPyramid)) {
+        return RasterData::changedArea(revision);
+    }
+
+    const int blockSize = PrivateData::BlockSize;
+    const int numBlockColumns = (m_data->numColumns + blockSize - 1) / blockSize;
+
+    QRect cells;
+    for (int i = 0; i < m_data->blockRevisions.size(); i++) {
+        if (m_data->blockRevisions[i] > revision) {
+            const int row = (i / numBlockColumns) * blockSize;
+            const int col = (i % numBlockColumns) * blockSize;
+
+            cells |= QRect(col, row, blockSize, blockSize);
+        }
+    }
+
+    if (cells.isEmpty()) {
+        return QRectF();
+    }
+
+    // neighbors, that are involved in the interpolation
+    int margin = 0;
+    if (m_data->resampleMode == BilinearInterpolation) {
+        margin = 1;
+    } else if (m_data->resampleMode == BicubicInterpolation) {
+        margin = 2;
+    }
+
+    cells.adjust(-margin, -margin, margin, margin);
+
+    return QRectF(xInterval.minValue() + cells.left() * m_data->dx, yInterval.minValue() + cells.top() * m_data->dy,
+                  cells.width() * m_data->dx, cells.height() * m_data->dy);
+}
+
+// recalculate everything, that depends on the values of the matrix
+void QwtMatrixRasterData::updateValues()
+{
+    update();
+
+    m_data->buildPyramid();
+    m_data->buildValidity();
+}
+
 void QwtMatrixRasterData::update()
 {
+    m_data->invalidateTables();
+
     m_data->numRows = 0;
     m_data->dx = 0.0;
     m_data->dy = 0.0;
@@ -792,4 +2040,87 @@ void QwtMatrixRasterData::update()
             m_data->dy = yInterval.width() / m_data->numRows;
         }
     }
+
+    m_data->selectLevel(0);
+    m_data->touchAll();
+}
+
+/*!
+   \brief Take over a view from another one
+   \param other View, that is released without updating the data
+ */
+QwtMatrixRasterData::WritableValues::WritableValues(WritableValues &&other) :
+    m_matrixData(other.m_matrixData), m_values(other.m_values)
+{
+    other.m_matrixData = NULL;
+    other.m_values = NULL;
+}
+
+QwtMatrixRasterData::WritableValues::WritableValues(QwtMatrixRasterData *matrixData) :
+    m_matrixData(matrixData), m_values(NULL)
+{
+    if (matrixData->m_data->numRows > 0) {
+        // data() detaches the values from copies returned by valueMatrix()
+        m_values = matrixData->m_data->values.data();
+    }
+}
+
+// ! Destructor, calling release()
+QwtMatrixRasterData::WritableValues::~WritableValues()
+{
+    release();
+}
+
+/*!
+   \return Values row by row, or NULL for an empty matrix
+   \sa line(), stride()
+ */
+double *QwtMatrixRasterData::WritableValues::values() const
+{
+    return m_values;
+}
+
+/*!
+   \return Values of a row
+   \param row Row index
+ */
+double *QwtMatrixRasterData::WritableValues::line(int row) const
+{
+    return m_values + row * stride();
+}
+
+// ! \return Number of columns of the value matrix
+int QwtMatrixRasterData::WritableValues::numColumns() const
+{
+    return m_values ? m_matrixData->m_data->numColumns : 0;
+}
+
+// ! \return Number of rows of the value matrix
+int QwtMatrixRasterData::WritableValues::numRows() const
+{
+    return m_values ? m_matrixData->m_data->numRows : 0;
+}
+
+// ! \return Distance between the first values of 2 rows
+int QwtMatrixRasterData::WritableValues::stride() const
+{
+    return numColumns();
+}
+
+/*!
+   \brief Finish the modifications
+
+   Updates the pyramid, the validity of the values and the revision
+   of the data. Afterwards the view is empty.
+ */
+void QwtMatrixRasterData::WritableValues::release()
+{
+    if (m_matrixData) {
+        if (m_values) {
+            m_matrixData->updateValues();
+        }
+
+        m_matrixData = NULL;
+        m_values = NULL;
+    }
 }
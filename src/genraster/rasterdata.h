@@ -40,6 +40,9 @@ public:
     // ! Contour lines
     typedef QMap<double, QPolygonF> ContourLines;
 
+    // ! Connected contour lines: a list of polylines for each level
+    typedef QMap<double, QVector<QPolygonF>> ContourPolylines;
+
     /*!
        \brief Raster data attributes
 
@@ -58,6 +61,7 @@ public:
 
            Enabling this flag will have an positive effect on
            the performance of rendering a PlotSpectrogram.
+           It is evaluated by the default implementation of validity().
 
            The default setting is false.
 
@@ -68,6 +72,22 @@ public:
 
     Q_DECLARE_FLAGS(Attributes, Attribute)
 
+    /*!
+       \brief Validity of the values in an area
+       \sa validity()
+     */
+    enum Validity
+    {
+        // ! Some of the values might be NaN
+        PartiallyValid,
+
+        // ! All values are NaN
+        NoneValid,
+
+        // ! None of the values is NaN
+        AllValid
+    };
+
     // ! Flags to modify the contour algorithm
     enum ConrecFlag
     {
@@ -80,6 +100,25 @@ public:
 
     Q_DECLARE_FLAGS(ConrecFlags, ConrecFlag)
 
+    /*!
+       \brief Algorithm for calculating contour lines
+       \sa contourLines(), contourPolylines()
+     */
+    enum ContourAlgorithm
+    {
+        /*!
+           CONREC, resulting in unconnected segments of 2 points
+           \sa contourLines()
+         */
+        Conrec,
+
+        /*!
+           Marching squares, resulting in connected polylines
+           \sa contourPolylines()
+         */
+        MarchingSquares
+    };
+
     RasterData();
     virtual ~RasterData();
 
@@ -104,9 +143,19 @@ public:
      */
     virtual double value(double x, double y) const = 0;
 
+    virtual void values(double x, double dx, double y, int numValues, double *values) const;
+
+    virtual Validity validity(const QRectF &area) const;
+
+    virtual int revision() const;
+    virtual QRectF changedArea(int revision) const;
+
     virtual ContourLines contourLines(const QRectF &rect, const QSize &raster, const QList<double> &levels,
                                       ConrecFlags) const;
 
+    virtual ContourPolylines contourPolylines(const QRectF &rect, const QSize &raster, const QList<double> &levels,
+                                              ConrecFlags) const;
+
     class Contour3DPoint;
     class ContourPlane;
 
@@ -156,18 +205,106 @@ public:
         BicubicInterpolation
     };
 
+    /*!
+       \brief Reduction of the levels of the pyramid
+       The default setting is NoPyramid
+       \sa setPyramidMode()
+     */
+    enum PyramidMode
+    {
+        // ! Always resample the value matrix
+        NoPyramid,
+
+        // ! Resample the mean of the valid values of a cell
+        PyramidMean,
+
+        // ! Resample the minimum of the valid values of a cell
+        PyramidMinimum,
+
+        // ! Resample the maximum of the valid values of a cell
+        PyramidMaximum
+    };
+
+    /*!
+       \brief Read only access to the value matrix without copying it
+
+       A span is valid until the value matrix is modified.
+       \sa valueSpan()
+     */
+    class ValueSpan
+    {
+    public:
+        ValueSpan() : values(NULL), numColumns(0), numRows(0) {}
+
+        // ! \return Values of a row
+        inline const double *line(int row) const { return values + row * numColumns; }
+
+        // ! Values row by row
+        const double *values;
+
+        // ! Number of columns
+        int numColumns;
+
+        // ! Number of rows
+        int numRows;
+    };
+
+    /*!
+       \brief Scoped write access to the value matrix
+
+       The values of the matrix can be modified in place. When the
+       view is released, the pyramid, the validity of the values and
+       the revision are updated once for all modifications.
+
+       The view must not be used concurrently to rendering the data.
+       \sa writableValues()
+     */
+    class WritableValues
+    {
+    public:
+        WritableValues(WritableValues &&);
+        ~WritableValues();
+
+        double *values() const;
+        double *line(int row) const;
+
+        int numColumns() const;
+        int numRows() const;
+        int stride() const;
+
+        void release();
+
+    private:
+        friend class QwtMatrixRasterData;
+
+        explicit WritableValues(QwtMatrixRasterData *);
+
+        WritableValues(const WritableValues &) = delete;
+        WritableValues &operator=(const WritableValues &) = delete;
+
+        QwtMatrixRasterData *m_matrixData;
+        double *m_values;
+    };
+
     QwtMatrixRasterData();
     virtual ~QwtMatrixRasterData();
 
     void setResampleMode(ResampleMode mode);
     ResampleMode resampleMode() const;
 
+    void setPyramidMode(PyramidMode mode);
+    PyramidMode pyramidMode() const;
+
     void setInterval(Qt::Axis, const Interval &);
     virtual Interval interval(Qt::Axis axis) const override final;
 
     void setValueMatrix(const QVector<double> &values, int numColumns);
+    void setValueMatrix(QVector<double> &&values, int numColumns);
     const QVector<double> valueMatrix() const;
 
+    ValueSpan valueSpan() const;
+    WritableValues writableValues();
+
     void setValue(int row, int col, double value);
 
     int numColumns() const;
@@ -175,10 +312,20 @@ public:
 
     virtual QRectF pixelHint(const QRectF &) const override;
 
+    virtual void initRaster(const QRectF &, const QSize &raster) override;
+    virtual void discardRaster() override;
+
     virtual double value(double x, double y) const override;
+    virtual void values(double x, double dx, double y, int numValues, double *values) const override;
+
+    virtual Validity validity(const QRectF &area) const override;
+
+    virtual int revision() const override;
+    virtual QRectF changedArea(int revision) const override;
 
 private:
     void update();
+    void updateValues();
 
     class PrivateData;
     PrivateData *m_data;
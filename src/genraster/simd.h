@@ -0,0 +1,418 @@
+﻿#ifndef SIMD_H
+#define SIMD_H
+
+/*
+    Helpers for kernels, that are written for a vector of doubles, using
+    the widest instruction set, that is enabled for the compiler.
+    Without SSE2 a vector is a single double.
+ */
+
+#if defined(__AVX__)
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#if defined(__AVX__)
+
+typedef __m256d QwtVector;
+static const int QwtVectorSize = 4;
+
+static inline QwtVector qwtVectorLoad(const double *v)
+{
+    return _mm256_loadu_pd(v);
+}
+
+static inline void qwtVectorStore(double *v, QwtVector a)
+{
+    _mm256_storeu_pd(v, a);
+}
+
+static inline QwtVector qwtVectorSet(double v)
+{
+    return _mm256_set1_pd(v);
+}
+
+static inline QwtVector qwtVectorAdd(QwtVector a, QwtVector b)
+{
+    return _mm256_add_pd(a, b);
+}
+
+static inline QwtVector qwtVectorSub(QwtVector a, QwtVector b)
+{
+    return _mm256_sub_pd(a, b);
+}
+
+static inline QwtVector qwtVectorMul(QwtVector a, QwtVector b)
+{
+    return _mm256_mul_pd(a, b);
+}
+
+// qwtVectorMin/Max return b, when one of the operands is NaN
+static inline QwtVector qwtVectorMin(QwtVector a, QwtVector b)
+{
+    return _mm256_min_pd(a, b);
+}
+
+static inline QwtVector qwtVectorMax(QwtVector a, QwtVector b)
+{
+    return _mm256_max_pd(a, b);
+}
+
+static inline void qwtVectorTruncate(QwtVector a, int *v)
+{
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(v), _mm256_cvttpd_epi32(a));
+}
+
+#elif defined(__SSE2__)
+
+typedef __m128d QwtVector;
+static const int QwtVectorSize = 2;
+
+static inline QwtVector qwtVectorLoad(const double *v)
+{
+    return _mm_loadu_pd(v);
+}
+
+static inline void qwtVectorStore(double *v, QwtVector a)
+{
+    _mm_storeu_pd(v, a);
+}
+
+static inline QwtVector qwtVectorSet(double v)
+{
+    return _mm_set1_pd(v);
+}
+
+static inline QwtVector qwtVectorAdd(QwtVector a, QwtVector b)
+{
+    return _mm_add_pd(a, b);
+}
+
+static inline QwtVector qwtVectorSub(QwtVector a, QwtVector b)
+{
+    return _mm_sub_pd(a, b);
+}
+
+static inline QwtVector qwtVectorMul(QwtVector a, QwtVector b)
+{
+    return _mm_mul_pd(a, b);
+}
+
+static inline QwtVector qwtVectorMin(QwtVector a, QwtVector b)
+{
+    return _mm_min_pd(a, b);
+}
+
+static inline QwtVector qwtVectorMax(QwtVector a, QwtVector b)
+{
+    return _mm_max_pd(a, b);
+}
+
+static inline void qwtVectorTruncate(QwtVector a, int *v)
+{
+    const __m128i i = _mm_cvttpd_epi32(a);
+    v[0] = _mm_cvtsi128_si32(i);
+    v[1] = _mm_cvtsi128_si32(_mm_shuffle_epi32(i, 1));
+}
+
+#else
+
+typedef double QwtVector;
+static const int QwtVectorSize = 1;
+
+static inline QwtVector qwtVectorLoad(const double *v)
+{
+    return *v;
+}
+
+static inline void qwtVectorStore(double *v, QwtVector a)
+{
+    *v = a;
+}
+
+static inline QwtVector qwtVectorSet(double v)
+{
+    return v;
+}
+
+static inline QwtVector qwtVectorAdd(QwtVector a, QwtVector b)
+{
+    return a + b;
+}
+
+static inline QwtVector qwtVectorSub(QwtVector a, QwtVector b)
+{
+    return a - b;
+}
+
+static inline QwtVector qwtVectorMul(QwtVector a, QwtVector b)
+{
+    return a * b;
+}
+
+static inline QwtVector qwtVectorMin(QwtVector a, QwtVector b)
+{
+    return (a < b) ? a : b;
+}
+
+static inline QwtVector qwtVectorMax(QwtVector a, QwtVector b)
+{
+    return (a > b) ? a : b;
+}
+
+static inline void qwtVectorTruncate(QwtVector a, int *v)
+{
+    *v = int(a);
+}
+
+#endif
+
+/*
+    Kernels for rows of 32 bit pixels. The instruction set is selected at
+    runtime: AVX2, when the CPU supports it, otherwise SSE2, that is
+    always available on x86_64. Other architectures use scalar loops.
+ */
+
+#include <QtGlobal>
+
+#if defined(__GNUC__) && defined(__SSE2__) && (defined(__x86_64__) || defined(__i386__))
+#define QWT_PIXEL_DISPATCH 1
+#include <immintrin.h>
+#endif
+
+// ! Functions of the pixel kernels
+class QwtPixelKernels
+{
+public:
+    // ! Set count pixels to rgb
+    void (*fill)(quint32 *dst, quint32 rgb, int count);
+
+    /*!
+       Replace the alpha value of count pixels by the alpha value of mask,
+       pixels with an alpha value of 0 are copied unchanged.
+     */
+    void (*setAlpha)(const quint32 *src, quint32 *dst, int count, quint32 mask);
+
+    // ! Map count 8 bit indexes to the pixels of a table of 256 entries
+    void (*mapIndexes)(const uchar *src, quint32 *dst, int count, const quint32 *table);
+
+    /*!
+       Blend count ARGB32 pixels over premultiplied ARGB32 pixels
+       ( QPainter::CompositionMode_SourceOver )
+     */
+    void (*blend)(const quint32 *src, quint32 *dst, int count);
+};
+
+static inline void qwtFillScalar(quint32 *dst, quint32 rgb, int count)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = rgb;
+    }
+}
+
+static inline void qwtSetAlphaScalar(const quint32 *src, quint32 *dst, int count, quint32 mask)
+{
+    for (int i = 0; i < count; i++) {
+        const quint32 rgb = src[i];
+        dst[i] = (rgb & 0xff000000u) ? ((rgb & 0x00ffffffu) | mask) : rgb;
+    }
+}
+
+static inline void qwtMapIndexesScalar(const uchar *src, quint32 *dst, int count, const quint32 *table)
+{
+    for (int i = 0; i < count; i++) {
+        dst[i] = table[src[i]];
+    }
+}
+
+// x * a / 255 for the 4 channels of a pixel, rounded like QPainter
+static inline quint32 qwtByteMul(quint32 x, quint32 a)
+{
+    quint32 t = (x & 0x00ff00ffu) * a;
+    t = ((t + ((t >> 8) & 0x00ff00ffu) + 0x00800080u) >> 8) & 0x00ff00ffu;
+
+    x = ((x >> 8) & 0x00ff00ffu) * a;
+    x = (x + ((x >> 8) & 0x00ff00ffu) + 0x00800080u) & 0xff00ff00u;
+
+    return x | t;
+}
+
+static inline void qwtBlendScalar(const quint32 *src, quint32 *dst, int count)
+{
+    for (int i = 0; i < count; i++) {
+        const quint32 rgb = src[i];
+        const quint32 alpha = rgb >> 24;
+
+        if (alpha == 255) {
+            dst[i] = rgb;
+        } else if (alpha != 0) {
+            dst[i] = qwtByteMul(rgb | 0xff000000u, alpha) + qwtByteMul(dst[i], 255 - alpha);
+        }
+    }
+}
+
+#if QWT_PIXEL_DISPATCH
+
+static inline void qwtFillSse2(quint32 *dst, quint32 rgb, int count)
+{
+    const __m128i v = _mm_set1_epi32(int(rgb));
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+
+    qwtFillScalar(dst + i, rgb, count - i);
+}
+
+static inline void qwtSetAlphaSse2(const quint32 *src, quint32 *dst, int count, quint32 mask)
+{
+    const __m128i alphaBits = _mm_set1_epi32(int(0xff000000u));
+    const __m128i alpha = _mm_set1_epi32(int(mask));
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i rgb = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+        const __m128i transparent = _mm_cmpeq_epi32(_mm_and_si128(rgb, alphaBits), _mm_setzero_si128());
+        const __m128i blended = _mm_or_si128(_mm_andnot_si128(alphaBits, rgb), alpha);
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_or_si128(_mm_and_si128(transparent, rgb), _mm_andnot_si128(transparent, blended)));
+    }
+
+    qwtSetAlphaScalar(src + i, dst + i, count - i, mask);
+}
+
+// x * a / 255 for 16 bit lanes, rounded like qwtByteMul()
+static inline __m128i qwtByteMulSse2(__m128i x, __m128i a)
+{
+    const __m128i t = _mm_mullo_epi16(x, a);
+    return _mm_srli_epi16(_mm_add_epi16(_mm_add_epi16(t, _mm_srli_epi16(t, 8)), _mm_set1_epi16(0x80)), 8);
+}
+
+static inline void qwtBlendSse2(const quint32 *src, quint32 *dst, int count)
+{
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i alphaBits = _mm_set1_epi32(int(0xff000000u));
+    const __m128i alphaLanes = _mm_set_epi16(255, 0, 0, 0, 255, 0, 0, 0);
+    const __m128i max = _mm_set1_epi16(255);
+
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        const __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i));
+
+        const int mask = _mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaBits), zero));
+        if (mask == 0xffff) {
+            continue; // transparent
+        }
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi32(_mm_and_si128(s, alphaBits), alphaBits)) == 0xffff) {
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), s); // opaque
+            continue;
+        }
+
+        const __m128i d = _mm_loadu_si128(reinterpret_cast<const __m128i *>(dst + i));
+
+        __m128i result[2];
+        for (int j = 0; j < 2; j++) {
+            const __m128i s16 = (j == 0) ? _mm_unpacklo_epi8(s, zero) : _mm_unpackhi_epi8(s, zero);
+            const __m128i d16 = (j == 0) ? _mm_unpacklo_epi8(d, zero) : _mm_unpackhi_epi8(d, zero);
+
+            __m128i a16 = _mm_shufflelo_epi16(s16, _MM_SHUFFLE(3, 3, 3, 3));
+            a16 = _mm_shufflehi_epi16(a16, _MM_SHUFFLE(3, 3, 3, 3));
+
+            const __m128i premultiplied = qwtByteMulSse2(_mm_or_si128(s16, alphaLanes), a16);
+            const __m128i background = qwtByteMulSse2(d16, _mm_sub_epi16(max, a16));
+
+            result[j] = _mm_add_epi16(premultiplied, background);
+        }
+
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packus_epi16(result[0], result[1]));
+    }
+
+    qwtBlendScalar(src + i, dst + i, count - i);
+}
+
+__attribute__((target("avx2"))) static inline void qwtFillAvx2(quint32 *dst, quint32 rgb, int count)
+{
+    const __m256i v = _mm256_set1_epi32(int(rgb));
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), v);
+    }
+
+    qwtFillSse2(dst + i, rgb, count - i);
+}
+
+__attribute__((target("avx2"))) static inline void qwtSetAlphaAvx2(const quint32 *src, quint32 *dst, int count,
+                                                             quint32 mask)
+{
+    const __m256i alphaBits = _mm256_set1_epi32(int(0xff000000u));
+    const __m256i alpha = _mm256_set1_epi32(int(mask));
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m256i rgb = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i));
+
+        const __m256i transparent = _mm256_cmpeq_epi32(_mm256_and_si256(rgb, alphaBits), _mm256_setzero_si256());
+        const __m256i blended = _mm256_or_si256(_mm256_andnot_si256(alphaBits, rgb), alpha);
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_blendv_epi8(blended, rgb, transparent));
+    }
+
+    qwtSetAlphaSse2(src + i, dst + i, count - i, mask);
+}
+
+__attribute__((target("avx2"))) static inline void qwtMapIndexesAvx2(const uchar *src, quint32 *dst, int count,
+                                                               const quint32 *table)
+{
+    const int *t = reinterpret_cast<const int *>(table);
+
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        const __m128i indexes = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(src + i));
+
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i),
+                            _mm256_i32gather_epi32(t, _mm256_cvtepu8_epi32(indexes), 4));
+    }
+
+    qwtMapIndexesScalar(src + i, dst + i, count - i, table);
+}
+
+#endif
+
+static inline QwtPixelKernels qwtSelectPixelKernels()
+{
+    QwtPixelKernels kernels;
+    kernels.fill = qwtFillScalar;
+    kernels.setAlpha = qwtSetAlphaScalar;
+    kernels.mapIndexes = qwtMapIndexesScalar;
+    kernels.blend = qwtBlendScalar;
+
+#if QWT_PIXEL_DISPATCH
+    kernels.fill = qwtFillSse2;
+    kernels.setAlpha = qwtSetAlphaSse2;
+    kernels.blend = qwtBlendSse2;
+
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        kernels.fill = qwtFillAvx2;
+        kernels.setAlpha = qwtSetAlphaAvx2;
+        kernels.mapIndexes = qwtMapIndexesAvx2;
+    }
+#endif
+
+    return kernels;
+}
+
+// ! \return The pixel kernels for the CPU, selected once
+static inline const QwtPixelKernels &qwtPixelKernels()
+{
+    static const QwtPixelKernels kernels = qwtSelectPixelKernels();
+    return kernels;
+}
+
+#endif
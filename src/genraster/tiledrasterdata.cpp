@@ -0,0 +1,579 @@
+﻿#include "tiledrasterdata.h"
+
+#include <QMutex>
+#include <QMutexLocker>
+#include <QRectF>
+#include <QSize>
+#include <QVarLengthArray>
+#include <QVector>
+
+#include <qnumeric.h>
+
+#include <cmath>
+
+#include "interval.h"
+#include "matrixresampler.h"
+#include "tiledrasterfile.h"
+
+class TiledRasterData::PrivateData
+{
+public:
+    PrivateData() : resampleMode(QwtMatrixRasterData::NearestNeighbour), level(0), tileShift(0), tileMask(0) {}
+
+    void selectLevel(int level)
+    {
+        unmapTiles();
+
+        this->level = qBound(0, level, qMax(file.numLevels() - 1, 0));
+        geometry = file.level(this->level);
+
+        tiles.fill(nullptr, geometry.numTileColumns * geometry.numTileRows);
+
+        dx = 0.0;
+        dy = 0.0;
+
+        if ((geometry.numColumns > 0) && (geometry.numRows > 0)) {
+            // the overviews cover 2^level values of the matrix
+            const TiledRasterFile::Level matrix = file.level(0);
+
+            dx = intervals[Qt::XAxis].width() / matrix.numColumns * (1 << this->level);
+            dy = intervals[Qt::YAxis].width() / matrix.numRows * (1 << this->level);
+        }
+    }
+
+    void unmapTiles()
+    {
+        for (int i = 0; i < tiles.size(); i++) {
+            if (tiles[i]) {
+                file.unmapTile(tiles[i]);
+                tiles[i] = nullptr;
+            }
+        }
+    }
+
+    // the mutex needs to be locked
+    const float *tile(int index)
+    {
+        if ((tiles[index] == nullptr) && file.tileRange(level, index).isValid()) {
+            tiles[index] = file.mapTile(level, index);
+        }
+
+        return tiles[index];
+    }
+
+    TiledRasterFile file;
+
+    Interval intervals[3];
+    QwtMatrixRasterData::ResampleMode resampleMode;
+
+    // the level, that is resampled
+    int level;
+    TiledRasterFile::Level geometry;
+
+    double dx;
+    double dy;
+
+    int tileShift;
+    int tileMask;
+
+    // mapped tiles of the level
+    QMutex mutex;
+    QVector<const float *> tiles;
+
+    // precalculated in initRaster()
+    QwtResampleTable columnTable;
+    QwtResampleTable rowTable;
+};
+
+// ! Constructor
+TiledRasterData::TiledRasterData()
+{
+    m_data = new PrivateData();
+}
+
+// ! Destructor
+TiledRasterData::~TiledRasterData()
+{
+    close();
+    delete m_data;
+}
+
+/*!
+   \brief Open a tiled raster file
+
+   The bounding intervals are initialized from the file.
+
+   \param fileName Name of the file
+   \return true, when the file is a valid tiled raster file
+   \sa close(), TiledRasterFile::open()
+ */
+bool TiledRasterData::open(const QString &fileName)
+{
+    close();
+
+    if (!m_data->file.open(fileName)) {
+        return false;
+    }
+
+    int shift = 0;
+    while ((1 << shift) < m_data->file.tileSize()) {
+        shift++;
+    }
+
+    m_data->tileShift = shift;
+    m_data->tileMask = m_data->file.tileSize() - 1;
+
+    for (int axis = 0; axis < 3; axis++) {
+        m_data->intervals[axis] = m_data->file.interval(static_cast<Qt::Axis>(axis));
+    }
+
+    m_data->selectLevel(0);
+
+    return true;
+}
+
+/*!
+   \brief Unmap all tiles and close the file
+   \sa open()
+ */
+void TiledRasterData::close()
+{
+    m_data->columnTable.invalidate();
+    m_data->rowTable.invalidate();
+
+    m_data->unmapTiles();
+    m_data->tiles.clear();
+
+    m_data->file.close();
+    m_data->selectLevel(0);
+}
+
+/*!
+   \return true, when a file has been opened successfully
+   \sa open()
+ */
+bool TiledRasterData::isOpen() const
+{
+    return m_data->file.isOpen();
+}
+
+/*!
+   \brief Set the resampling algorithm
+
+   \param mode Resampling mode
+   \sa resampleMode(), value()
+ */
+void TiledRasterData::setResampleMode(QwtMatrixRasterData::ResampleMode mode)
+{
+    if (mode != m_data->resampleMode) {
+        m_data->resampleMode = mode;
+
+        m_data->columnTable.invalidate();
+        m_data->rowTable.invalidate();
+    }
+}
+
+/*!
+   \return resampling algorithm
+   \sa setResampleMode(), value()
+ */
+QwtMatrixRasterData::ResampleMode TiledRasterData::resampleMode() const
+{
+    return m_data->resampleMode;
+}
+
+/*!
+   \brief Assign the bounding interval for an axis
+
+   The intervals are initialized by open() and need to be set only
+   to override the intervals of the file.
+
+   \param axis X, Y or Z axis
+   \param interval Interval
+
+   \sa RasterData::interval(), open()
+ */
+void TiledRasterData::setInterval(Qt::Axis axis, const Interval &interval)
+{
+    if ((axis >= 0) && (axis <= 2)) {
+        m_data->intervals[axis] = interval;
+
+        m_data->columnTable.invalidate();
+        m_data->rowTable.invalidate();
+
+        m_data->selectLevel(m_data->level);
+    }
+}
+
+/*!
+   \return Bounding interval for an axis
+   \sa setInterval
+ */
+Interval TiledRasterData::interval(Qt::Axis axis) const
+{
+    if ((axis >= 0) && (axis <= 2)) {
+        return m_data->intervals[axis];
+    }
+
+    return Interval();
+}
+
+/*!
+   \return Number of columns of the matrix of the file
+   \sa numRows()
+ */
+int TiledRasterData::numColumns() const
+{
+    return m_data->file.level(0).numColumns;
+}
+
+/*!
+   \return Number of rows of the matrix of the file
+   \sa numColumns()
+ */
+int TiledRasterData::numRows() const
+{
+    return m_data->file.level(0).numRows;
+}
+
+/*!
+   \return Level of the file, that is resampled. 0 is the matrix,
+           the following levels are overviews.
+   \sa initRaster()
+ */
+int TiledRasterData::level() const
+{
+    return m_data->level;
+}
+
+/*!
+   \return Number of tiles, that are currently mapped
+   \sa initRaster(), discardRaster()
+ */
+int TiledRasterData::numMappedTiles() const
+{
+    QMutexLocker locker(&m_data->mutex);
+
+    int count = 0;
+    for (int i = 0; i < m_data->tiles.size(); i++) {
+        if (m_data->tiles[i]) {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+/*!
+   \brief Calculate the pixel hint
+
+   \param area Requested area, ignored
+   \return Surrounding pixel of the top left value for NearestNeighbour,
+           otherwise an empty rectangle
+
+   \sa QwtMatrixRasterData::pixelHint()
+ */
+QRectF TiledRasterData::pixelHint(const QRectF &area) const
+{
+    Q_UNUSED(area)
+
+    QRectF rect;
+    if ((m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) && isOpen()) {
+        const TiledRasterFile::Level matrix = m_data->file.level(0);
+
+        const Interval intervalX = interval(Qt::XAxis);
+        const Interval intervalY = interval(Qt::YAxis);
+        if (intervalX.isValid() && intervalY.isValid()) {
+            rect = QRectF(intervalX.minValue(), intervalY.minValue(), intervalX.width() / matrix.numColumns,
+                          intervalY.width() / matrix.numRows);
+        }
+    }
+
+    return rect;
+}
+
+/*!
+   \brief Initialize a raster
+
+   Selects the level matching the resolution of the raster and maps the
+   tiles of this level, that are needed for resampling the area. Tiles of
+   a previous raster, that are not needed anymore, are unmapped.
+
+   \param area Area of the raster
+   \param raster Number of horizontal and vertical pixels
+
+   \sa discardRaster(), level(), numMappedTiles()
+ */
+void TiledRasterData::initRaster(const QRectF &area, const QSize &raster)
+{
+    m_data->columnTable.invalidate();
+    m_data->rowTable.invalidate();
+
+    if (!isOpen() || raster.isEmpty() || (m_data->dx <= 0.0) || (m_data->dy <= 0.0)) {
+        return;
+    }
+
+    QMutexLocker locker(&m_data->mutex);
+
+    // the coarsest level, whose cells are not larger than a pixel
+
+    const TiledRasterFile::Level matrix = m_data->file.level(0);
+
+    const double xScale = area.width() / raster.width() / (m_data->intervals[Qt::XAxis].width() / matrix.numColumns);
+    const double yScale = area.height() / raster.height() / (m_data->intervals[Qt::YAxis].width() / matrix.numRows);
+
+    int level = 0;
+
+    const double scale = qMin(xScale, yScale);
+    if (scale >= 2.0) {
+        level = int(qMin(std::log(scale) / std::log(2.0), 30.0));
+    }
+
+    level = qMin(level, m_data->file.numLevels() - 1);
+    if (level != m_data->level) {
+        m_data->selectLevel(level);
+    }
+
+    const TiledRasterFile::Level &geometry = m_data->geometry;
+
+    // the cells of the area, including the neighbours of the interpolation
+
+    const double x0 = m_data->intervals[Qt::XAxis].minValue();
+    const double y0 = m_data->intervals[Qt::YAxis].minValue();
+
+    const int col0 = qBound(0, int(std::floor((area.left() - x0) / m_data->dx)) - 2, geometry.numColumns - 1);
+    const int col1 = qBound(0, int(std::ceil((area.right() - x0) / m_data->dx)) + 2, geometry.numColumns - 1);
+    const int row0 = qBound(0, int(std::floor((area.top() - y0) / m_data->dy)) - 2, geometry.numRows - 1);
+    const int row1 = qBound(0, int(std::ceil((area.bottom() - y0) / m_data->dy)) + 2, geometry.numRows - 1);
+
+    const int tileCol0 = col0 >> m_data->tileShift;
+    const int tileCol1 = col1 >> m_data->tileShift;
+    const int tileRow0 = row0 >> m_data->tileShift;
+    const int tileRow1 = row1 >> m_data->tileShift;
+
+    for (int tileRow = 0; tileRow < geometry.numTileRows; tileRow++) {
+        for (int tileCol = 0; tileCol < geometry.numTileColumns; tileCol++) {
+            const int index = tileRow * geometry.numTileColumns + tileCol;
+
+            if ((tileRow >= tileRow0) && (tileRow <= tileRow1) && (tileCol >= tileCol0) && (tileCol <= tileCol1)) {
+                m_data->tile(index);
+            } else if (m_data->tiles[index]) {
+                m_data->file.unmapTile(m_data->tiles[index]);
+                m_data->tiles[index] = nullptr;
+            }
+        }
+    }
+
+    if ((m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) || (raster.width() < 2) ||
+        (raster.height() < 2)) {
+        return;
+    }
+
+    const double xStep = area.width() / (raster.width() - 1);
+    const double yStep = area.height() / (raster.height() - 1);
+
+    m_data->columnTable.init(m_data->resampleMode, area.left(), xStep, raster.width(), m_data->intervals[Qt::XAxis],
+                             m_data->dx, geometry.numColumns);
+
+    m_data->rowTable.init(m_data->resampleMode, area.top(), yStep, raster.height(), m_data->intervals[Qt::YAxis],
+                          m_data->dy, geometry.numRows);
+}
+
+/*!
+   \brief Discard a raster
+
+   Unmaps all tiles and releases the tables calculated in initRaster()
+   \sa initRaster()
+ */
+void TiledRasterData::discardRaster()
+{
+    QMutexLocker locker(&m_data->mutex);
+
+    m_data->columnTable.invalidate();
+    m_data->rowTable.invalidate();
+
+    m_data->selectLevel(0);
+}
+
+/*!
+   \return the value at a raster position
+
+   \param x X value in plot coordinates
+   \param y Y value in plot coordinates
+
+   \sa values()
+ */
+double TiledRasterData::value(double x, double y) const
+{
+    double value;
+    values(x, 0.0, y, 1, &value);
+
+    return value;
+}
+
+/*!
+   \brief Values of a scanline
+
+   The tiles, that are involved, are looked up once for the scanline.
+   Tiles, that have not been mapped by initRaster(), are mapped.
+
+   \param x X value of the first position in plot coordinates
+   \param dx Distance between 2 positions in plot coordinates
+   \param y Y value in plot coordinates
+   \param numValues Number of values
+   \param values Array of at least numValues doubles
+
+   \sa value(), QwtMatrixRasterData::values()
+ */
+void TiledRasterData::values(double x, double dx, double y, int numValues, double *values) const
+{
+    if (numValues <= 0) {
+        return;
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    const TiledRasterFile::Level &geometry = m_data->geometry;
+
+    int first = 0;
+    int last = numValues;
+
+    if ((geometry.numRows <= 0) || (m_data->dx <= 0.0) || (m_data->dy <= 0.0) || !yInterval.contains(y)) {
+        last = 0;
+    } else {
+        // the positions are monotonic, so the valid ones are a single range
+        while ((first < last) && !xInterval.contains(x + first * dx)) {
+            first++;
+        }
+
+        while ((last > first) && !xInterval.contains(x + (last - 1) * dx)) {
+            last--;
+        }
+    }
+
+    for (int i = 0; i < first; i++) {
+        values[i] = qQNaN();
+    }
+
+    for (int i = last; i < numValues; i++) {
+        values[i] = qQNaN();
+    }
+
+    if (first >= last) {
+        return;
+    }
+
+    x += first * dx;
+    values += first;
+    numValues = last - first;
+
+    const QwtMatrixRasterData::ResampleMode mode = m_data->resampleMode;
+
+    // taps of the row and the columns, nearest neighbour is a single tap
+
+    int rows[4];
+    double wy[4];
+    int numRowTaps = 1;
+
+    QwtResampleTable localTable;
+    const QwtResampleTable *table = nullptr;
+    int firstColumn = 0;
+
+    QVarLengthArray<int, 1024> columns;
+
+    if (mode == QwtMatrixRasterData::NearestNeighbour) {
+        rows[0] = qMin(int((y - yInterval.minValue()) / m_data->dy), geometry.numRows - 1);
+        wy[0] = 1.0;
+
+        columns.resize(numValues);
+        for (int i = 0; i < numValues; i++) {
+            const int col = int((x + i * dx - xInterval.minValue()) / m_data->dx);
+            columns[i] = qBound(0, col, geometry.numColumns - 1);
+        }
+    } else {
+        const int rowIndex = m_data->rowTable.find(y);
+        if (rowIndex >= 0) {
+            numRowTaps = m_data->rowTable.numTaps;
+            for (int k = 0; k < numRowTaps; k++) {
+                rows[k] = m_data->rowTable.indexes[k][rowIndex];
+                wy[k] = m_data->rowTable.weights[k][rowIndex];
+            }
+        } else {
+            const double yy = qBound(yInterval.minValue(), y, yInterval.maxValue());
+            numRowTaps = qwtResampleTaps(mode, yy, yInterval.minValue(), m_data->dy, geometry.numRows, rows, wy);
+        }
+
+        table = &m_data->columnTable;
+
+        firstColumn = table->find(x, dx);
+        if ((firstColumn < 0) || (firstColumn + numValues > table->count)) {
+            localTable.init(mode, x, dx, numValues, xInterval, m_data->dx, geometry.numColumns);
+
+            table = &localTable;
+            firstColumn = 0;
+        }
+    }
+
+    const int numTaps = table ? table->numTaps : 1;
+
+    const int *colIndexes[4] = {nullptr, nullptr, nullptr, nullptr};
+    const double *colWeights[4] = {nullptr, nullptr, nullptr, nullptr};
+
+    if (table) {
+        for (int j = 0; j < numTaps; j++) {
+            colIndexes[j] = table->indexes[j].constData() + firstColumn;
+            colWeights[j] = table->weights[j].constData() + firstColumn;
+        }
+    } else {
+        colIndexes[0] = columns.constData();
+    }
+
+    // the positions are monotonic and so are the indexes of each tap
+
+    const int colMin = qMin(colIndexes[0][0], colIndexes[0][numValues - 1]);
+    const int colMax = qMax(colIndexes[numTaps - 1][0], colIndexes[numTaps - 1][numValues - 1]);
+
+    const int shift = m_data->tileShift;
+    const int mask = m_data->tileMask;
+
+    const int tileCol0 = colMin >> shift;
+    const int numTileColumns = (colMax >> shift) - tileCol0 + 1;
+
+    // the lines of the tiles for each row tap
+
+    QVarLengthArray<const float *, 64> lines(numRowTaps * numTileColumns);
+
+    {
+        QMutexLocker locker(&m_data->mutex);
+
+        for (int k = 0; k < numRowTaps; k++) {
+            const int tileRow = rows[k] >> shift;
+            const int offset = (rows[k] & mask) << shift;
+
+            for (int tc = 0; tc < numTileColumns; tc++) {
+                const float *tile = m_data->tile(tileRow * geometry.numTileColumns + tileCol0 + tc);
+                lines[k * numTileColumns + tc] = tile ? tile + offset : nullptr;
+            }
+        }
+    }
+
+    for (int i = 0; i < numValues; i++) {
+        double v = 0.0;
+
+        for (int j = 0; j < numTaps; j++) {
+            const int col = colIndexes[j][i];
+            const int tc = (col >> shift) - tileCol0;
+
+            double vc = 0.0;
+            for (int k = 0; k < numRowTaps; k++) {
+                const float *line = lines[k * numTileColumns + tc];
+                vc += wy[k] * (line ? double(line[col & mask]) : qQNaN());
+            }
+
+            v += (table ? colWeights[j][i] : 1.0) * vc;
+        }
+
+        values[i] = v;
+    }
+}
@@ -0,0 +1,61 @@
+﻿#ifndef TILED_RASTER_DATA_H
+#define TILED_RASTER_DATA_H
+
+#include "rasterdata.h"
+
+class QString;
+
+/*!
+   \brief Raster data, that is read from a tiled raster file
+
+   TiledRasterData resamples the values of a TiledRasterFile like
+   QwtMatrixRasterData, without loading the file into memory.
+
+   initRaster() selects the coarsest level of the file, whose cells are
+   not larger than a pixel of the raster, and maps only the tiles of this
+   level, that intersect the area of the raster. The tiles are paged in by
+   the operating system, when they are resampled. Tiles without valid
+   values ( see TiledRasterFile::tileRange() ) are never mapped.
+
+   Tiles outside of the area are mapped on demand and all tiles are
+   unmapped by discardRaster().
+
+   \sa TiledRasterFile, QwtMatrixRasterData
+ */
+class TiledRasterData : public RasterData
+{
+public:
+    TiledRasterData();
+    virtual ~TiledRasterData();
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool isOpen() const;
+
+    void setResampleMode(QwtMatrixRasterData::ResampleMode mode);
+    QwtMatrixRasterData::ResampleMode resampleMode() const;
+
+    void setInterval(Qt::Axis, const Interval &);
+    virtual Interval interval(Qt::Axis axis) const override final;
+
+    int numColumns() const;
+    int numRows() const;
+
+    int level() const;
+    int numMappedTiles() const;
+
+    virtual QRectF pixelHint(const QRectF &) const override;
+
+    virtual void initRaster(const QRectF &, const QSize &raster) override;
+    virtual void discardRaster() override;
+
+    virtual double value(double x, double y) const override;
+    virtual void values(double x, double dx, double y, int numValues, double *values) const override;
+
+private:
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+#endif
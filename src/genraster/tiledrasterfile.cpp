@@ -0,0 +1,537 @@
+﻿#include "tiledrasterfile.h"
+
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include <qnumeric.h>
+
+#include <string.h>
+
+#include "interval.h"
+
+static const char qwtTiledMagic[8] = {'G', 'R', 'T', 'I', 'L', 'E', 'S', '1'};
+
+// offsets of the tiles of a level are aligned to pages
+static const qint64 qwtTiledPageSize = 4096;
+
+// ! Header at the beginning of the file
+class QwtTiledHeader
+{
+public:
+    char magic[8];
+    quint32 tileSize;
+    quint32 numColumns;
+    quint32 numRows;
+    quint32 numLevels;
+    quint32 flags;
+
+    // border flags of the X and Y intervals: 2 bits for each axis
+    quint32 borderFlags;
+
+    // minimum and maximum of X, Y and Z
+    double intervals[6];
+};
+
+// ! Entry of the table of levels, following the header
+class QwtTiledLevel
+{
+public:
+    quint32 numColumns;
+    quint32 numRows;
+    quint32 numTileColumns;
+    quint32 numTileRows;
+    quint64 tilesOffset;
+    quint64 rangesOffset;
+};
+
+static inline qint64 qwtAlign(qint64 offset, qint64 alignment)
+{
+    return (offset + alignment - 1) / alignment * alignment;
+}
+
+static inline bool qwtWrite(QFile &file, const void *data, qint64 size)
+{
+    return file.write(static_cast<const char *>(data), size) == size;
+}
+
+static inline bool qwtIsPowerOf2(int value)
+{
+    return (value > 0) && ((value & (value - 1)) == 0);
+}
+
+/*
+    Overview of a matrix: each value is the mean of the valid
+    values of 2x2 values
+ */
+static void qwtReduce(const float *values, int numColumns, int numRows, QVector<float> &reduced)
+{
+    const int numReducedColumns = (numColumns + 1) / 2;
+    const int numReducedRows = (numRows + 1) / 2;
+
+    reduced.resize(numReducedColumns * numReducedRows);
+
+    for (int row = 0; row < numReducedRows; row++) {
+        const float *line0 = values + qint64(2 * row) * numColumns;
+        const float *line1 = values + qint64(qMin(2 * row + 1, numRows - 1)) * numColumns;
+
+        for (int col = 0; col < numReducedColumns; col++) {
+            const int c0 = 2 * col;
+            const int c1 = qMin(c0 + 1, numColumns - 1);
+
+            const float v[4] = {line0[c0], line0[c1], line1[c0], line1[c1]};
+
+            float sum = 0.0f;
+            int count = 0;
+
+            for (int i = 0; i < 4; i++) {
+                if (!qIsNaN(v[i])) {
+                    sum += v[i];
+                    count++;
+                }
+            }
+
+            reduced[row * numReducedColumns + col] = (count > 0) ? sum / count : qQNaN();
+        }
+    }
+}
+
+class TiledRasterFile::PrivateData
+{
+public:
+    PrivateData() { memset(&header, 0, sizeof(header)); }
+
+    inline qint64 tileBytes() const { return qint64(header.tileSize) * header.tileSize * sizeof(float); }
+
+    QFile file;
+
+    QwtTiledHeader header;
+    QVector<QwtTiledLevel> levels;
+
+    // minimum and maximum of each tile for each level
+    QVector<QVector<float>> ranges;
+};
+
+// ! Constructor
+TiledRasterFile::TiledRasterFile()
+{
+    m_data = new PrivateData();
+}
+
+// ! Destructor
+TiledRasterFile::~TiledRasterFile()
+{
+    close();
+    delete m_data;
+}
+
+/*!
+   \brief Open a file
+
+   Reads the header, the table of levels and the ranges of the tiles.
+   The tiles are not read, but mapped by mapTile().
+
+   \param fileName Name of a file, that has been created by write()
+   \return true, when the file is a valid tiled raster file
+   \sa close(), mapTile()
+ */
+bool TiledRasterFile::open(const QString &fileName)
+{
+    close();
+
+    QFile &file = m_data->file;
+    file.setFileName(fileName);
+
+    if (!file.open(QFile::ReadOnly)) {
+        return false;
+    }
+
+    QwtTiledHeader &header = m_data->header;
+
+    bool ok = (file.read(reinterpret_cast<char *>(&header), sizeof(header)) == qint64(sizeof(header)));
+    ok = ok && (memcmp(header.magic, qwtTiledMagic, sizeof(qwtTiledMagic)) == 0);
+    ok = ok && qwtIsPowerOf2(int(header.tileSize)) && (header.numLevels > 0) && (header.numLevels <= 32);
+
+    if (ok) {
+        m_data->levels.resize(int(header.numLevels));
+
+        const qint64 size = qint64(header.numLevels) * sizeof(QwtTiledLevel);
+        ok = (file.read(reinterpret_cast<char *>(m_data->levels.data()), size) == size);
+    }
+
+    const qint64 fileSize = file.size();
+
+    for (int i = 0; ok && (i < m_data->levels.size()); i++) {
+        const QwtTiledLevel &level = m_data->levels[i];
+        const qint64 numTiles = qint64(level.numTileColumns) * level.numTileRows;
+
+        ok = (level.numTileColumns == (level.numColumns + header.tileSize - 1) / header.tileSize) &&
+             (level.numTileRows == (level.numRows + header.tileSize - 1) / header.tileSize) &&
+             (qint64(level.tilesOffset) + numTiles * m_data->tileBytes() <= fileSize);
+
+        QVector<float> ranges;
+        if (ok && (header.flags & TileRanges)) {
+            ranges.resize(int(2 * numTiles));
+
+            const qint64 size = ranges.size() * sizeof(float);
+            ok = file.seek(qint64(level.rangesOffset)) &&
+                 (file.read(reinterpret_cast<char *>(ranges.data()), size) == size);
+        }
+
+        m_data->ranges += ranges;
+    }
+
+    if (!ok) {
+        close();
+    }
+
+    return ok;
+}
+
+/*!
+   \brief Close the file
+
+   Tiles, that have been mapped, are invalid afterwards.
+   \sa open()
+ */
+void TiledRasterFile::close()
+{
+    m_data->file.close();
+
+    memset(&m_data->header, 0, sizeof(m_data->header));
+    m_data->levels.clear();
+    m_data->ranges.clear();
+}
+
+/*!
+   \return true, when a file has been opened successfully
+   \sa open()
+ */
+bool TiledRasterFile::isOpen() const
+{
+    return !m_data->levels.isEmpty();
+}
+
+/*!
+   \return Number of values of the side of a tile, a power of 2
+ */
+int TiledRasterFile::tileSize() const
+{
+    return int(m_data->header.tileSize);
+}
+
+/*!
+   \return Flags of the file
+   \sa Flag
+ */
+int TiledRasterFile::flags() const
+{
+    return int(m_data->header.flags);
+}
+
+/*!
+   \return Number of levels, including the matrix
+   \sa level()
+ */
+int TiledRasterFile::numLevels() const
+{
+    return m_data->levels.size();
+}
+
+/*!
+   \param level Level, 0 is the matrix
+   \return Geometry of the level
+ */
+TiledRasterFile::Level TiledRasterFile::level(int level) const
+{
+    Level l;
+
+    if ((level >= 0) && (level < m_data->levels.size())) {
+        const QwtTiledLevel &tl = m_data->levels[level];
+
+        l.numColumns = int(tl.numColumns);
+        l.numRows = int(tl.numRows);
+        l.numTileColumns = int(tl.numTileColumns);
+        l.numTileRows = int(tl.numTileRows);
+    }
+
+    return l;
+}
+
+/*!
+   \return Bounding interval for an axis. The interval of the Z axis
+           is the range of the valid values of the matrix.
+ */
+Interval TiledRasterFile::interval(Qt::Axis axis) const
+{
+    if (isOpen() && (axis >= 0) && (axis <= 2)) {
+        const double *intervals = m_data->header.intervals;
+        const int borderFlags = (m_data->header.borderFlags >> (2 * axis)) & 0x03;
+
+        return Interval(intervals[2 * axis], intervals[2 * axis + 1], static_cast<Interval::BorderFlag>(borderFlags));
+    }
+
+    return Interval();
+}
+
+/*!
+   \brief Range of the values of a tile
+
+   \param level Level
+   \param tileIndex Index of the tile: tileRow * numTileColumns + tileColumn
+
+   \return Minimum and maximum of the valid values of the tile, an invalid
+           interval for a tile without valid values. Without TileRanges
+           the interval of the Z axis is returned for all tiles.
+ */
+Interval TiledRasterFile::tileRange(int level, int tileIndex) const
+{
+    if ((level < 0) || (level >= m_data->ranges.size())) {
+        return Interval();
+    }
+
+    const QVector<float> &ranges = m_data->ranges[level];
+    if (ranges.isEmpty()) {
+        return interval(Qt::ZAxis);
+    }
+
+    if ((tileIndex < 0) || (2 * tileIndex >= ranges.size())) {
+        return Interval();
+    }
+
+    return Interval(ranges[2 * tileIndex], ranges[2 * tileIndex + 1]);
+}
+
+/*!
+   \brief Map a tile into memory
+
+   The values of the tile are paged in by the operating system, when
+   they are accessed.
+
+   \param level Level
+   \param tileIndex Index of the tile: tileRow * numTileColumns + tileColumn
+
+   \return tileSize() x tileSize() values row by row, or nullptr on failure
+   \sa unmapTile()
+ */
+const float *TiledRasterFile::mapTile(int level, int tileIndex)
+{
+    if ((level < 0) || (level >= m_data->levels.size())) {
+        return nullptr;
+    }
+
+    const QwtTiledLevel &l = m_data->levels[level];
+    if ((tileIndex < 0) || (tileIndex >= int(l.numTileColumns * l.numTileRows))) {
+        return nullptr;
+    }
+
+    const qint64 offset = qint64(l.tilesOffset) + tileIndex * m_data->tileBytes();
+    return reinterpret_cast<const float *>(m_data->file.map(offset, m_data->tileBytes()));
+}
+
+/*!
+   \brief Unmap a tile, that has been mapped by mapTile()
+   \param tile Values of the tile
+ */
+void TiledRasterFile::unmapTile(const float *tile)
+{
+    if (tile) {
+        m_data->file.unmap(reinterpret_cast<uchar *>(const_cast<float *>(tile)));
+    }
+}
+
+/*!
+   \brief Write a matrix to a tiled raster file
+
+   \param fileName Name of the file
+   \param values numColumns x numRows values row by row, NaN values are gaps
+   \param numColumns Number of columns
+   \param numRows Number of rows
+   \param xInterval Bounding interval of the columns
+   \param yInterval Bounding interval of the rows
+   \param tileSize Side of a tile, rounded up to a power of 2 in [16, 4096]
+   \param flags Flags of the file
+
+   \return true on success
+ */
+bool TiledRasterFile::write(const QString &fileName, const float *values, int numColumns, int numRows,
+                            const Interval &xInterval, const Interval &yInterval, int tileSize, int flags)
+{
+    if ((values == nullptr) || (numColumns <= 0) || (numRows <= 0)) {
+        return false;
+    }
+
+    int size = 16;
+    while ((size < tileSize) && (size < 4096)) {
+        size *= 2;
+    }
+    tileSize = size;
+
+    const qint64 tileBytes = qint64(tileSize) * tileSize * sizeof(float);
+
+    // layout of the levels
+
+    QVector<QwtTiledLevel> levels;
+
+    qint64 offset = sizeof(QwtTiledHeader);
+
+    int cols = numColumns;
+    int rows = numRows;
+
+    while (true) {
+        QwtTiledLevel level;
+        level.numColumns = quint32(cols);
+        level.numRows = quint32(rows);
+        level.numTileColumns = quint32((cols + tileSize - 1) / tileSize);
+        level.numTileRows = quint32((rows + tileSize - 1) / tileSize);
+        level.tilesOffset = 0;
+        level.rangesOffset = 0;
+
+        levels += level;
+
+        if ((cols <= tileSize) && (rows <= tileSize)) {
+            break;
+        }
+
+        cols = (cols + 1) / 2;
+        rows = (rows + 1) / 2;
+    }
+
+    offset += levels.size() * sizeof(QwtTiledLevel);
+
+    for (int i = 0; i < levels.size(); i++) {
+        QwtTiledLevel &level = levels[i];
+        const qint64 numTiles = qint64(level.numTileColumns) * level.numTileRows;
+
+        if (flags & TileRanges) {
+            level.rangesOffset = quint64(offset);
+            offset += 2 * numTiles * sizeof(float);
+        }
+
+        level.tilesOffset = quint64(qwtAlign(offset, qwtTiledPageSize));
+        offset = qint64(level.tilesOffset) + numTiles * tileBytes;
+    }
+
+    // header
+
+    QwtTiledHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, qwtTiledMagic, sizeof(qwtTiledMagic));
+
+    header.tileSize = quint32(tileSize);
+    header.numColumns = quint32(numColumns);
+    header.numRows = quint32(numRows);
+    header.numLevels = quint32(levels.size());
+    header.flags = quint32(flags);
+    header.borderFlags = quint32(xInterval.borderFlags()) | (quint32(yInterval.borderFlags()) << 2);
+
+    header.intervals[0] = xInterval.minValue();
+    header.intervals[1] = xInterval.maxValue();
+    header.intervals[2] = yInterval.minValue();
+    header.intervals[3] = yInterval.maxValue();
+    header.intervals[4] = qQNaN();
+    header.intervals[5] = qQNaN();
+
+    const qint64 numValues = qint64(numColumns) * numRows;
+    for (qint64 i = 0; i < numValues; i++) {
+        const double v = values[i];
+        if (!qIsNaN(v)) {
+            if (qIsNaN(header.intervals[4]) || (v < header.intervals[4])) {
+                header.intervals[4] = v;
+            }
+            if (qIsNaN(header.intervals[5]) || (v > header.intervals[5])) {
+                header.intervals[5] = v;
+            }
+        }
+    }
+
+    QFile file(fileName);
+    if (!file.open(QFile::WriteOnly | QFile::Truncate)) {
+        return false;
+    }
+
+    bool ok = qwtWrite(file, &header, sizeof(header)) &&
+              qwtWrite(file, levels.constData(), levels.size() * sizeof(QwtTiledLevel));
+
+    QVector<float> tile(tileSize * tileSize);
+    QVector<float> overview;
+
+    const float *levelValues = values;
+
+    for (int i = 0; ok && (i < levels.size()); i++) {
+        const QwtTiledLevel &level = levels[i];
+
+        const int levelColumns = int(level.numColumns);
+        const int levelRows = int(level.numRows);
+
+        if (i > 0) {
+            QVector<float> reduced;
+            qwtReduce(levelValues, int(levels[i - 1].numColumns), int(levels[i - 1].numRows), reduced);
+
+            overview.swap(reduced);
+            levelValues = overview.constData();
+        }
+
+        if (flags & TileRanges) {
+            QVector<float> ranges;
+
+            for (int tileRow = 0; tileRow < int(level.numTileRows); tileRow++) {
+                for (int tileCol = 0; tileCol < int(level.numTileColumns); tileCol++) {
+                    float min = qQNaN();
+                    float max = qQNaN();
+
+                    const int row1 = qMin((tileRow + 1) * tileSize, levelRows);
+                    const int col1 = qMin((tileCol + 1) * tileSize, levelColumns);
+
+                    for (int row = tileRow * tileSize; row < row1; row++) {
+                        for (int col = tileCol * tileSize; col < col1; col++) {
+                            const float v = levelValues[qint64(row) * levelColumns + col];
+                            if (!qIsNaN(v)) {
+                                if (qIsNaN(min) || (v < min)) {
+                                    min = v;
+                                }
+                                if (qIsNaN(max) || (v > max)) {
+                                    max = v;
+                                }
+                            }
+                        }
+                    }
+
+                    ranges += min;
+                    ranges += max;
+                }
+            }
+
+            ok = qwtWrite(file, ranges.constData(), ranges.size() * sizeof(float));
+        }
+
+        // padding up to the page aligned tiles
+        const qint64 padding = qint64(level.tilesOffset) - file.pos();
+        if (ok && (padding > 0)) {
+            const QVector<char> zeros(int(padding), 0);
+            ok = qwtWrite(file, zeros.constData(), padding);
+        }
+
+        for (int tileRow = 0; ok && (tileRow < int(level.numTileRows)); tileRow++) {
+            for (int tileCol = 0; ok && (tileCol < int(level.numTileColumns)); tileCol++) {
+                tile.fill(qQNaN());
+
+                const int row0 = tileRow * tileSize;
+                const int col0 = tileCol * tileSize;
+                const int numTileRows = qMin(tileSize, levelRows - row0);
+                const int numTileColumns = qMin(tileSize, levelColumns - col0);
+
+                for (int row = 0; row < numTileRows; row++) {
+                    memcpy(tile.data() + row * tileSize, levelValues + qint64(row0 + row) * levelColumns + col0,
+                           numTileColumns * sizeof(float));
+                }
+
+                ok = qwtWrite(file, tile.constData(), tileBytes);
+            }
+        }
+    }
+
+    file.close();
+
+    return ok;
+}
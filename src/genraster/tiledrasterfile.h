@@ -0,0 +1,98 @@
+﻿#ifndef TILED_RASTER_FILE_H
+#define TILED_RASTER_FILE_H
+
+#include <qnamespace.h>
+
+class Interval;
+class QString;
+
+/*!
+   \brief A file of float values stored in square tiles
+
+   The format stores a matrix of float values and overviews of it in
+   fixed size tiles, that can be memory mapped individually:
+
+   - A header of 80 bytes: the magic "GRTILES1", the tile size,
+     the number of columns and rows of the matrix, the number of levels,
+     the flags, the border flags of the X and Y intervals and the
+     X, Y and Z intervals as 6 doubles.
+   - A table of 32 bytes for each level: its number of columns, rows,
+     tile columns and tile rows, the offset of its tiles and the offset
+     of the ranges of its tiles.
+   - For each level the minimum and maximum of each tile as 2 floats,
+     when the file has been written with TileRanges.
+   - For each level the tiles row by row, starting at a page aligned offset.
+     Each tile has tileSize() x tileSize() values, values of the tiles at
+     the right and bottom border, that are outside of the matrix, are NaN.
+
+   Level 0 is the matrix, each following level is an overview, where each
+   value is the mean of the valid values of 2x2 values of the previous
+   level. The last level fits into a single tile.
+
+   All numbers are stored in the byte order of the machine, that has
+   written the file.
+
+   \sa TiledRasterData
+ */
+class TiledRasterFile
+{
+public:
+    // ! Flags of the file
+    enum Flag
+    {
+        // ! The minimum and maximum of each tile are stored
+        TileRanges = 0x01
+    };
+
+    // ! Geometry of a level
+    class Level
+    {
+    public:
+        Level() : numColumns(0), numRows(0), numTileColumns(0), numTileRows(0) {}
+
+        // ! Number of columns of the matrix of the level
+        int numColumns;
+
+        // ! Number of rows of the matrix of the level
+        int numRows;
+
+        // ! Number of horizontal tiles
+        int numTileColumns;
+
+        // ! Number of vertical tiles
+        int numTileRows;
+    };
+
+    TiledRasterFile();
+    ~TiledRasterFile();
+
+    bool open(const QString &fileName);
+    void close();
+
+    bool isOpen() const;
+
+    int tileSize() const;
+    int flags() const;
+
+    int numLevels() const;
+    Level level(int level) const;
+
+    Interval interval(Qt::Axis) const;
+
+    Interval tileRange(int level, int tileIndex) const;
+
+    const float *mapTile(int level, int tileIndex);
+    void unmapTile(const float *tile);
+
+    static bool write(const QString &fileName, const float *values, int numColumns, int numRows,
+                      const Interval &xInterval, const Interval &yInterval, int tileSize = 256,
+                      int flags = TileRanges);
+
+private:
+    Q_DISABLE_COPY(TiledRasterFile)
+
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+#endif
@@ -0,0 +1,249 @@
+﻿#include "tilescheduler.h"
+
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QRunnable>
+#include <QScopedPointer>
+#include <QSharedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QWaitCondition>
+
+namespace
+{
+
+/*
+    The tiles of a single run() call. It is shared between the caller
+    and the runnables, because runnables, that are started after all
+    tiles have been processed, might outlive the call.
+ */
+class TileJob
+{
+public:
+    TileJob(const QVector<QRect> &tiles, int numWorkers, const TileScheduler::TileFunction &function) :
+        m_tiles(tiles), m_function(function), m_numDone(0), m_numWorkers(numWorkers), m_queues(new Queue[numWorkers]),
+        m_timings(numWorkers)
+    {
+        // distribute the tiles round robin, so that each worker
+        // starts with tiles from all over the image
+
+        for (int i = 0; i < m_tiles.size(); i++) {
+            m_queues[i % numWorkers].tiles += i;
+        }
+
+        for (int w = 0; w < numWorkers; w++) {
+            m_queues[w].head = 0;
+            m_queues[w].tail = m_queues[w].tiles.size();
+        }
+    }
+
+    void work(int worker)
+    {
+        QElapsedTimer timer;
+
+        int index;
+        while ((index = takeTile(worker)) >= 0) {
+            timer.start();
+            m_function(m_tiles[index]);
+
+            TileScheduler::TileTiming timing;
+            timing.tile = m_tiles[index];
+            timing.worker = worker;
+            timing.nsecs = timer.nsecsElapsed();
+
+            m_timings[worker] += timing;
+
+            QMutexLocker locker(&m_doneMutex);
+            if (++m_numDone == m_tiles.size()) {
+                m_doneCondition.wakeAll();
+            }
+        }
+    }
+
+    void waitForDone()
+    {
+        QMutexLocker locker(&m_doneMutex);
+        while (m_numDone < m_tiles.size()) {
+            m_doneCondition.wait(&m_doneMutex);
+        }
+    }
+
+    QVector<TileScheduler::TileTiming> timings() const
+    {
+        QVector<TileScheduler::TileTiming> timings;
+        timings.reserve(m_tiles.size());
+
+        for (int w = 0; w < m_timings.size(); w++) {
+            timings += m_timings[w];
+        }
+
+        return timings;
+    }
+
+private:
+    int takeTile(int worker)
+    {
+        // own tiles are taken from the front ...
+        {
+            Queue &queue = m_queues[worker];
+
+            QMutexLocker locker(&queue.mutex);
+            if (queue.head < queue.tail) {
+                return queue.tiles[queue.head++];
+            }
+        }
+
+        // ... while tiles of other workers are stolen from the back
+
+        for (int i = 1; i < m_numWorkers; i++) {
+            Queue &queue = m_queues[(worker + i) % m_numWorkers];
+
+            QMutexLocker locker(&queue.mutex);
+            if (queue.head < queue.tail) {
+                return queue.tiles[--queue.tail];
+            }
+        }
+
+        return -1;
+    }
+
+    struct Queue
+    {
+        QMutex mutex;
+        QVector<int> tiles;
+        int head;
+        int tail;
+    };
+
+    const QVector<QRect> m_tiles;
+    const TileScheduler::TileFunction m_function;
+
+    QMutex m_doneMutex;
+    QWaitCondition m_doneCondition;
+    int m_numDone;
+
+    const int m_numWorkers;
+    QScopedArrayPointer<Queue> m_queues;
+    QVector<QVector<TileScheduler::TileTiming>> m_timings;
+};
+
+class TileRunnable : public QRunnable
+{
+public:
+    TileRunnable(const QSharedPointer<TileJob> &job, int worker) : m_job(job), m_worker(worker) {}
+
+    virtual void run() override { m_job->work(m_worker); }
+
+private:
+    QSharedPointer<TileJob> m_job;
+    const int m_worker;
+};
+
+} // namespace
+
+class TileScheduler::PrivateData
+{
+public:
+    QThreadPool pool;
+};
+
+/*!
+   Constructor
+
+   \param maxThreadCount Maximum number of threads of the pool.
+                         A value <= 0 means QThread::idealThreadCount()
+ */
+TileScheduler::TileScheduler(int maxThreadCount)
+{
+    if (maxThreadCount <= 0) {
+        maxThreadCount = QThread::idealThreadCount();
+    }
+
+    m_data = new PrivateData();
+
+    // the threads are kept alive for the following images
+    m_data->pool.setExpiryTimeout(-1);
+    m_data->pool.setMaxThreadCount(qMax(maxThreadCount, 1));
+}
+
+// ! Destructor
+TileScheduler::~TileScheduler()
+{
+    m_data->pool.waitForDone();
+    delete m_data;
+}
+
+/*!
+   \return Scheduler shared by all raster items
+ */
+TileScheduler *TileScheduler::instance()
+{
+    static TileScheduler scheduler;
+    return &scheduler;
+}
+
+/*!
+   \return Maximum number of threads of the pool
+ */
+int TileScheduler::maxThreadCount() const
+{
+    return m_data->pool.maxThreadCount();
+}
+
+/*!
+   \return Default tile size, small enough to balance the load,
+           but large enough to keep the overhead per tile low
+ */
+QSize TileScheduler::defaultTileSize()
+{
+    return QSize(128, 32);
+}
+
+/*!
+   \brief Process an area in tiles
+
+   \param size Size of the area, f.e. the size of an image
+   \param tileSize Maximum size of a tile. An invalid size means defaultTileSize()
+   \param numThreads Number of threads including the calling thread,
+                     0 means QThread::idealThreadCount()
+   \param function Function, that is called for each tile. It has to be
+                   thread safe for different tiles.
+
+   \return Timings of all tiles
+ */
+QVector<TileScheduler::TileTiming> TileScheduler::run(const QSize &size, const QSize &tileSize, uint numThreads,
+                                                      const TileFunction &function) const
+{
+    if (size.isEmpty()) {
+        return QVector<TileTiming>();
+    }
+
+    QSize ts = tileSize;
+    if (ts.isEmpty()) {
+        ts = defaultTileSize();
+    }
+
+    QVector<QRect> tiles;
+    for (int y = 0; y < size.height(); y += ts.height()) {
+        for (int x = 0; x < size.width(); x += ts.width()) {
+            tiles += QRect(x, y, qMin(ts.width(), size.width() - x), qMin(ts.height(), size.height() - y));
+        }
+    }
+
+    if (numThreads <= 0) {
+        numThreads = QThread::idealThreadCount();
+    }
+
+    const int numWorkers = qBound(1, int(numThreads), tiles.size());
+
+    QSharedPointer<TileJob> job(new TileJob(tiles, numWorkers, function));
+
+    for (int w = 1; w < numWorkers; w++) {
+        m_data->pool.start(new TileRunnable(job, w));
+    }
+
+    job->work(0);
+    job->waitForDone();
+
+    return job->timings();
+}
@@ -0,0 +1,63 @@
+﻿#ifndef TILE_SCHEDULER_H
+#define TILE_SCHEDULER_H
+
+#include <QRect>
+#include <QVector>
+
+#include <functional>
+
+/*!
+   \brief A scheduler for rendering an image in tiles
+
+   The image is divided into small 2D tiles, that are processed by a
+   persistent pool of worker threads. The tiles are distributed to the
+   workers in advance. A worker, that has finished its own tiles, steals
+   tiles from the others, so that areas of uneven cost ( f.e. gaps or
+   values out of range ) don't leave threads idle.
+
+   The calling thread takes part in the work and run() returns,
+   when all tiles have been processed.
+
+   \sa PlotRasterItemBase::setRenderThreadCount()
+ */
+class TileScheduler
+{
+public:
+    // ! Timing of a processed tile
+    class TileTiming
+    {
+    public:
+        TileTiming() : worker(-1), nsecs(0) {}
+
+        // ! Geometry of the tile
+        QRect tile;
+
+        // ! Index of the worker, 0 is the calling thread
+        int worker;
+
+        // ! Time for processing the tile in nanoseconds
+        qint64 nsecs;
+    };
+
+    typedef std::function<void(const QRect &)> TileFunction;
+
+    explicit TileScheduler(int maxThreadCount = 0);
+    ~TileScheduler();
+
+    static TileScheduler *instance();
+
+    int maxThreadCount() const;
+
+    QVector<TileTiming> run(const QSize &size, const QSize &tileSize, uint numThreads,
+                            const TileFunction &function) const;
+
+    static QSize defaultTileSize();
+
+private:
+    Q_DISABLE_COPY(TileScheduler)
+
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+#endif
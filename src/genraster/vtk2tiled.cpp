@@ -0,0 +1,123 @@
+﻿#include <QString>
+#include <QVector>
+
+#include <vtkDataArray.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+#include <vtkStructuredPoints.h>
+#include <vtkStructuredPointsReader.h>
+
+#include <cstdlib>
+#include <iostream>
+
+#include "interval.h"
+#include "tiledrasterfile.h"
+
+/*
+    Converts a slice of a legacy .vtk structured points file
+    into a tiled raster file:
+
+        vtk2tiled input.vtk output.grt [x|y|z] [index] [tileSize]
+
+    The slice is perpendicular to the axis ( default z ) at the index
+    of a point ( default 0 ). Its columns and rows are the other axes in
+    the order x, y, z. Only the first component of the scalars is converted.
+ */
+
+template <typename T>
+static void qwtExtractSlice(const T *data, int numComponents, const int dims[3], int axis, int index,
+                            QVector<float> &values)
+{
+    const int colAxis = (axis == 0) ? 1 : 0;
+    const int rowAxis = (axis == 2) ? 1 : 2;
+
+    const qint64 strides[3] = {1, dims[0], qint64(dims[0]) * dims[1]};
+
+    values.resize(dims[colAxis] * dims[rowAxis]);
+    float *v = values.data();
+
+    for (int row = 0; row < dims[rowAxis]; row++) {
+        for (int col = 0; col < dims[colAxis]; col++) {
+            const qint64 tuple = index * strides[axis] + row * strides[rowAxis] + col * strides[colAxis];
+            *v++ = float(data[tuple * numComponents]);
+        }
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " input.vtk output.grt [x|y|z] [index] [tileSize]" << std::endl;
+        return 1;
+    }
+
+    int axis = 2;
+    if (argc > 3) {
+        const QString axisName(argv[3]);
+        if (axisName == "x") {
+            axis = 0;
+        } else if (axisName == "y") {
+            axis = 1;
+        } else if (axisName != "z") {
+            std::cerr << "Invalid axis: " << argv[3] << std::endl;
+            return 1;
+        }
+    }
+
+    const int index = (argc > 4) ? atoi(argv[4]) : 0;
+    const int tileSize = (argc > 5) ? atoi(argv[5]) : 256;
+
+    vtkSmartPointer<vtkStructuredPointsReader> reader = vtkSmartPointer<vtkStructuredPointsReader>::New();
+    reader->SetFileName(argv[1]);
+    reader->Update();
+
+    vtkStructuredPoints *points = reader->GetOutput();
+    vtkDataArray *scalars = points ? points->GetPointData()->GetScalars() : nullptr;
+
+    if (scalars == nullptr) {
+        std::cerr << "No scalar data found in " << argv[1] << std::endl;
+        return 1;
+    }
+
+    int dims[3];
+    double origin[3];
+    double spacing[3];
+
+    points->GetDimensions(dims);
+    points->GetOrigin(origin);
+    points->GetSpacing(spacing);
+
+    if ((index < 0) || (index >= dims[axis])) {
+        std::cerr << "Index " << index << " out of range [0, " << dims[axis] - 1 << "]" << std::endl;
+        return 1;
+    }
+
+    QVector<float> values;
+
+    switch (scalars->GetDataType()) {
+        vtkTemplateMacro(qwtExtractSlice(static_cast<const VTK_TT *>(scalars->GetVoidPointer(0)),
+                                         scalars->GetNumberOfComponents(), dims, axis, index, values));
+    default :
+        std::cerr << "Unsupported scalar type" << std::endl;
+        return 1;
+    }
+
+    const int colAxis = (axis == 0) ? 1 : 0;
+    const int rowAxis = (axis == 2) ? 1 : 2;
+
+    // each value is the center of a pixel
+    const Interval xInterval(origin[colAxis] - 0.5 * spacing[colAxis],
+                             origin[colAxis] + (dims[colAxis] - 0.5) * spacing[colAxis], Interval::ExcludeMaximum);
+    const Interval yInterval(origin[rowAxis] - 0.5 * spacing[rowAxis],
+                             origin[rowAxis] + (dims[rowAxis] - 0.5) * spacing[rowAxis], Interval::ExcludeMaximum);
+
+    if (!TiledRasterFile::write(argv[2], values.constData(), dims[colAxis], dims[rowAxis], xInterval, yInterval,
+                                tileSize)) {
+        std::cerr << "Writing " << argv[2] << " failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << "Wrote " << dims[colAxis] << "x" << dims[rowAxis] << " values to " << argv[2] << std::endl;
+
+    return 0;
+}
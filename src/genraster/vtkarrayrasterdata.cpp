@@ -0,0 +1,450 @@
+﻿#include "vtkarrayrasterdata.h"
+
+#include <QRectF>
+#include <QSize>
+
+#include <qnumeric.h>
+
+#include <vtkDataArray.h>
+#include <vtkImageData.h>
+#include <vtkPointData.h>
+#include <vtkSmartPointer.h>
+
+#include "interval.h"
+#include "matrixresampler.h"
+
+class VtkArrayRasterData::PrivateData
+{
+public:
+    PrivateData() :
+        resampleMode(QwtMatrixRasterData::NearestNeighbour), pointer(nullptr), dataType(VTK_VOID), component(0),
+        numComponents(1), numColumns(0), numRows(0), dx(0.0), dy(0.0)
+    {
+    }
+
+    template <typename T>
+    QwtMatrixView<T> matrix() const
+    {
+        QwtMatrixView<T> m;
+        m.values = static_cast<const T *>(pointer) + component;
+        m.numColumns = numColumns;
+        m.numRows = numRows;
+        m.stride = numComponents;
+        m.dx = dx;
+        m.dy = dy;
+
+        return m;
+    }
+
+    template <typename T>
+    double value(double x, double y) const
+    {
+        return qwtResampleValue(resampleMode, matrix<T>(), intervals[Qt::XAxis], intervals[Qt::YAxis], x, y);
+    }
+
+    template <typename T>
+    void values(double x, double dx, double y, int numValues, double *out) const
+    {
+        if (resampleMode == QwtMatrixRasterData::NearestNeighbour) {
+            qwtNearestNeighbours(matrix<T>(), intervals[Qt::XAxis], intervals[Qt::YAxis], x, dx, y, numValues, out);
+        } else {
+            qwtResampleValues(resampleMode, matrix<T>(), intervals[Qt::XAxis], intervals[Qt::YAxis], columnTable,
+                              rowTable, x, dx, y, numValues, out);
+        }
+    }
+
+    void invalidateTables()
+    {
+        columnTable.invalidate();
+        rowTable.invalidate();
+    }
+
+    Interval intervals[3];
+    QwtMatrixRasterData::ResampleMode resampleMode;
+
+    vtkSmartPointer<vtkDataArray> array;
+
+    // the memory of the array and the type of its values
+    const void *pointer;
+    int dataType;
+
+    int component;
+    int numComponents;
+
+    int numColumns;
+    int numRows;
+
+    double dx;
+    double dy;
+
+    // precalculated in initRaster()
+    QwtResampleTable columnTable;
+    QwtResampleTable rowTable;
+};
+
+// ! Constructor
+VtkArrayRasterData::VtkArrayRasterData()
+{
+    m_data = new PrivateData();
+    update();
+}
+
+// ! Destructor
+VtkArrayRasterData::~VtkArrayRasterData()
+{
+    delete m_data;
+}
+
+/*!
+   \brief Set the resampling algorithm
+
+   \param mode Resampling mode
+   \sa resampleMode(), value()
+ */
+void VtkArrayRasterData::setResampleMode(QwtMatrixRasterData::ResampleMode mode)
+{
+    if (mode != m_data->resampleMode) {
+        m_data->resampleMode = mode;
+        m_data->invalidateTables();
+    }
+}
+
+/*!
+   \return resampling algorithm
+   \sa setResampleMode(), value()
+ */
+QwtMatrixRasterData::ResampleMode VtkArrayRasterData::resampleMode() const
+{
+    return m_data->resampleMode;
+}
+
+/*!
+   \brief Assign the bounding interval for an axis
+
+   Setting the bounding intervals for the X/Y axis is mandatory
+   to define the positions for the values of the array.
+   The interval of the Z axis is initialized from the range of the array
+   by setArray().
+
+   \param axis X, Y or Z axis
+   \param interval Interval
+
+   \sa RasterData::interval(), setArray()
+ */
+void VtkArrayRasterData::setInterval(Qt::Axis axis, const Interval &interval)
+{
+    if ((axis >= 0) && (axis <= 2)) {
+        m_data->intervals[axis] = interval;
+        update();
+    }
+}
+
+/*!
+   \return Bounding interval for an axis
+   \sa setInterval
+ */
+Interval VtkArrayRasterData::interval(Qt::Axis axis) const
+{
+    if ((axis >= 0) && (axis <= 2)) {
+        return m_data->intervals[axis];
+    }
+
+    return Interval();
+}
+
+/*!
+   \brief Assign an array
+
+   The tuples of the array are the rows of a matrix, that are stored
+   one after the other. Like for QwtMatrixRasterData each value
+   corresponds to the center of a pixel of the bounding rectangle
+   of the X/Y intervals.
+
+   The array is referenced, but not copied. Its values must not be modified
+   without calling setArray() again. The interval of the Z axis is set
+   to the range of the component.
+
+   \param array Array of any numeric type
+   \param numColumns Number of columns
+   \param component Component of the tuples, that is resampled
+
+   \sa array(), numColumns(), numRows(), setInterval()
+ */
+void VtkArrayRasterData::setArray(vtkDataArray *array, int numColumns, int component)
+{
+    m_data->array = array;
+    m_data->pointer = nullptr;
+    m_data->dataType = VTK_VOID;
+    m_data->component = 0;
+    m_data->numComponents = 1;
+    m_data->numColumns = qMax(numColumns, 0);
+
+    if (array && (array->GetNumberOfTuples() > 0)) {
+        m_data->pointer = array->GetVoidPointer(0);
+        m_data->dataType = array->GetDataType();
+        m_data->numComponents = array->GetNumberOfComponents();
+        m_data->component = qBound(0, component, m_data->numComponents - 1);
+
+        double range[2];
+        array->GetRange(range, m_data->component);
+
+        m_data->intervals[Qt::ZAxis] = Interval(range[0], range[1]);
+    }
+
+    update();
+}
+
+/*!
+   \brief Assign the point scalars of an image
+
+   The values of the first slice of the image are the matrix. The X/Y
+   intervals are calculated from origin, spacing and extent of the image,
+   so that each point is the center of a pixel.
+
+   \param image Image, f.e. the output of vtkImagePlaneResampler
+   \param component Component of the scalars, that is resampled
+
+   \sa setArray()
+ */
+void VtkArrayRasterData::setImage(vtkImageData *image, int component)
+{
+    vtkDataArray *scalars = image ? image->GetPointData()->GetScalars() : nullptr;
+    if (scalars == nullptr) {
+        setArray(nullptr, 0);
+        return;
+    }
+
+    int extent[6];
+    double origin[3];
+    double spacing[3];
+
+    image->GetExtent(extent);
+    image->GetOrigin(origin);
+    image->GetSpacing(spacing);
+
+    const int numColumns = extent[1] - extent[0] + 1;
+    const int numRows = extent[3] - extent[2] + 1;
+
+    setArray(scalars, numColumns, component);
+
+    const double x0 = origin[0] + extent[0] * spacing[0];
+    const double y0 = origin[1] + extent[2] * spacing[1];
+
+    setInterval(Qt::XAxis,
+                Interval(x0 - 0.5 * spacing[0], x0 + (numColumns - 0.5) * spacing[0], Interval::ExcludeMaximum));
+    setInterval(Qt::YAxis,
+                Interval(y0 - 0.5 * spacing[1], y0 + (numRows - 0.5) * spacing[1], Interval::ExcludeMaximum));
+}
+
+/*!
+   \return Array, that has been assigned by setArray()
+   \sa setArray()
+ */
+vtkDataArray *VtkArrayRasterData::array() const
+{
+    return m_data->array;
+}
+
+/*!
+   \return Component of the tuples, that is resampled
+   \sa setArray()
+ */
+int VtkArrayRasterData::component() const
+{
+    return m_data->component;
+}
+
+/*!
+   \return Number of columns of the matrix
+   \sa numRows(), setArray()
+ */
+int VtkArrayRasterData::numColumns() const
+{
+    return m_data->numColumns;
+}
+
+/*!
+   \return Number of rows of the matrix
+   \sa numColumns(), setArray()
+ */
+int VtkArrayRasterData::numRows() const
+{
+    return m_data->numRows;
+}
+
+/*!
+   \brief Calculate the pixel hint
+
+   \param area Requested area, ignored
+   \return Surrounding pixel of the top left value for NearestNeighbour,
+           otherwise an empty rectangle
+
+   \sa QwtMatrixRasterData::pixelHint()
+ */
+QRectF VtkArrayRasterData::pixelHint(const QRectF &area) const
+{
+    Q_UNUSED(area)
+
+    QRectF rect;
+    if (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) {
+        const Interval intervalX = interval(Qt::XAxis);
+        const Interval intervalY = interval(Qt::YAxis);
+        if (intervalX.isValid() && intervalY.isValid()) {
+            rect = QRectF(intervalX.minValue(), intervalY.minValue(), m_data->dx, m_data->dy);
+        }
+    }
+
+    return rect;
+}
+
+/*!
+   \brief Initialize a raster
+
+   Precalculates the indexes and weights of the interpolating resample modes
+   for the grid of positions of the raster.
+
+   \param area Area of the raster
+   \param raster Number of horizontal and vertical pixels
+
+   \sa discardRaster(), QwtMatrixRasterData::initRaster()
+ */
+void VtkArrayRasterData::initRaster(const QRectF &area, const QSize &raster)
+{
+    m_data->invalidateTables();
+
+    if ((m_data->numRows <= 0) || (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) ||
+        (raster.width() < 2) || (raster.height() < 2)) {
+        return;
+    }
+
+    const double xStep = area.width() / (raster.width() - 1);
+    const double yStep = area.height() / (raster.height() - 1);
+
+    m_data->columnTable.init(m_data->resampleMode, area.left(), xStep, raster.width(), m_data->intervals[Qt::XAxis],
+                             m_data->dx, m_data->numColumns);
+
+    m_data->rowTable.init(m_data->resampleMode, area.top(), yStep, raster.height(), m_data->intervals[Qt::YAxis],
+                          m_data->dy, m_data->numRows);
+}
+
+/*!
+   \brief Discard a raster
+
+   Releases the tables calculated in initRaster()
+   \sa initRaster()
+ */
+void VtkArrayRasterData::discardRaster()
+{
+    m_data->invalidateTables();
+}
+
+/*!
+   \return the value at a raster position
+
+   \param x X value in plot coordinates
+   \param y Y value in plot coordinates
+
+   \sa QwtMatrixRasterData::ResampleMode
+ */
+double VtkArrayRasterData::value(double x, double y) const
+{
+    if ((m_data->numRows <= 0) || !m_data->intervals[Qt::XAxis].contains(x) ||
+        !m_data->intervals[Qt::YAxis].contains(y)) {
+        return qQNaN();
+    }
+
+    double value = qQNaN();
+
+    switch (m_data->dataType) {
+        vtkTemplateMacro(value = m_data->value<VTK_TT>(x, y));
+    }
+
+    return value;
+}
+
+/*!
+   \brief Values of a scanline
+
+   The values are resampled by the same kernels as QwtMatrixRasterData::values(),
+   that are instantiated for the type of the array.
+
+   \param x X value of the first position in plot coordinates
+   \param dx Distance between 2 positions in plot coordinates
+   \param y Y value in plot coordinates
+   \param numValues Number of values
+   \param values Array of at least numValues doubles
+
+   \sa value()
+ */
+void VtkArrayRasterData::values(double x, double dx, double y, int numValues, double *values) const
+{
+    if (numValues <= 0) {
+        return;
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval &yInterval = m_data->intervals[Qt::YAxis];
+
+    int first = 0;
+    int last = numValues;
+
+    if ((m_data->numRows <= 0) || !yInterval.contains(y)) {
+        last = 0;
+    } else {
+        // the positions are monotonic, so the valid ones are a single range
+        while ((first < last) && !xInterval.contains(x + first * dx)) {
+            first++;
+        }
+
+        while ((last > first) && !xInterval.contains(x + (last - 1) * dx)) {
+            last--;
+        }
+    }
+
+    for (int i = 0; i < first; i++) {
+        values[i] = qQNaN();
+    }
+
+    for (int i = last; i < numValues; i++) {
+        values[i] = qQNaN();
+    }
+
+    if (first >= last) {
+        return;
+    }
+
+    x += first * dx;
+    values += first;
+
+    switch (m_data->dataType) {
+        vtkTemplateMacro(m_data->values<VTK_TT>(x, dx, y, last - first, values));
+    default :
+        for (int i = 0; i < last - first; i++) {
+            values[i] = qQNaN();
+        }
+    }
+}
+
+void VtkArrayRasterData::update()
+{
+    m_data->invalidateTables();
+
+    m_data->numRows = 0;
+    m_data->dx = 0.0;
+    m_data->dy = 0.0;
+
+    if ((m_data->numColumns > 0) && m_data->pointer) {
+        m_data->numRows = int(m_data->array->GetNumberOfTuples() / m_data->numColumns);
+    }
+
+    if (m_data->numRows > 0) {
+        const Interval xInterval = interval(Qt::XAxis);
+        const Interval yInterval = interval(Qt::YAxis);
+        if (xInterval.isValid()) {
+            m_data->dx = xInterval.width() / m_data->numColumns;
+        }
+        if (yInterval.isValid()) {
+            m_data->dy = yInterval.width() / m_data->numRows;
+        }
+    }
+}
@@ -0,0 +1,59 @@
+﻿#ifndef VTK_ARRAY_RASTER_DATA_H
+#define VTK_ARRAY_RASTER_DATA_H
+
+#include "rasterdata.h"
+
+class vtkDataArray;
+class vtkImageData;
+
+/*!
+   \brief Raster data, that resamples the values of a vtkDataArray
+
+   VtkArrayRasterData interprets the tuples of a vtkDataArray as a matrix
+   of equidistant values like QwtMatrixRasterData, but without copying
+   them: the values are resampled in the native type of the array
+   ( f.e. float or unsigned short ). The array is referenced, so that
+   it stays alive, when the filter, that has produced it, is deleted.
+
+   Only the memory of arrays, that store their tuples contiguously
+   ( all vtkDataArray types before VTK 7.1 and vtkAOSDataArrayTemplate ),
+   is accessed directly. Any other array is converted by VTK once.
+
+   \sa QwtMatrixRasterData
+ */
+class VtkArrayRasterData : public RasterData
+{
+public:
+    VtkArrayRasterData();
+    virtual ~VtkArrayRasterData();
+
+    void setResampleMode(QwtMatrixRasterData::ResampleMode mode);
+    QwtMatrixRasterData::ResampleMode resampleMode() const;
+
+    void setInterval(Qt::Axis, const Interval &);
+    virtual Interval interval(Qt::Axis axis) const override final;
+
+    void setArray(vtkDataArray *array, int numColumns, int component = 0);
+    void setImage(vtkImageData *image, int component = 0);
+    vtkDataArray *array() const;
+    int component() const;
+
+    int numColumns() const;
+    int numRows() const;
+
+    virtual QRectF pixelHint(const QRectF &) const override;
+
+    virtual void initRaster(const QRectF &, const QSize &raster) override;
+    virtual void discardRaster() override;
+
+    virtual double value(double x, double y) const override;
+    virtual void values(double x, double dx, double y, int numValues, double *values) const override;
+
+private:
+    void update();
+
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+#endif
@@ -0,0 +1,544 @@
+﻿#include "waterfallrasterdata.h"
+
+#include <QRectF>
+#include <QSize>
+#include <QVector>
+
+#include <qnumeric.h>
+
+#include <string.h>
+
+#include "interval.h"
+#include "matrixresampler.h"
+
+class WaterfallRasterData::PrivateData
+{
+public:
+    PrivateData() :
+        resampleMode(QwtMatrixRasterData::NearestNeighbour), numColumns(0), capacity(0), next(0), count(0),
+        numAppended(0), origin(0.0), rowHeight(1.0), revision(0), fullRevision(0)
+    {
+    }
+
+    // the stored rows, oldest first
+    QwtMatrixView<double> matrix() const
+    {
+        const int first = (next - count + capacity) % qMax(capacity, 1);
+
+        QwtMatrixView<double> m;
+        m.values = buffer.constData() + qint64(first) * numColumns;
+        m.numColumns = numColumns;
+        m.numRows = count;
+        m.stride = 1;
+        m.dx = (intervals[Qt::XAxis].isValid() && numColumns > 0) ? intervals[Qt::XAxis].width() / numColumns : 0.0;
+        m.dy = rowHeight;
+
+        return m;
+    }
+
+    Interval yInterval() const
+    {
+        if (count <= 0) {
+            return Interval();
+        }
+
+        return Interval(origin + (numAppended - count) * rowHeight, origin + numAppended * rowHeight,
+                        Interval::ExcludeMaximum);
+    }
+
+    // neighbors, that are involved in the interpolation
+    int margin() const
+    {
+        switch (resampleMode) {
+        case QwtMatrixRasterData::BilinearInterpolation :
+            return 1;
+        case QwtMatrixRasterData::BicubicInterpolation :
+            return 2;
+        default :
+            return 0;
+        }
+    }
+
+    void invalidateTables()
+    {
+        columnTable.invalidate();
+        rowTable.invalidate();
+    }
+
+    // a change, that is not tracked by changedArea()
+    void touchAll()
+    {
+        invalidateTables();
+        fullRevision = ++revision;
+    }
+
+    Interval intervals[3];
+    QwtMatrixRasterData::ResampleMode resampleMode;
+
+    int numColumns;
+    int capacity;
+
+    // 2 * capacity rows: row i is stored at i and i + capacity
+    QVector<double> buffer;
+
+    int next;  // ring index of the next row
+    int count; // number of stored rows
+
+    qint64 numAppended;
+
+    double origin;
+    double rowHeight;
+
+    int revision;
+    int fullRevision;
+
+    // precalculated in initRaster()
+    QwtResampleTable columnTable;
+    QwtResampleTable rowTable;
+};
+
+// ! Constructor
+WaterfallRasterData::WaterfallRasterData()
+{
+    m_data = new PrivateData();
+}
+
+// ! Destructor
+WaterfallRasterData::~WaterfallRasterData()
+{
+    delete m_data;
+}
+
+/*!
+   \brief Set the resampling algorithm
+
+   \param mode Resampling mode
+   \sa resampleMode(), value()
+ */
+void WaterfallRasterData::setResampleMode(QwtMatrixRasterData::ResampleMode mode)
+{
+    if (mode != m_data->resampleMode) {
+        m_data->resampleMode = mode;
+        m_data->touchAll();
+    }
+}
+
+/*!
+   \return resampling algorithm
+   \sa setResampleMode(), value()
+ */
+QwtMatrixRasterData::ResampleMode WaterfallRasterData::resampleMode() const
+{
+    return m_data->resampleMode;
+}
+
+/*!
+   \brief Assign the bounding interval for the X or Z axis
+
+   The interval of the Y axis is calculated from the stored rows
+   and can't be assigned.
+
+   \param axis X or Z axis
+   \param interval Interval
+
+   \sa interval(), setRowHeight(), clear()
+ */
+void WaterfallRasterData::setInterval(Qt::Axis axis, const Interval &interval)
+{
+    if ((axis == Qt::XAxis) || (axis == Qt::ZAxis)) {
+        m_data->intervals[axis] = interval;
+        m_data->touchAll();
+    }
+}
+
+/*!
+   \return Bounding interval for an axis. The interval of the Y axis
+           is the range of the stored rows.
+   \sa setInterval
+ */
+Interval WaterfallRasterData::interval(Qt::Axis axis) const
+{
+    if (axis == Qt::YAxis) {
+        return m_data->yInterval();
+    }
+
+    if ((axis >= 0) && (axis <= 2)) {
+        return m_data->intervals[axis];
+    }
+
+    return Interval();
+}
+
+/*!
+   \brief Set the dimensions of the ring buffer
+
+   All stored rows are removed.
+
+   \param numColumns Number of values of a row
+   \param capacity Maximum number of stored rows
+
+   \sa numColumns(), capacity(), clear()
+ */
+void WaterfallRasterData::setGeometry(int numColumns, int capacity)
+{
+    m_data->numColumns = qMax(numColumns, 0);
+    m_data->capacity = qMax(capacity, 0);
+
+    m_data->buffer.fill(qQNaN(), 2 * m_data->capacity * m_data->numColumns);
+
+    clear(m_data->origin);
+}
+
+/*!
+   \return Number of values of a row
+   \sa setGeometry()
+ */
+int WaterfallRasterData::numColumns() const
+{
+    return m_data->numColumns;
+}
+
+/*!
+   \return Maximum number of stored rows
+   \sa setGeometry(), numRows()
+ */
+int WaterfallRasterData::capacity() const
+{
+    return m_data->capacity;
+}
+
+/*!
+   \brief Set the distance between 2 rows on the Y axis
+
+   \param height Height of a row, the default setting is 1.0
+   \sa rowHeight(), clear()
+ */
+void WaterfallRasterData::setRowHeight(double height)
+{
+    if ((height > 0.0) && (height != m_data->rowHeight)) {
+        m_data->rowHeight = height;
+        m_data->touchAll();
+    }
+}
+
+/*!
+   \return Distance between 2 rows on the Y axis
+   \sa setRowHeight()
+ */
+double WaterfallRasterData::rowHeight() const
+{
+    return m_data->rowHeight;
+}
+
+/*!
+   \brief Remove all rows
+
+   \param origin Position of the first row, that will be appended
+   \sa origin(), appendRow()
+ */
+void WaterfallRasterData::clear(double origin)
+{
+    m_data->origin = origin;
+    m_data->next = 0;
+    m_data->count = 0;
+    m_data->numAppended = 0;
+
+    m_data->touchAll();
+}
+
+/*!
+   \return Position of the first row, that has been appended after clear()
+   \sa clear()
+ */
+double WaterfallRasterData::origin() const
+{
+    return m_data->origin;
+}
+
+/*!
+   \brief Append a row
+
+   When the ring buffer is full, the oldest row is replaced.
+   The cost is copying the row twice.
+
+   \param values numColumns() values
+   \sa setGeometry(), numRows()
+ */
+void WaterfallRasterData::appendRow(const double *values)
+{
+    if ((m_data->capacity <= 0) || (m_data->numColumns <= 0)) {
+        return;
+    }
+
+    const qint64 numColumns = m_data->numColumns;
+    const size_t numBytes = numColumns * sizeof(double);
+
+    double *row = m_data->buffer.data() + m_data->next * numColumns;
+    memcpy(row, values, numBytes);
+    memcpy(row + m_data->capacity * numColumns, values, numBytes);
+
+    m_data->next = (m_data->next + 1) % m_data->capacity;
+    m_data->count = qMin(m_data->count + 1, m_data->capacity);
+    m_data->numAppended++;
+
+    // the interval of the Y axis has moved
+    m_data->invalidateTables();
+
+    m_data->revision++;
+}
+
+/*!
+   \brief Append a row
+
+   \param values Row of values, missing values are NaN
+   \sa appendRow()
+ */
+void WaterfallRasterData::appendRow(const QVector<double> &values)
+{
+    if (values.size() >= m_data->numColumns) {
+        appendRow(values.constData());
+    } else {
+        QVector<double> row = values;
+        row.resize(m_data->numColumns);
+
+        for (int i = values.size(); i < row.size(); i++) {
+            row[i] = qQNaN();
+        }
+
+        appendRow(row.constData());
+    }
+}
+
+/*!
+   \return Number of stored rows
+   \sa capacity(), numAppendedRows()
+ */
+int WaterfallRasterData::numRows() const
+{
+    return m_data->count;
+}
+
+/*!
+   \return Number of rows, that have been appended since clear()
+   \sa numRows(), appendRow()
+ */
+qint64 WaterfallRasterData::numAppendedRows() const
+{
+    return m_data->numAppended;
+}
+
+/*!
+   \brief Calculate the pixel hint
+
+   \param area Requested area, ignored
+   \return Surrounding pixel of the oldest value for NearestNeighbour,
+           otherwise an empty rectangle
+
+   \sa QwtMatrixRasterData::pixelHint()
+ */
+QRectF WaterfallRasterData::pixelHint(const QRectF &area) const
+{
+    Q_UNUSED(area)
+
+    QRectF rect;
+    if (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) {
+        const Interval intervalX = interval(Qt::XAxis);
+        const Interval intervalY = interval(Qt::YAxis);
+        if (intervalX.isValid() && intervalY.isValid()) {
+            rect = QRectF(intervalX.minValue(), intervalY.minValue(), m_data->matrix().dx, m_data->rowHeight);
+        }
+    }
+
+    return rect;
+}
+
+/*!
+   \brief Initialize a raster
+
+   Precalculates the indexes and weights of the interpolating resample modes
+   for the grid of positions of the raster.
+
+   \param area Area of the raster
+   \param raster Number of horizontal and vertical pixels
+
+   \sa discardRaster(), QwtMatrixRasterData::initRaster()
+ */
+void WaterfallRasterData::initRaster(const QRectF &area, const QSize &raster)
+{
+    m_data->invalidateTables();
+
+    if ((m_data->count <= 0) || (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) ||
+        (raster.width() < 2) || (raster.height() < 2)) {
+        return;
+    }
+
+    const double xStep = area.width() / (raster.width() - 1);
+    const double yStep = area.height() / (raster.height() - 1);
+
+    const QwtMatrixView<double> matrix = m_data->matrix();
+
+    m_data->columnTable.init(m_data->resampleMode, area.left(), xStep, raster.width(), m_data->intervals[Qt::XAxis],
+                             matrix.dx, matrix.numColumns);
+
+    m_data->rowTable.init(m_data->resampleMode, area.top(), yStep, raster.height(), m_data->yInterval(), matrix.dy,
+                          matrix.numRows);
+}
+
+/*!
+   \brief Discard a raster
+
+   Releases the tables calculated in initRaster()
+   \sa initRaster()
+ */
+void WaterfallRasterData::discardRaster()
+{
+    m_data->invalidateTables();
+}
+
+/*!
+   \return the value at a raster position
+
+   \param x X value in plot coordinates
+   \param y Y value in plot coordinates
+
+   \sa QwtMatrixRasterData::ResampleMode
+ */
+double WaterfallRasterData::value(double x, double y) const
+{
+    const Interval yInterval = m_data->yInterval();
+
+    if ((m_data->count <= 0) || !m_data->intervals[Qt::XAxis].contains(x) || !yInterval.contains(y)) {
+        return qQNaN();
+    }
+
+    return qwtResampleValue(m_data->resampleMode, m_data->matrix(), m_data->intervals[Qt::XAxis], yInterval, x, y);
+}
+
+/*!
+   \brief Values of a scanline
+
+   The values are resampled by the same kernels as QwtMatrixRasterData::values().
+
+   \param x X value of the first position in plot coordinates
+   \param dx Distance between 2 positions in plot coordinates
+   \param y Y value in plot coordinates
+   \param numValues Number of values
+   \param values Array of at least numValues doubles
+
+   \sa value()
+ */
+void WaterfallRasterData::values(double x, double dx, double y, int numValues, double *values) const
+{
+    if (numValues <= 0) {
+        return;
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval yInterval = m_data->yInterval();
+
+    int first = 0;
+    int last = numValues;
+
+    if ((m_data->count <= 0) || !yInterval.contains(y)) {
+        last = 0;
+    } else {
+        // the positions are monotonic, so the valid ones are a single range
+        while ((first < last) && !xInterval.contains(x + first * dx)) {
+            first++;
+        }
+
+        while ((last > first) && !xInterval.contains(x + (last - 1) * dx)) {
+            last--;
+        }
+    }
+
+    for (int i = 0; i < first; i++) {
+        values[i] = qQNaN();
+    }
+
+    for (int i = last; i < numValues; i++) {
+        values[i] = qQNaN();
+    }
+
+    if (first >= last) {
+        return;
+    }
+
+    const QwtMatrixView<double> matrix = m_data->matrix();
+
+    if (m_data->resampleMode == QwtMatrixRasterData::NearestNeighbour) {
+        qwtNearestNeighbours(matrix, xInterval, yInterval, x + first * dx, dx, y, last - first, values + first);
+    } else {
+        qwtResampleValues(m_data->resampleMode, matrix, xInterval, yInterval, m_data->columnTable, m_data->rowTable,
+                          x + first * dx, dx, y, last - first, values + first);
+    }
+}
+
+/*!
+   \brief Validity of the values in an area
+
+   \param area Area in plot coordinates
+   \return NoneValid outside of the stored rows, otherwise
+           the validity of RasterData::validity()
+ */
+RasterData::Validity WaterfallRasterData::validity(const QRectF &area) const
+{
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+    const Interval yInterval = m_data->yInterval();
+
+    if (!(xInterval.isValid() && yInterval.isValid())) {
+        return NoneValid;
+    }
+
+    if ((area.right() < xInterval.minValue()) || (area.left() > xInterval.maxValue())
+        || (area.bottom() < yInterval.minValue()) || (area.top() > yInterval.maxValue())) {
+        return NoneValid;
+    }
+
+    const bool inside = xInterval.contains(area.left()) && xInterval.contains(area.right())
+                        && yInterval.contains(area.top()) && yInterval.contains(area.bottom());
+
+    return inside ? RasterData::validity(area) : PartiallyValid;
+}
+
+/*!
+   \return Revision of the data, increased by each appended row
+   \sa changedArea(), appendRow()
+ */
+int WaterfallRasterData::revision() const
+{
+    return m_data->revision;
+}
+
+/*!
+   \brief Area, where values have changed
+
+   \param revision Revision, that has been returned by revision() before
+   \return The rows, that have been appended since revision, including
+           the rows, that are interpolated with them. All other modifications
+           result in the bounding rectangle of the data.
+
+   \note Rows, that have been removed from the ring buffer, are outside
+         of the interval of the Y axis.
+
+   \sa revision(), appendRow()
+ */
+QRectF WaterfallRasterData::changedArea(int revision) const
+{
+    if (revision >= m_data->revision) {
+        return QRectF();
+    }
+
+    if ((revision < m_data->fullRevision) || (m_data->count <= 0)) {
+        return RasterData::changedArea(revision);
+    }
+
+    const Interval &xInterval = m_data->intervals[Qt::XAxis];
+
+    const qint64 numRows = qMin(qint64(m_data->revision - revision), qint64(m_data->count)) + m_data->margin();
+
+    const double y2 = m_data->origin + m_data->numAppended * m_data->rowHeight;
+    const double y1 = y2 - numRows * m_data->rowHeight;
+
+    return QRectF(xInterval.minValue(), y1, xInterval.width(), y2 - y1);
+}
@@ -0,0 +1,77 @@
+﻿#ifndef WATERFALL_RASTER_DATA_H
+#define WATERFALL_RASTER_DATA_H
+
+#include "rasterdata.h"
+
+template <typename T>
+class QVector;
+
+/*!
+   \brief Raster data of a waterfall, where rows of values are appended continuously
+
+   WaterfallRasterData stores the last capacity() rows in a ring buffer.
+   appendRow() copies a single row, what is independent of the number
+   of rows. The buffer is double-buffered: each row is stored twice, at its
+   position in the ring and capacity() rows later, so that the stored rows
+   are always a contiguous matrix, that is resampled like QwtMatrixRasterData.
+
+   The rows are stacked along the Y axis: row n, counted from clear(),
+   covers [ origin + n * rowHeight, origin + ( n + 1 ) * rowHeight [.
+   The interval of the Y axis is the range of the stored rows, it moves,
+   whenever a row is appended.
+
+   revision() is increased by each appended row and changedArea() returns
+   the rows, that have been appended since, what allows a PlotSpectrogram in
+   PlotSpectrogram::ScrollingRender mode to render only the new rows.
+
+   \note Rows must not be appended concurrently to rendering the data.
+
+   \sa PlotSpectrogram::ScrollingRender, QwtMatrixRasterData
+ */
+class WaterfallRasterData : public RasterData
+{
+public:
+    WaterfallRasterData();
+    virtual ~WaterfallRasterData();
+
+    void setResampleMode(QwtMatrixRasterData::ResampleMode mode);
+    QwtMatrixRasterData::ResampleMode resampleMode() const;
+
+    void setInterval(Qt::Axis, const Interval &);
+    virtual Interval interval(Qt::Axis axis) const override final;
+
+    void setGeometry(int numColumns, int capacity);
+    int numColumns() const;
+    int capacity() const;
+
+    void setRowHeight(double);
+    double rowHeight() const;
+
+    void clear(double origin = 0.0);
+    double origin() const;
+
+    void appendRow(const double *values);
+    void appendRow(const QVector<double> &values);
+
+    int numRows() const;
+    qint64 numAppendedRows() const;
+
+    virtual QRectF pixelHint(const QRectF &) const override;
+
+    virtual void initRaster(const QRectF &, const QSize &raster) override;
+    virtual void discardRaster() override;
+
+    virtual double value(double x, double y) const override;
+    virtual void values(double x, double dx, double y, int numValues, double *values) const override;
+
+    virtual Validity validity(const QRectF &area) const override;
+
+    virtual int revision() const override;
+    virtual QRectF changedArea(int revision) const override;
+
+private:
+    class PrivateData;
+    PrivateData *m_data;
+};
+
+#endif
@@ -1,6 +1,4 @@
 #include <vtkCellLocator.h>
-#include <vtkClipPolyData.h>
-#include <vtkCutter.h>
 #include <vtkDataSetSurfaceFilter.h>
 #include <vtkDoubleArray.h>
 #include <vtkFloatArray.h>
@@ -8,12 +6,14 @@
 #include <vtkImageData.h>
 #include <vtkImageDataGeometryFilter.h>
 #include <vtkImageMapToColors.h>
+#include <vtkImagePlaneResampler.h>
 #include <vtkImageStencil.h>
 #include <vtkImageStencilToImage.h>
 #include <vtkImplicitModeller.h>
+#include <vtkInformation.h>
 #include <vtkLookupTable.h>
+#include <vtkMath.h>
 #include <vtkPNGWriter.h>
-#include <vtkPlane.h>
 #include <vtkPointData.h>
 #include <vtkPoints.h>
 #include <vtkPolyData.h>
@@ -22,11 +22,18 @@
 #include <vtkPolyDataToImageStencil.h>
 #include <vtkSampleFunction.h>
 #include <vtkSmartPointer.h>
+#include <vtkStreamingDemandDrivenPipeline.h>
 #include <vtkStructuredPoints.h>
 #include <vtkStructuredPointsGeometryFilter.h>
 #include <vtkStructuredPointsReader.h>
-#include <vtkTransform.h>
-#include <vtkTransformPolyDataFilter.h>
+
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
 
 vtkSmartPointer<vtkImageData> polyDataToImageData(vtkPolyData *polyData, double *pixelSize)
 {
@@ -148,14 +155,68 @@ vtkSmartPointer<vtkStructuredPoints> ConvertPolyDataToStructuredPoints(vtkPolyDa
 class VTKImageSlice
 {
 public:
+    // 切割平面的定义
+    // 平面内的坐标 (u, v) 以 origin 为原点，u 沿水平方向，v 沿平面内与之垂直的方向（竖直平面即为 z 方向）
+    struct SlicePlane
+    {
+        SlicePlane();
+
+        double origin[3]; // 切割平面的原点坐标
+        double normal[3]; // 切割平面的法向量
+
+        double extent[4];           // 保留的矩形范围 (u0, u1, v0, v1)，u0 > u1 或 v0 > v1 表示该方向不限制
+        std::vector<double> polygon; // 保留的多边形 (u, v, u, v, ...)，少于 3 个点表示不限制
+
+        double slabThickness; // 沿法向量的厚度，以平面为中心，0 表示单层切面
+        int slabMode;         // 厚度内各采样点的投影方式：vtkImagePlaneResampler::SlabMax、SlabMin 或 SlabMean
+    };
+
+    // 切面计算完成后调用，index 是平面在 planes 中的序号，slice 是重采样得到的二维网格
+    typedef std::function<void(size_t index, vtkImageData *slice)> SliceCallback;
+
     VTKImageSlice(const std::string &filename);
     void getCutPlane(const double *origin, const double *normal, const std::string &outputFilename,
                      vtkLookupTable *lut = nullptr);
 
+    void getCutPlanes(const std::vector<SlicePlane> &planes, const SliceCallback &callback, int numThreads = 0,
+                      size_t maxInFlightBytes = 256 * 1024 * 1024);
+
 private:
+    static vtkSmartPointer<vtkImagePlaneResampler> createResampler(vtkImageData *volume, const SlicePlane &plane);
+
     vtkSmartPointer<vtkStructuredPoints> structPointData_;
 };
 
+VTKImageSlice::SlicePlane::SlicePlane()
+{
+    std::fill(origin, origin + 3, 0.0);
+
+    normal[0] = normal[1] = 0.0;
+    normal[2] = 1.0;
+
+    extent[0] = extent[2] = 0.0;
+    extent[1] = extent[3] = -1.0;
+
+    slabThickness = 0.0;
+    slabMode = vtkImagePlaneResampler::SlabMax;
+}
+
+// 只在 extent 和 polygon 限定的范围内采样，范围外的点为 NaN，不需要先切出整个截面再裁剪
+vtkSmartPointer<vtkImagePlaneResampler> VTKImageSlice::createResampler(vtkImageData *volume, const SlicePlane &plane)
+{
+    vtkSmartPointer<vtkImagePlaneResampler> resampler = vtkSmartPointer<vtkImagePlaneResampler>::New();
+    resampler->SetInputData(volume);
+    resampler->SetPlane(plane.origin, plane.normal);
+    resampler->SetPlaneExtent(plane.extent[0], plane.extent[1], plane.extent[2], plane.extent[3]);
+    resampler->SetClipPolygon(static_cast<int>(plane.polygon.size() / 2), plane.polygon.data());
+
+    // 厚切片：在一次遍历中沿法向量采样并求最大、最小或平均值
+    resampler->SetSlabThickness(plane.slabThickness);
+    resampler->SetSlabMode(plane.slabMode);
+
+    return resampler;
+}
+
 VTKImageSlice::VTKImageSlice(const std::string &filename)
 {
     vtkSmartPointer<vtkStructuredPointsReader> reader = vtkSmartPointer<vtkStructuredPointsReader>::New();
@@ -169,56 +230,14 @@ void VTKImageSlice::getCutPlane(const double *origin, const double *normal, cons
                                 vtkLookupTable *lut)
 {
 
-    // 创建切割平面
-    vtkSmartPointer<vtkPlane> plane = vtkSmartPointer<vtkPlane>::New();
-    plane->SetOrigin(origin[0], origin[1], origin[2]);
-    plane->SetNormal(normal[0], normal[1], normal[2]);
-
-    // 创建切割器
-    vtkSmartPointer<vtkCutter> cutter = vtkSmartPointer<vtkCutter>::New();
-    cutter->SetInputData(structPointData_);
-    cutter->SetCutFunction(plane);
-    cutter->Update(); // 确保 cutPlane 包含有效数据。
-
-    vtkPolyData *polyData = cutter->GetOutput();
-    std::cout << "Bounds1: " << polyData->GetBounds()[0] << "," << polyData->GetBounds()[1] << ","
-              << polyData->GetBounds()[2] << "," << polyData->GetBounds()[3] << "," << polyData->GetBounds()[4] << ","
-              << polyData->GetBounds()[5] << "," << std::endl;
-    vtkPoints *points = polyData->GetPoints();
-    if (points) {
-        std::cout << "Number of points: " << points->GetNumberOfPoints() << std::endl;
-
-        // for (vtkIdType i = 0; i < points->GetNumberOfPoints(); ++i) {
-        //     double p[3];
-        //     points->GetPoint(i, p);
-        //     std::cout << "Point: " << p[0] << ", " << p[1] << ", " << p[2] << std::endl;
-        // }
-    }
+    // 在平面上直接重采样体数据，得到规则的二维网格：列沿水平方向，行沿平面内与之垂直的方向。
+    // 输出文件中是 vtkImageData，不是三角形面片
+    VTKImageSlice::SlicePlane slicePlane;
+    std::copy(origin, origin + 3, slicePlane.origin);
+    std::copy(normal, normal + 3, slicePlane.normal);
 
-    // vtkSmartPointer<vtkImageData> cutPlane = polyDataToImageData(polyData, 1);
-    // vtkSmartPointer<vtkStructuredPoints> cutPlane = ConvertPolyDataToStructuredPoints(polyData);
-
-    {
-        // create transform
-        vtkSmartPointer<vtkTransform> transform = vtkSmartPointer<vtkTransform>::New();
-        transform->PostMultiply();
-        // transform->Translate(origin[0], origin[1], origin[2]);
-        transform->RotateZ(vtkMath::DegreesFromRadians(atan2(normal[1], normal[0])));
-
-        // create transform filter
-        vtkSmartPointer<vtkTransformPolyDataFilter> transformFilter =
-            vtkSmartPointer<vtkTransformPolyDataFilter>::New();
-        transformFilter->SetInputData(polyData);
-        transformFilter->SetTransform(transform);
-        transformFilter->Update();
-
-        // 输出切割数据到 VTK 文件
-        vtkSmartPointer<vtkGenericDataObjectWriter> writer = vtkSmartPointer<vtkGenericDataObjectWriter>::New();
-        writer->SetInputData(transformFilter->GetOutput());
-        writer->SetFileName("/home/guobin/cut_plane_trans.vtk");
-        writer->SetFileTypeToBinary();
-        writer->Write();
-    }
+    vtkSmartPointer<vtkImagePlaneResampler> resampler = createResampler(structPointData_, slicePlane);
+    resampler->Update();
 
     // if (lut != nullptr) {
     //     vtkSmartPointer<vtkImageMapToColors> colorMapper = vtkSmartPointer<vtkImageMapToColors>::New();
@@ -229,27 +248,36 @@ void VTKImageSlice::getCutPlane(const double *origin, const double *normal, cons
     // }
 
     {
-        // 创建裁剪平面
-        vtkSmartPointer<vtkPlane> plane1 = vtkSmartPointer<vtkPlane>::New();
-        plane1->SetOrigin(225000, 1215500, 47);
-        plane1->SetNormal(normal[0], -normal[1], normal[2]);
-        vtkSmartPointer<vtkPlane> plane2 = vtkSmartPointer<vtkPlane>::New();
-        plane2->SetOrigin(225000, 1215000, 47);
-        plane2->SetNormal(-normal[0], normal[1], normal[2]);
-
-        vtkSmartPointer<vtkClipPolyData> clipPolyData1 = vtkSmartPointer<vtkClipPolyData>::New();
-        clipPolyData1->SetInputData(polyData);
-        clipPolyData1->SetClipFunction(plane1);
-        clipPolyData1->Update();
-
-        vtkSmartPointer<vtkClipPolyData> clipPolyData2 = vtkSmartPointer<vtkClipPolyData>::New();
-        clipPolyData2->SetInputData(clipPolyData1->GetOutput());
-        clipPolyData2->SetClipFunction(plane2);
-        clipPolyData2->Update();
+        // 只保留切面上两个竖直裁剪面之间的部分：裁剪面分别经过 (225000, 1215000) 和 (225000, 1215500)，
+        // 与切割平面垂直。范围在采样之前就确定，范围外的体素不会被访问
+        VTKImageSlice::SlicePlane window;
+        std::copy(origin, origin + 3, window.origin);
+        std::copy(normal, normal + 3, window.normal);
+
+        vtkSmartPointer<vtkImagePlaneResampler> windowResampler = createResampler(structPointData_, window);
+
+        const double corner1[3] = {225000, 1215000, 47};
+        const double corner2[3] = {225000, 1215500, 47};
+
+        // 两个点在水平轴上的投影即为 u 的范围，v 方向不限制
+        const double *axis1 = windowResampler->GetAxis1();
+
+        double u1 = 0.0;
+        double u2 = 0.0;
+        for (int i = 0; i < 3; i++) {
+            u1 += (corner1[i] - origin[i]) * axis1[i];
+            u2 += (corner2[i] - origin[i]) * axis1[i];
+        }
+
+        window.extent[0] = std::min(u1, u2);
+        window.extent[1] = std::max(u1, u2);
+
+        windowResampler->SetPlaneExtent(window.extent);
+        windowResampler->Update();
 
         // 输出切割数据到 VTK 文件
         vtkSmartPointer<vtkGenericDataObjectWriter> writer = vtkSmartPointer<vtkGenericDataObjectWriter>::New();
-        writer->SetInputData(clipPolyData2->GetOutput());
+        writer->SetInputData(windowResampler->GetOutput());
         writer->SetFileName("/home/guobin/cut_plane_clip.vtk");
         writer->SetFileTypeToBinary();
         writer->Write();
@@ -257,16 +285,153 @@ void VTKImageSlice::getCutPlane(const double *origin, const double *normal, cons
 
     // 输出切割数据到 VTK 文件
     vtkSmartPointer<vtkGenericDataObjectWriter> writer = vtkSmartPointer<vtkGenericDataObjectWriter>::New();
-    writer->SetInputData(polyData);
+    writer->SetInputData(resampler->GetOutput());
     writer->SetFileName(outputFilename.c_str());
     writer->SetFileTypeToBinary();
     writer->Write();
 }
 
-// 该类中的 `getCutPlane` 方法根据传入的平面原点和法向量，计算得到该平面在 vtk 数据集上的切面图片，并将其保存为 PNG
-// 格式的图片文件。可选参数 `lut` 是 vtkLookupTable
-// 类型的指针，用于指定色标表，如果不指定将使用默认的黑白色表。注意需要在使用切割器之前调用 `vtkCutter::SetInputData`
-// 来设置输入数据集。
+// 批量计算多个切面：各线程共享同一份只读体数据（每个线程一个浅拷贝，不复制标量），
+// 并行地对各平面重采样。切面按完成的顺序在调用线程中交给 callback，callback 返回后切面即被释放。
+// maxInFlightBytes 限制正在计算和等待交付的切面所占的内存，超出时线程等待，但至少有一个切面在计算。
+// callback 抛出异常时不再分配新的切面，等所有线程结束后将异常继续抛出。
+void VTKImageSlice::getCutPlanes(const std::vector<SlicePlane> &planes, const SliceCallback &callback,
+                                 int numThreads, size_t maxInFlightBytes)
+{
+    if (planes.empty()) {
+        return;
+    }
+
+    if (numThreads <= 0) {
+        numThreads = std::max(static_cast<int>(std::thread::hardware_concurrency()), 1);
+    }
+    numThreads = static_cast<int>(std::min(static_cast<size_t>(numThreads), planes.size()));
+
+    struct Result
+    {
+        size_t index;
+        vtkSmartPointer<vtkImageData> slice;
+        size_t numBytes;
+    };
+
+    std::mutex mutex;
+    std::condition_variable condition;
+
+    std::deque<Result> results; // 已完成、尚未交付的切面
+    size_t nextPlane = 0;
+    size_t inFlightBytes = 0;
+    bool stopped = false; // callback 抛出了异常
+
+    const auto worker = [&](vtkStructuredPoints *volume) {
+        while (true) {
+            size_t index;
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (stopped || (nextPlane >= planes.size())) {
+                    return;
+                }
+                index = nextPlane++;
+            }
+
+            const SlicePlane &plane = planes[index];
+
+            // 每个切面一个重采样器，输出的数组不会被下一个切面覆盖
+            vtkSmartPointer<vtkImagePlaneResampler> resampler = createResampler(volume, plane);
+            resampler->SetNumberOfThreads(1); // 已经按平面并行
+            resampler->UpdateInformation();
+
+            // 计算之前即可知道切面的大小
+            int extent[6];
+            resampler->GetOutputInformation(0)->Get(vtkStreamingDemandDrivenPipeline::WHOLE_EXTENT(), extent);
+
+            const size_t numBytes =
+                static_cast<size_t>(std::max(extent[1] - extent[0] + 1, 0)) * std::max(extent[3] - extent[2] + 1, 0)
+                * sizeof(float);
+
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock, [&] {
+                    return stopped || (inFlightBytes == 0) || (inFlightBytes + numBytes <= maxInFlightBytes);
+                });
+                if (stopped) {
+                    return;
+                }
+                inFlightBytes += numBytes;
+            }
+
+            resampler->Update();
+
+            Result result;
+            result.index = index;
+            result.slice = resampler->GetOutput();
+            result.numBytes = numBytes;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                results.push_back(result);
+            }
+            condition.notify_all();
+        }
+    };
+
+    // 体数据的浅拷贝在调用线程中创建，各线程的管线互不共享 VTK 对象
+    std::vector<vtkSmartPointer<vtkStructuredPoints>> volumes;
+    std::vector<std::thread> threads;
+
+    for (int i = 0; i < numThreads; i++) {
+        vtkSmartPointer<vtkStructuredPoints> volume = vtkSmartPointer<vtkStructuredPoints>::New();
+        volume->ShallowCopy(structPointData_);
+        volumes.push_back(volume);
+    }
+
+    for (int i = 0; i < numThreads; i++) {
+        threads.push_back(std::thread(worker, volumes[i].GetPointer()));
+    }
+
+    const auto joinThreads = [&]() {
+        for (size_t i = 0; i < threads.size(); i++) {
+            threads[i].join();
+        }
+    };
+
+    for (size_t numDelivered = 0; numDelivered < planes.size(); numDelivered++) {
+        Result result;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            condition.wait(lock, [&] { return !results.empty(); });
+
+            result = results.front();
+            results.pop_front();
+        }
+
+        try {
+            callback(result.index, result.slice);
+        } catch (...) {
+            // 唤醒等待内存的线程，正在计算的切面算完后丢弃
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopped = true;
+            }
+            condition.notify_all();
+
+            joinThreads();
+            throw;
+        }
+        result.slice = nullptr;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            inFlightBytes -= result.numBytes;
+        }
+        condition.notify_all();
+    }
+
+    joinThreads();
+}
+
+// 该类中的 `getCutPlane` 方法根据传入的平面原点和法向量，用 vtkImagePlaneResampler 在 vtk 数据集上重采样得到切面，
+// 并将其作为二维网格（vtkImageData）保存为 VTK 文件。可选参数 `lut` 是 vtkLookupTable
+// 类型的指针，用于指定色标表，如果不指定将使用默认的黑白色表。
 int main()
 {
     std::string filename = "/home/guobin/AI.vtk";
@@ -277,5 +442,36 @@ int main()
     VTKImageSlice reader(filename);
     reader.getCutPlane(origin, normal, outputFilename, lut);
 
+    // 沿法向量平移的一组平行切面，间隔 100，并行计算，完成一个写一个文件
+    double unitNormal[3];
+    std::copy(normal, normal + 3, unitNormal);
+    vtkMath::Normalize(unitNormal);
+
+    std::vector<VTKImageSlice::SlicePlane> planes;
+    for (int i = 0; i < 16; i++) {
+        VTKImageSlice::SlicePlane plane;
+        for (int j = 0; j < 3; j++) {
+            plane.origin[j] = origin[j] + i * 100.0 * unitNormal[j];
+            plane.normal[j] = normal[j];
+        }
+        planes.push_back(plane);
+    }
+
+    // 第一个切面处厚度为 50 的最大值投影
+    VTKImageSlice::SlicePlane slab;
+    std::copy(origin, origin + 3, slab.origin);
+    std::copy(normal, normal + 3, slab.normal);
+    slab.slabThickness = 50.0;
+    slab.slabMode = vtkImagePlaneResampler::SlabMax;
+    planes.push_back(slab);
+
+    reader.getCutPlanes(planes, [](size_t index, vtkImageData *slice) {
+        vtkSmartPointer<vtkGenericDataObjectWriter> writer = vtkSmartPointer<vtkGenericDataObjectWriter>::New();
+        writer->SetInputData(slice);
+        writer->SetFileName(("/home/guobin/cut_plane_" + std::to_string(index) + ".vtk").c_str());
+        writer->SetFileTypeToBinary();
+        writer->Write();
+    });
+
     return 0;
 }
\ No newline at end of file